@@ -0,0 +1,78 @@
+#include "buffer_arena.h"
+
+// Largest offset alignment any implementation is allowed to require for storage buffer bindings.
+#define BUFFER_ARENA_ALIGNMENT 256
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static size_t align_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+BufferArena::~BufferArena()
+{
+    if (m_handle)
+        glDeleteBuffers(1, &m_handle);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+BufferRange BufferArena::reserve(size_t size)
+{
+    BufferRange range;
+
+    if (m_handle)
+    {
+        DW_LOG_ERROR("Buffer arena ranges must be reserved before it is created");
+        return range;
+    }
+
+    range.offset = m_size;
+    range.size   = size;
+
+    m_size = align_up(m_size + size, BUFFER_ARENA_ALIGNMENT);
+
+    return range;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BufferArena::create(GLbitfield flags)
+{
+    glCreateBuffers(1, &m_handle);
+    glNamedBufferStorage(m_handle, m_size, nullptr, flags);
+    glClearNamedBufferData(m_handle, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BufferArena::bind(GLenum target, uint32_t index, const BufferRange& range)
+{
+    glBindBufferRange(target, index, m_handle, range.offset, range.size);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BufferArena::clear(const BufferRange& range)
+{
+    glClearNamedBufferSubData(m_handle, GL_R32UI, range.offset, range.size, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BufferArena::get_data(const BufferRange& range, size_t offset, size_t size, void* data)
+{
+    glGetNamedBufferSubData(m_handle, range.offset + offset, size, data);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BufferArena::copy(const BufferRange& range, size_t offset, GLuint destination, size_t destination_offset, size_t size)
+{
+    glCopyNamedBufferSubData(m_handle, destination, range.offset + offset, destination_offset, size);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
\ No newline at end of file
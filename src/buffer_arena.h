@@ -0,0 +1,38 @@
+#pragma once
+
+#include <ogl.h>
+
+// Byte range of one sub-allocation inside a BufferArena.
+struct BufferRange
+{
+    size_t offset = 0;
+    size_t size   = 0;
+};
+
+// A single buffer with immutable storage that backs several logical buffers. Every range is reserved up front, then
+// create() allocates the storage once. All calls go through direct state access, so using the arena never touches
+// the generic binding points.
+class BufferArena
+{
+public:
+    ~BufferArena();
+
+    // Reserves size bytes at the next offset usable as a storage buffer binding. Only valid before create().
+    BufferRange reserve(size_t size);
+
+    // Allocates the storage for every range reserved so far, cleared to zero. Flags are passed to glNamedBufferStorage.
+    void create(GLbitfield flags);
+
+    void bind(GLenum target, uint32_t index, const BufferRange& range);
+    // Zeroes the whole range.
+    void clear(const BufferRange& range);
+    void get_data(const BufferRange& range, size_t offset, size_t size, void* data);
+    void copy(const BufferRange& range, size_t offset, GLuint destination, size_t destination_offset, size_t size);
+
+    inline GLuint handle() { return m_handle; }
+    inline size_t size() { return m_size; }
+
+private:
+    GLuint m_handle = 0;
+    size_t m_size   = 0;
+};
@@ -0,0 +1,479 @@
+#include "bvh.h"
+#include "job_system.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+
+// Subtrees with more triangles than this are split off as jobs.
+#define BVH_PARALLEL_THRESHOLD 8192
+// The count is packed into the low four bits of BVHNode::triangles.
+#define BVH_MAX_PACKED_TRIANGLES 15
+#define BVH_VALIDATE_EPSILON 1e-4f
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static float surface_area(const glm::vec3& bounds_min, const glm::vec3& bounds_max)
+{
+    glm::vec3 extent = glm::max(bounds_max - bounds_min, glm::vec3(0.0f));
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool intersect_aabb(const glm::vec3& origin, const glm::vec3& inv_direction, const glm::vec3& bounds_min, const glm::vec3& bounds_max, float max_t)
+{
+    glm::vec3 t0 = (bounds_min - origin) * inv_direction;
+    glm::vec3 t1 = (bounds_max - origin) * inv_direction;
+
+    glm::vec3 t_near = glm::min(t0, t1);
+    glm::vec3 t_far  = glm::max(t0, t1);
+
+    float enter = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+    float exit  = std::min(std::min(t_far.x, t_far.y), std::min(t_far.z, max_t));
+
+    return enter <= exit;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Moller-Trumbore, double sided.
+static bool intersect_triangle(const glm::vec3& origin, const glm::vec3& direction, const BVHTriangle& triangle, float& t)
+{
+    glm::vec3 v0    = glm::vec3(triangle.v0);
+    glm::vec3 edge1 = glm::vec3(triangle.v1) - v0;
+    glm::vec3 edge2 = glm::vec3(triangle.v2) - v0;
+    glm::vec3 p     = glm::cross(direction, edge2);
+    float     det   = glm::dot(edge1, p);
+
+    if (fabsf(det) < 1e-12f)
+        return false;
+
+    float     inv_det = 1.0f / det;
+    glm::vec3 s       = origin - v0;
+    float     u       = glm::dot(s, p) * inv_det;
+
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    glm::vec3 q = glm::cross(s, edge1);
+    float     v = glm::dot(direction, q) * inv_det;
+
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = glm::dot(edge2, q) * inv_det;
+
+    return t >= 0.0f;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool contains(const glm::vec3& outer_min, const glm::vec3& outer_max, const glm::vec3& point)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (point[i] < outer_min[i] - BVH_VALIDATE_EPSILON || point[i] > outer_max[i] + BVH_VALIDATE_EPSILON)
+            return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BVH::build(const std::vector<glm::vec3>& positions, JobSystem& jobs)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    uint32_t count = uint32_t(positions.size() / 3);
+
+    m_nodes.clear();
+    m_triangles.clear();
+    m_stats     = BVHStats();
+    m_positions = positions.data();
+
+    m_indices.resize(count);
+    m_centroids.resize(count);
+    m_bounds_min.resize(count);
+    m_bounds_max.resize(count);
+
+    jobs.parallel_for(count, 4096, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            const glm::vec3* v = &m_positions[i * 3];
+
+            m_indices[i]    = i;
+            m_bounds_min[i] = glm::min(v[0], glm::min(v[1], v[2]));
+            m_bounds_max[i] = glm::max(v[0], glm::max(v[1], v[2]));
+            m_centroids[i]  = (m_bounds_min[i] + m_bounds_max[i]) * 0.5f;
+        }
+    });
+
+    if (count > 0)
+    {
+        BuildNode root;
+        build_node(&root, 0, count, jobs);
+
+        m_nodes.reserve(root.node_count);
+        flatten(&root, BVH_INVALID_NODE, 1);
+
+        // Leaves reference contiguous ranges of the partitioned index list.
+        m_triangles.resize(count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const glm::vec3* v = &m_positions[m_indices[i] * 3];
+            m_triangles[i]     = { glm::vec4(v[0], 0.0f), glm::vec4(v[1], 0.0f), glm::vec4(v[2], 0.0f) };
+        }
+    }
+
+    m_positions = nullptr;
+    m_centroids.clear();
+    m_bounds_min.clear();
+    m_bounds_max.clear();
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    m_stats.build_ms   = std::chrono::duration<double, std::milli>(end - start).count();
+    m_stats.node_count = uint32_t(m_nodes.size());
+    m_stats.memory     = sizeof(BVHNode) * m_nodes.size() + sizeof(BVHTriangle) * m_triangles.size();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BVH::build_node(BuildNode* node, uint32_t first, uint32_t count, JobSystem& jobs)
+{
+    glm::vec3 bounds_min   = glm::vec3(FLT_MAX);
+    glm::vec3 bounds_max   = glm::vec3(-FLT_MAX);
+    glm::vec3 centroid_min = glm::vec3(FLT_MAX);
+    glm::vec3 centroid_max = glm::vec3(-FLT_MAX);
+
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        uint32_t index = m_indices[i];
+
+        bounds_min   = glm::min(bounds_min, m_bounds_min[index]);
+        bounds_max   = glm::max(bounds_max, m_bounds_max[index]);
+        centroid_min = glm::min(centroid_min, m_centroids[index]);
+        centroid_max = glm::max(centroid_max, m_centroids[index]);
+    }
+
+    node->bounds_min = bounds_min;
+    node->bounds_max = bounds_max;
+    node->first      = first;
+    node->count      = count;
+    node->node_count = 1;
+
+    if (count <= BVH_MAX_LEAF_TRIANGLES)
+        return;
+
+    // Binned SAH over all three axes, with unit traversal and intersection costs.
+    struct Bin
+    {
+        glm::vec3 bounds_min = glm::vec3(FLT_MAX);
+        glm::vec3 bounds_max = glm::vec3(-FLT_MAX);
+        uint32_t  count      = 0;
+    };
+
+    glm::vec3 extent     = centroid_max - centroid_min;
+    float     best_cost  = FLT_MAX;
+    int32_t   best_axis  = -1;
+    int32_t   best_split = 0;
+
+    for (int32_t axis = 0; axis < 3; axis++)
+    {
+        if (extent[axis] <= 0.0f)
+            continue;
+
+        Bin   bins[BVH_SAH_BINS];
+        float scale = float(BVH_SAH_BINS) / extent[axis];
+
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            uint32_t index = m_indices[i];
+            int32_t  bin   = std::min(int32_t((m_centroids[index][axis] - centroid_min[axis]) * scale), BVH_SAH_BINS - 1);
+
+            bins[bin].bounds_min = glm::min(bins[bin].bounds_min, m_bounds_min[index]);
+            bins[bin].bounds_max = glm::max(bins[bin].bounds_max, m_bounds_max[index]);
+            bins[bin].count++;
+        }
+
+        // Right hand side of every split plane, swept from the last bin.
+        float    right_area[BVH_SAH_BINS];
+        uint32_t right_count[BVH_SAH_BINS];
+        Bin      right;
+
+        for (int32_t i = BVH_SAH_BINS - 1; i > 0; i--)
+        {
+            right.bounds_min = glm::min(right.bounds_min, bins[i].bounds_min);
+            right.bounds_max = glm::max(right.bounds_max, bins[i].bounds_max);
+            right.count += bins[i].count;
+
+            right_area[i]  = surface_area(right.bounds_min, right.bounds_max);
+            right_count[i] = right.count;
+        }
+
+        Bin left;
+
+        for (int32_t i = 1; i < BVH_SAH_BINS; i++)
+        {
+            left.bounds_min = glm::min(left.bounds_min, bins[i - 1].bounds_min);
+            left.bounds_max = glm::max(left.bounds_max, bins[i - 1].bounds_max);
+            left.count += bins[i - 1].count;
+
+            if (left.count == 0 || right_count[i] == 0)
+                continue;
+
+            float cost = float(left.count) * surface_area(left.bounds_min, left.bounds_max) + float(right_count[i]) * right_area[i];
+
+            if (cost < best_cost)
+            {
+                best_cost  = cost;
+                best_axis  = axis;
+                best_split = i;
+            }
+        }
+    }
+
+    float area = surface_area(bounds_min, bounds_max);
+
+    // Stay a leaf when splitting doesn't pay off, as long as the count still fits in the packed node.
+    if (count <= BVH_MAX_PACKED_TRIANGLES && (best_axis == -1 || 1.0f + best_cost / std::max(area, FLT_MIN) >= float(count)))
+        return;
+
+    uint32_t* begin = m_indices.data() + first;
+    uint32_t* mid   = begin + count / 2;
+
+    if (best_axis != -1)
+    {
+        float scale = float(BVH_SAH_BINS) / extent[best_axis];
+
+        mid = std::partition(begin, begin + count, [&](uint32_t index) {
+            return std::min(int32_t((m_centroids[index][best_axis] - centroid_min[best_axis]) * scale), BVH_SAH_BINS - 1) < best_split;
+        });
+    }
+
+    // Coincident centroids: any split is as good as another.
+    if (mid == begin || mid == begin + count)
+        mid = begin + count / 2;
+
+    uint32_t left_count = uint32_t(mid - begin);
+
+    node->left  = std::make_unique<BuildNode>();
+    node->right = std::make_unique<BuildNode>();
+
+    if (count > BVH_PARALLEL_THRESHOLD)
+    {
+        JobCounter counter;
+        BuildNode* left = node->left.get();
+
+        jobs.submit([this, left, first, left_count, &jobs]() { build_node(left, first, left_count, jobs); }, counter);
+
+        build_node(node->right.get(), first + left_count, count - left_count, jobs);
+
+        jobs.wait(counter);
+    }
+    else
+    {
+        build_node(node->left.get(), first, left_count, jobs);
+        build_node(node->right.get(), first + left_count, count - left_count, jobs);
+    }
+
+    node->node_count = 1 + node->left->node_count + node->right->node_count;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t BVH::flatten(const BuildNode* node, uint32_t miss, uint32_t depth)
+{
+    uint32_t index = uint32_t(m_nodes.size());
+
+    m_stats.max_depth = std::max(m_stats.max_depth, depth);
+
+    if (!node->left)
+    {
+        m_nodes.push_back({ node->bounds_min, miss, node->bounds_max, (node->first << 4) | node->count });
+        m_stats.leaf_count++;
+
+        return index;
+    }
+
+    m_nodes.push_back({ node->bounds_min, miss, node->bounds_max, 0 });
+
+    // The left child is visited next and continues at its sibling, the right child continues wherever this node would.
+    uint32_t right = index + 1 + node->left->node_count;
+
+    flatten(node->left.get(), right, depth + 1);
+    flatten(node->right.get(), miss, depth + 1);
+
+    return index;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool BVH::intersect(const glm::vec3& origin, const glm::vec3& direction, float max_t, float& t, uint32_t& triangle) const
+{
+    glm::vec3 inv_direction = glm::vec3(1.0f) / direction;
+    uint32_t  node          = m_nodes.empty() ? BVH_INVALID_NODE : 0;
+    bool      hit           = false;
+
+    t = max_t;
+
+    while (node != BVH_INVALID_NODE)
+    {
+        const BVHNode& current = m_nodes[node];
+
+        if (!intersect_aabb(origin, inv_direction, current.bounds_min, current.bounds_max, t))
+        {
+            node = current.miss;
+            continue;
+        }
+
+        if (current.triangles == 0)
+        {
+            node++;
+            continue;
+        }
+
+        uint32_t first = current.triangles >> 4;
+        uint32_t count = current.triangles & 0xF;
+
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            float hit_t;
+
+            if (intersect_triangle(origin, direction, m_triangles[i], hit_t) && hit_t <= t)
+            {
+                t        = hit_t;
+                triangle = i;
+                hit      = true;
+            }
+        }
+
+        node = current.miss;
+    }
+
+    return hit;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool BVH::intersect_brute_force(const glm::vec3& origin, const glm::vec3& direction, float max_t, float& t, uint32_t& triangle) const
+{
+    bool hit = false;
+
+    t = max_t;
+
+    for (uint32_t i = 0; i < uint32_t(m_triangles.size()); i++)
+    {
+        float hit_t;
+
+        if (intersect_triangle(origin, direction, m_triangles[i], hit_t) && hit_t <= t)
+        {
+            t        = hit_t;
+            triangle = i;
+            hit      = true;
+        }
+    }
+
+    return hit;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool BVH::validate(std::string& error) const
+{
+    if (m_nodes.empty())
+    {
+        error = m_triangles.empty() ? "" : "Triangles without nodes";
+        return m_triangles.empty();
+    }
+
+    if (m_nodes[0].miss != BVH_INVALID_NODE)
+    {
+        error = "Root has a miss link";
+        return false;
+    }
+
+    std::vector<uint32_t> references(m_triangles.size(), 0);
+    uint32_t              node_count = uint32_t(m_nodes.size());
+
+    for (uint32_t i = 0; i < node_count; i++)
+    {
+        const BVHNode& node = m_nodes[i];
+        std::string    name = "Node " + std::to_string(i) + ": ";
+
+        if (node.triangles == 0)
+        {
+            // The left child follows its parent and its miss link points at the right child.
+            if (i + 1 >= node_count || m_nodes[i + 1].miss >= node_count)
+            {
+                error = name + "missing child";
+                return false;
+            }
+
+            const BVHNode& left  = m_nodes[i + 1];
+            const BVHNode& right = m_nodes[left.miss];
+
+            if (right.miss != node.miss)
+            {
+                error = name + "right child doesn't continue at the parent's miss link";
+                return false;
+            }
+
+            if (!contains(node.bounds_min, node.bounds_max, left.bounds_min) || !contains(node.bounds_min, node.bounds_max, left.bounds_max) ||
+                !contains(node.bounds_min, node.bounds_max, right.bounds_min) || !contains(node.bounds_min, node.bounds_max, right.bounds_max))
+            {
+                error = name + "child bounds outside of the parent";
+                return false;
+            }
+        }
+        else
+        {
+            uint32_t first = node.triangles >> 4;
+            uint32_t count = node.triangles & 0xF;
+
+            if (count == 0 || first + count > m_triangles.size())
+            {
+                error = name + "leaf range out of bounds";
+                return false;
+            }
+
+            // Depth first order: finishing a leaf always continues at the next node.
+            if (node.miss != (i + 1 < node_count ? i + 1 : BVH_INVALID_NODE))
+            {
+                error = name + "leaf doesn't continue at the next node";
+                return false;
+            }
+
+            for (uint32_t j = first; j < first + count; j++)
+            {
+                const BVHTriangle& triangle = m_triangles[j];
+
+                if (!contains(node.bounds_min, node.bounds_max, glm::vec3(triangle.v0)) || !contains(node.bounds_min, node.bounds_max, glm::vec3(triangle.v1)) ||
+                    !contains(node.bounds_min, node.bounds_max, glm::vec3(triangle.v2)))
+                {
+                    error = name + "triangle " + std::to_string(j) + " outside of the leaf bounds";
+                    return false;
+                }
+
+                references[j]++;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < uint32_t(references.size()); i++)
+    {
+        if (references[i] != 1)
+        {
+            error = "Triangle " + std::to_string(i) + " referenced " + std::to_string(references[i]) + " times";
+            return false;
+        }
+    }
+
+    error = "";
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define BVH_INVALID_NODE 0xFFFFFFFFu
+#define BVH_MAX_LEAF_TRIANGLES 4
+#define BVH_SAH_BINS 16
+
+class JobSystem;
+
+// std430 mirror of BVHNode in shader/bvh.glsl. Nodes are stored depth first, so an interior node's left child
+// is the next node, and every node carries the index to continue at once it has been missed or finished.
+struct BVHNode
+{
+    glm::vec3 bounds_min;
+    uint32_t  miss;      // BVH_INVALID_NODE past the last node
+    glm::vec3 bounds_max;
+    uint32_t  triangles; // Leaves: first triangle << 4 | count, interior nodes: 0
+};
+
+// std430 mirror of BVHTriangle in shader/bvh.glsl.
+struct BVHTriangle
+{
+    glm::vec4 v0;
+    glm::vec4 v1;
+    glm::vec4 v2;
+};
+
+struct BVHStats
+{
+    double   build_ms   = 0.0;
+    uint32_t node_count = 0;
+    uint32_t leaf_count = 0;
+    uint32_t max_depth  = 0;
+    size_t   memory     = 0; // Bytes uploaded to the GPU
+};
+
+// Binned SAH bounding volume hierarchy over a static triangle soup, flattened for stackless traversal on the GPU.
+// Subtrees above a size threshold are built as jobs on the given JobSystem.
+class BVH
+{
+public:
+    // Three positions per triangle.
+    void build(const std::vector<glm::vec3>& positions, JobSystem& jobs);
+
+    // Same stackless walk as intersect_bvh() in shader/bvh.glsl. The segment is origin + direction * t for t in [0, max_t].
+    bool intersect(const glm::vec3& origin, const glm::vec3& direction, float max_t, float& t, uint32_t& triangle) const;
+
+    // Tests every triangle, the reference the traversal is validated against.
+    bool intersect_brute_force(const glm::vec3& origin, const glm::vec3& direction, float max_t, float& t, uint32_t& triangle) const;
+
+    // Checks the structural invariants of the flattened tree. Returns false with a description of the first failure.
+    bool validate(std::string& error) const;
+
+    inline const std::vector<BVHNode>&     nodes() const { return m_nodes; }
+    inline const std::vector<BVHTriangle>& triangles() const { return m_triangles; }
+    inline const BVHStats&                 stats() const { return m_stats; }
+    inline glm::vec3                       bounds_min() const { return m_nodes.empty() ? glm::vec3(0.0f) : m_nodes[0].bounds_min; }
+    inline glm::vec3                       bounds_max() const { return m_nodes.empty() ? glm::vec3(0.0f) : m_nodes[0].bounds_max; }
+
+private:
+    struct BuildNode
+    {
+        glm::vec3                  bounds_min;
+        glm::vec3                  bounds_max;
+        uint32_t                   first      = 0;
+        uint32_t                   count      = 0;
+        uint32_t                   node_count = 0; // Nodes in this subtree, including itself
+        std::unique_ptr<BuildNode> left;
+        std::unique_ptr<BuildNode> right;
+    };
+
+    void     build_node(BuildNode* node, uint32_t first, uint32_t count, JobSystem& jobs);
+    uint32_t flatten(const BuildNode* node, uint32_t miss, uint32_t depth);
+
+private:
+    std::vector<BVHNode>     m_nodes;
+    std::vector<BVHTriangle> m_triangles;
+    std::vector<uint32_t>    m_indices;
+    std::vector<glm::vec3>   m_centroids;
+    std::vector<glm::vec3>   m_bounds_min;
+    std::vector<glm::vec3>   m_bounds_max;
+    const glm::vec3*         m_positions = nullptr;
+    BVHStats                 m_stats;
+};
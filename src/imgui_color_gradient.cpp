@@ -6,6 +6,8 @@
 
 #include "imgui_color_gradient.h"
 #include <imgui_internal.h>
+#include <algorithm>
+#include <string.h>
 
 static const float GRADIENT_BAR_WIDGET_HEIGHT = 25;
 static const float GRADIENT_BAR_EDITOR_HEIGHT = 40;
@@ -17,113 +19,119 @@ ImGradient::ImGradient()
     addMark(1.0f, ImColor(1.0f, 1.0f, 1.0f));
 }
 
-ImGradient::~ImGradient()
+int ImGradient::addMark(float position, ImColor const color)
 {
-    for (ImGradientMark* mark : m_marks)
-    {
-        delete mark;
-    }
+    ImGradientMark newMark;
+    newMark.position = ImClamp(position, 0.0f, 1.0f);
+    newMark.color[0] = color.Value.x;
+    newMark.color[1] = color.Value.y;
+    newMark.color[2] = color.Value.z;
+    newMark.color[3] = color.Value.w;
+
+    // Insert after any marks at the same position so insertion order breaks ties.
+    auto it = std::upper_bound(m_marks.begin(), m_marks.end(), newMark.position, [](float p, const ImGradientMark& mark) { return p < mark.position; });
+    int  index = (int)(it - m_marks.begin());
+
+    m_marks.insert(it, newMark);
+
+    refreshCache();
+
+    return index;
 }
 
-void ImGradient::addMark(float position, ImColor const color)
+void ImGradient::removeMark(int index)
 {
-    position                = ImClamp(position, 0.0f, 1.0f);
-    ImGradientMark* newMark = new ImGradientMark();
-    newMark->position       = position;
-    newMark->color[0]       = color.Value.x;
-    newMark->color[1]       = color.Value.y;
-    newMark->color[2]       = color.Value.z;
-    newMark->color[3]       = color.Value.w;
+    m_marks.erase(m_marks.begin() + index);
+    refreshCache();
+}
 
-    m_marks.push_back(newMark);
+int ImGradient::moveMark(int index, float position)
+{
+    m_marks[index].position = ImClamp(position, 0.0f, 1.0f);
+
+    // Only the moved mark can be out of order, so bubble it into place instead of re-sorting.
+    while (index > 0 && m_marks[index - 1].position > m_marks[index].position)
+    {
+        std::swap(m_marks[index - 1], m_marks[index]);
+        index--;
+    }
+
+    while (index < (int)m_marks.size() - 1 && m_marks[index + 1].position < m_marks[index].position)
+    {
+        std::swap(m_marks[index + 1], m_marks[index]);
+        index++;
+    }
 
     refreshCache();
+
+    return index;
 }
 
-void ImGradient::removeMark(ImGradientMark* mark)
+void ImGradient::clearMarks()
 {
-    m_marks.remove(mark);
+    m_marks.clear();
     refreshCache();
 }
 
 void ImGradient::getColorAt(float position, float* color) const
 {
     position     = ImClamp(position, 0.0f, 1.0f);
-    int cachePos = (position * 255);
-    cachePos *= 3;
-    color[0] = m_cachedValues[cachePos + 0];
-    color[1] = m_cachedValues[cachePos + 1];
-    color[2] = m_cachedValues[cachePos + 2];
-    color[3] = m_cachedValues[cachePos + 3];
+    int cachePos = (int)(position * (IM_GRADIENT_CACHE_SIZE - 1)) * 4;
+
+    memcpy(color, &m_cachedValues[cachePos], sizeof(float) * 4);
 }
 
-void ImGradient::computeColorAt(float position, float* color) const
+void ImGradient::getColorsAt(const float* positions, float* colors, int count) const
 {
-    position = ImClamp(position, 0.0f, 1.0f);
-
-    ImGradientMark* lower = nullptr;
-    ImGradientMark* upper = nullptr;
-
-    for (ImGradientMark* mark : m_marks)
+    for (int i = 0; i < count; i++)
     {
-        if (mark->position < position)
-        {
-            if (!lower || lower->position < mark->position)
-            {
-                lower = mark;
-            }
-        }
+        float position = ImClamp(positions[i], 0.0f, 1.0f);
+        int   cachePos = (int)(position * (IM_GRADIENT_CACHE_SIZE - 1)) * 4;
 
-        if (mark->position >= position)
-        {
-            if (!upper || upper->position > mark->position)
-            {
-                upper = mark;
-            }
-        }
+        memcpy(&colors[i * 4], &m_cachedValues[cachePos], sizeof(float) * 4);
     }
+}
 
-    if (upper && !lower)
-    {
-        lower = upper;
-    }
-    else if (!upper && lower)
-    {
-        upper = lower;
-    }
-    else if (!lower && !upper)
+void ImGradient::refreshCache()
+{
+    int markCount = (int)m_marks.size();
+
+    if (markCount == 0)
     {
-        color[0] = color[1] = color[2] = color[3] = 0;
+        memset(m_cachedValues, 0, sizeof(m_cachedValues));
         return;
     }
 
-    if (upper == lower)
-    {
-        color[0] = upper->color[0];
-        color[1] = upper->color[1];
-        color[2] = upper->color[2];
-        color[3] = upper->color[3];
-    }
-    else
+    // Sample positions only increase, so the upper mark only ever moves forward: O(marks + samples).
+    int upper = 0;
+
+    for (int i = 0; i < IM_GRADIENT_CACHE_SIZE; ++i)
     {
-        float distance = upper->position - lower->position;
-        float delta    = (position - lower->position) / distance;
-
-        //lerp
-        color[0] = ((1.0f - delta) * lower->color[0]) + ((delta)*upper->color[0]);
-        color[1] = ((1.0f - delta) * lower->color[1]) + ((delta)*upper->color[1]);
-        color[2] = ((1.0f - delta) * lower->color[2]) + ((delta)*upper->color[2]);
-        color[3] = ((1.0f - delta) * lower->color[3]) + ((delta)*upper->color[3]);
-    }
-}
+        float  position = i / float(IM_GRADIENT_CACHE_SIZE - 1);
+        float* color    = &m_cachedValues[i * 4];
 
-void ImGradient::refreshCache()
-{
-    m_marks.sort([](const ImGradientMark* a, const ImGradientMark* b) { return a->position < b->position; });
+        while (upper < markCount && m_marks[upper].position < position)
+            upper++;
 
-    for (int i = 0; i < 256; ++i)
-    {
-        computeColorAt(i / 255.0f, &m_cachedValues[i * 3]);
+        if (upper == 0 || upper == markCount)
+        {
+            const ImGradientMark& mark = m_marks[upper == 0 ? 0 : markCount - 1];
+            memcpy(color, mark.color, sizeof(float) * 4);
+        }
+        else
+        {
+            const ImGradientMark& lowerMark = m_marks[upper - 1];
+            const ImGradientMark& upperMark = m_marks[upper];
+
+            float distance = upperMark.position - lowerMark.position;
+            float delta    = (position - lowerMark.position) / distance;
+
+            //lerp
+            color[0] = ((1.0f - delta) * lowerMark.color[0]) + ((delta)*upperMark.color[0]);
+            color[1] = ((1.0f - delta) * lowerMark.color[1]) + ((delta)*upperMark.color[1]);
+            color[2] = ((1.0f - delta) * lowerMark.color[2]) + ((delta)*upperMark.color[2]);
+            color[3] = ((1.0f - delta) * lowerMark.color[3]) + ((delta)*upperMark.color[3]);
+        }
     }
 }
 
@@ -134,12 +142,12 @@ static void DrawGradientBar(ImGradient*          gradient,
                             float                maxWidth,
                             float                height)
 {
-    ImVec4          colorA    = { 1, 1, 1, 1 };
-    ImVec4          colorB    = { 1, 1, 1, 1 };
-    float           prevX     = bar_pos.x;
-    float           barBottom = bar_pos.y + height;
-    ImGradientMark* prevMark  = nullptr;
-    ImDrawList*     draw_list = ImGui::GetWindowDrawList();
+    ImVec4                colorA    = { 1, 1, 1, 1 };
+    ImVec4                colorB    = { 1, 1, 1, 1 };
+    float                 prevX     = bar_pos.x;
+    float                 barBottom = bar_pos.y + height;
+    const ImGradientMark* prevMark  = nullptr;
+    ImDrawList*           draw_list = ImGui::GetWindowDrawList();
 
     draw_list->AddRectFilled(ImVec2(bar_pos.x - 2, bar_pos.y - 2),
                              ImVec2(bar_pos.x + maxWidth + 2, barBottom + 2),
@@ -155,9 +163,9 @@ static void DrawGradientBar(ImGradient*          gradient,
     ImU32 colorAU32 = 0;
     ImU32 colorBU32 = 0;
 
-    for (auto markIt = gradient->getMarks().begin(); markIt != gradient->getMarks().end(); ++markIt)
+    for (const ImGradientMark& markRef : gradient->getMarks())
     {
-        ImGradientMark* mark = *markIt;
+        const ImGradientMark* mark = &markRef;
 
         float from = prevX;
         float to = prevX = bar_pos.x + mark->position * maxWidth;
@@ -209,27 +217,27 @@ static void DrawGradientBar(ImGradient*          gradient,
 }
 
 static void DrawGradientMarks(ImGradient*          gradient,
-                              ImGradientMark*&     draggingMark,
-                              ImGradientMark*&     selectedMark,
+                              int&                 draggingMark,
+                              int&                 selectedMark,
                               struct ImVec2 const& bar_pos,
                               float                maxWidth,
                               float                height)
 {
-    ImVec4          colorA    = { 1, 1, 1, 1 };
-    ImVec4          colorB    = { 1, 1, 1, 1 };
-    float           barBottom = bar_pos.y + height;
-    ImGradientMark* prevMark  = nullptr;
-    ImDrawList*     draw_list = ImGui::GetWindowDrawList();
-    ImU32           colorAU32 = 0;
-    ImU32           colorBU32 = 0;
-
-    for (auto markIt = gradient->getMarks().begin(); markIt != gradient->getMarks().end(); ++markIt)
+    ImVec4                colorA    = { 1, 1, 1, 1 };
+    ImVec4                colorB    = { 1, 1, 1, 1 };
+    float                 barBottom = bar_pos.y + height;
+    const ImGradientMark* prevMark  = nullptr;
+    ImDrawList*           draw_list = ImGui::GetWindowDrawList();
+    ImU32                 colorAU32 = 0;
+    ImU32                 colorBU32 = 0;
+
+    for (int markIndex = 0; markIndex < gradient->markCount(); ++markIndex)
     {
-        ImGradientMark* mark = *markIt;
+        const ImGradientMark* mark = &gradient->getMark(markIndex);
 
-        if (!selectedMark)
+        if (selectedMark < 0)
         {
-            selectedMark = mark;
+            selectedMark = markIndex;
         }
 
         float to = bar_pos.x + mark->position * maxWidth;
@@ -271,7 +279,7 @@ static void DrawGradientMarks(ImGradient*          gradient,
                                  1.0f,
                                  1.0f);
 
-        if (selectedMark == mark)
+        if (selectedMark == markIndex)
         {
             draw_list->AddTriangleFilled(ImVec2(to, bar_pos.y + (height - 3)),
                                          ImVec2(to - 4, barBottom + 1),
@@ -293,14 +301,16 @@ static void DrawGradientMarks(ImGradient*          gradient,
                                            colorBU32);
 
         ImGui::SetCursorScreenPos(ImVec2(to - 6, barBottom));
+        ImGui::PushID(markIndex);
         ImGui::InvisibleButton("mark", ImVec2(12, 12));
+        ImGui::PopID();
 
         if (ImGui::IsItemHovered())
         {
             if (ImGui::IsMouseClicked(0))
             {
-                selectedMark = mark;
-                draggingMark = mark;
+                selectedMark = markIndex;
+                draggingMark = markIndex;
             }
         }
 
@@ -325,10 +335,10 @@ bool GradientButton(ImGradient* gradient)
     return clicked;
 }
 
-bool GradientEditor(const char*      label,
-                    ImGradient*      gradient,
-                    ImGradientMark*& draggingMark,
-                    ImGradientMark*& selectedMark)
+bool GradientEditor(const char* label,
+                    ImGradient* gradient,
+                    int&        draggingMark,
+                    int&        selectedMark)
 {
     if (!gradient) return false;
 
@@ -349,7 +359,9 @@ bool GradientEditor(const char*      label,
         float newMarkCol[4];
         gradient->getColorAt(pos, newMarkCol);
 
-        gradient->addMark(pos, ImColor(newMarkCol[0], newMarkCol[1], newMarkCol[2]));
+        // Indices shift on insertion, so select the new mark rather than keep a stale index.
+        selectedMark = gradient->addMark(pos, ImColor(newMarkCol[0], newMarkCol[1], newMarkCol[2]));
+        modified     = true;
     }
 
     ImGui::SameLine();
@@ -358,22 +370,22 @@ bool GradientEditor(const char*      label,
     DrawGradientBar(gradient, bar_pos, maxWidth, GRADIENT_BAR_EDITOR_HEIGHT);
     DrawGradientMarks(gradient, draggingMark, selectedMark, bar_pos, maxWidth, GRADIENT_BAR_EDITOR_HEIGHT);
 
-    if (!ImGui::IsMouseDown(0) && draggingMark)
+    if (!ImGui::IsMouseDown(0) && draggingMark >= 0)
     {
-        draggingMark = nullptr;
+        draggingMark = -1;
     }
 
-    if (ImGui::IsMouseDragging(0) && draggingMark)
+    if (ImGui::IsMouseDragging(0) && draggingMark >= 0)
     {
         float increment  = ImGui::GetIO().MouseDelta.x / maxWidth;
         bool  insideZone = (ImGui::GetIO().MousePos.x > bar_pos.x) && (ImGui::GetIO().MousePos.x < bar_pos.x + maxWidth);
 
         if (increment != 0.0f && insideZone)
         {
-            draggingMark->position += increment;
-            draggingMark->position = ImClamp(draggingMark->position, 0.0f, 1.0f);
-            gradient->refreshCache();
-            modified = true;
+            // Moving can reorder the marks, so follow the dragged mark to its new index.
+            draggingMark = gradient->moveMark(draggingMark, gradient->getMark(draggingMark).position + increment);
+            selectedMark = draggingMark;
+            modified     = true;
         }
 
         float diffY = ImGui::GetIO().MousePos.y - barBottom;
@@ -381,22 +393,27 @@ bool GradientEditor(const char*      label,
         if (diffY >= GRADIENT_MARK_DELETE_DIFFY)
         {
             gradient->removeMark(draggingMark);
-            draggingMark = nullptr;
-            selectedMark = nullptr;
+            draggingMark = -1;
+            selectedMark = -1;
             modified     = true;
         }
     }
 
-    if (!selectedMark && gradient->getMarks().size() > 0)
+    if (selectedMark >= gradient->markCount())
+    {
+        selectedMark = -1;
+    }
+
+    if (selectedMark < 0 && gradient->markCount() > 0)
     {
-        selectedMark = gradient->getMarks().front();
+        selectedMark = 0;
     }
 
-    if (selectedMark)
+    if (selectedMark >= 0)
     {
-        bool colorModified = ImGui::ColorPicker4("Color", selectedMark->color);
+        bool colorModified = ImGui::ColorPicker4("Color", gradient->getMark(selectedMark).color);
 
-        if (selectedMark && colorModified)
+        if (colorModified)
         {
             modified = true;
             gradient->refreshCache();
@@ -18,22 +18,27 @@
  }
  
  ::EDITOR::
- static ImGradientMark* draggingMark = nullptr;
- static ImGradientMark* selectedMark = nullptr;
+ static int draggingMark = -1;
+ static int selectedMark = -1;
  
- bool updated = ImGui::GradientEditor(&gradient, draggingMark, selectedMark);
+ bool updated = ImGui::GradientEditor("Gradient", &gradient, draggingMark, selectedMark);
  
  ::GET A COLOR::
- float color[3];
+ float color[4];
  gradient.getColorAt(0.3f, color); //position from 0 to 1
  
+ ::GET MANY COLORS::
+ float positions[64];
+ float colors[64 * 4];
+ gradient.getColorsAt(positions, colors, 64);
+ 
  ::MODIFY GRADIENT WITH CODE::
- gradient.getMarks().clear();
+ gradient.clearMarks();
  gradient.addMark(0.0f, ImColor(0.2f, 0.1f, 0.0f));
  gradient.addMark(0.7f, ImColor(120, 200, 255));
  
  ::WOOD BROWNS PRESET::
- gradient.getMarks().clear();
+ gradient.clearMarks();
  gradient.addMark(0.0f, ImColor(0xA0, 0x79, 0x3D));
  gradient.addMark(0.2f, ImColor(0xAA, 0x83, 0x47));
  gradient.addMark(0.3f, ImColor(0xB4, 0x8D, 0x51));
@@ -48,7 +53,9 @@
 #pragma once
 
 #include <imgui.h>
-#include <list>
+#include <vector>
+
+#define IM_GRADIENT_CACHE_SIZE 256
 
 struct ImGradientMark
 {
@@ -56,31 +63,36 @@ struct ImGradientMark
     float position; //0 to 1
 };
 
+// Marks are stored by value in a vector kept sorted by position, so evaluation never chases
+// pointers and the cache can be rebuilt in a single sweep. Marks are addressed by index.
 class ImGradient
 {
 public:
     ImGradient();
-    ~ImGradient();
 
-    void                        getColorAt(float position, float* color) const;
-    void                        addMark(float position, ImColor const color);
-    void                        removeMark(ImGradientMark* mark);
-    void                        refreshCache();
-    std::list<ImGradientMark*>& getMarks() { return m_marks; }
+    void                               getColorAt(float position, float* color) const;
+    void                               getColorsAt(const float* positions, float* colors, int count) const;
+    int                                addMark(float position, ImColor const color);
+    void                               removeMark(int index);
+    int                                moveMark(int index, float position);
+    void                               clearMarks();
+    void                               refreshCache();
+    int                                markCount() const { return (int)m_marks.size(); }
+    ImGradientMark&                    getMark(int index) { return m_marks[index]; }
+    const std::vector<ImGradientMark>& getMarks() const { return m_marks; }
 
 private:
-    void                       computeColorAt(float position, float* color) const;
-    std::list<ImGradientMark*> m_marks;
-    float                      m_cachedValues[256 * 3];
+    std::vector<ImGradientMark> m_marks;
+    float                       m_cachedValues[IM_GRADIENT_CACHE_SIZE * 4];
 };
 
 namespace ImGui
 {
 bool GradientButton(ImGradient* gradient);
 
-bool GradientEditor(const char*      label,
-                    ImGradient*      gradient,
-                    ImGradientMark*& draggingMark,
-                    ImGradientMark*& selectedMark);
+bool GradientEditor(const char* label,
+                    ImGradient* gradient,
+                    int&        draggingMark,
+                    int&        selectedMark);
 
 } // namespace ImGui
\ No newline at end of file
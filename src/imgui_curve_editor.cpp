@@ -1,46 +1,113 @@
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include <imgui.h>
 #include <imgui_internal.h>
+#include "imgui_curve_editor.h"
 #include <time.h>
+#include <math.h>
 
 namespace ImGui
 {
 template <int steps>
 void bezier_table(ImVec2 P[4], ImVec2 results[steps + 1])
 {
-    static float C[(steps + 1) * 4], *K = 0;
-    if (!K)
-    {
-        K = C;
-        for (unsigned step = 0; step <= steps; ++step)
-        {
-            float t         = (float)step / (float)steps;
-            C[step * 4 + 0] = (1 - t) * (1 - t) * (1 - t); // * P0
-            C[step * 4 + 1] = 3 * (1 - t) * (1 - t) * t;   // * P1
-            C[step * 4 + 2] = 3 * (1 - t) * t * t;         // * P2
-            C[step * 4 + 3] = t * t * t;                   // * P3
-        }
-    }
+    // Basis weights are recomputed per call rather than cached in statics so the table is re-entrant.
     for (unsigned step = 0; step <= steps; ++step)
     {
+        float t  = (float)step / (float)steps;
+        float K0 = (1 - t) * (1 - t) * (1 - t); // * P0
+        float K1 = 3 * (1 - t) * (1 - t) * t;   // * P1
+        float K2 = 3 * (1 - t) * t * t;         // * P2
+        float K3 = t * t * t;                   // * P3
+
         ImVec2 point = {
-            K[step * 4 + 0] * P[0].x + K[step * 4 + 1] * P[1].x + K[step * 4 + 2] * P[2].x + K[step * 4 + 3] * P[3].x,
-            K[step * 4 + 0] * P[0].y + K[step * 4 + 1] * P[1].y + K[step * 4 + 2] * P[2].y + K[step * 4 + 3] * P[3].y
+            K0 * P[0].x + K1 * P[1].x + K2 * P[2].x + K3 * P[3].x,
+            K0 * P[0].y + K1 * P[1].y + K2 * P[2].y + K3 * P[3].y
         };
         results[step] = point;
     }
 }
 
 float BezierValue(float dt01, float P[4])
+{
+    return BezierCurve(P).evaluate(dt01);
+}
+
+BezierCurve::BezierCurve(const float P[4])
+{
+    // Polynomial form of the curve with P0 = (0, 0) and P3 = (1, 1): f(t) = ((a * t + b) * t + c) * t
+    m_cx = 3.0f * P[0];
+    m_bx = 3.0f * (P[2] - P[0]) - m_cx;
+    m_ax = 1.0f - m_cx - m_bx;
+
+    m_cy = 3.0f * P[1];
+    m_by = 3.0f * (P[3] - P[1]) - m_cy;
+    m_ay = 1.0f - m_cy - m_by;
+}
+
+float BezierCurve::evaluate(float x) const
+{
+    float t = solve(x < 0 ? 0 : x > 1 ? 1 : x);
+    return ((m_ay * t + m_by) * t + m_cy) * t;
+}
+
+void BezierCurve::evaluate(const float* x, float* y, int count) const
+{
+    for (int i = 0; i < count; i++)
+        y[i] = evaluate(x[i]);
+}
+
+float BezierCurve::solve(float x) const
 {
     enum
     {
-        STEPS = 256
+        NEWTON_ITERATIONS    = 8,
+        BISECTION_ITERATIONS = 24
     };
-    ImVec2 Q[4] = { { 0, 0 }, { P[0], P[1] }, { P[2], P[3] }, { 1, 1 } };
-    ImVec2 results[STEPS + 1];
-    bezier_table<STEPS>(Q, results);
-    return results[(int)((dt01 < 0 ? 0 : dt01 > 1 ? 1 : dt01) * STEPS)].y;
+    const float EPSILON = 1e-5f;
+
+    // Newton's method converges in a few steps for most curves...
+    float t = x;
+
+    for (int i = 0; i < NEWTON_ITERATIONS; ++i)
+    {
+        float error = ((m_ax * t + m_bx) * t + m_cx) * t - x;
+
+        if (fabsf(error) < EPSILON)
+            return t;
+
+        float derivative = (3.0f * m_ax * t + 2.0f * m_bx) * t + m_cx;
+
+        if (fabsf(derivative) < EPSILON)
+            break;
+
+        t -= error / derivative;
+
+        if (t < 0.0f || t > 1.0f)
+            break;
+    }
+
+    // ...bisection handles the flat or steep spots where it doesn't.
+    float lo = 0.0f;
+    float hi = 1.0f;
+
+    t = 0.5f;
+
+    for (int i = 0; i < BISECTION_ITERATIONS; ++i)
+    {
+        float value = ((m_ax * t + m_bx) * t + m_cx) * t;
+
+        if (fabsf(value - x) < EPSILON)
+            break;
+
+        if (value < x)
+            lo = t;
+        else
+            hi = t;
+
+        t = 0.5f * (lo + hi);
+    }
+
+    return t;
 }
 
 int Bezier(const char* label, float P[5])
@@ -2,6 +2,25 @@
 
 namespace ImGui
 {
+// Cubic bezier from (0, 0) to (1, 1) shaped by two control points, evaluated as y over x.
+// Coefficients are computed once on construction and evaluation touches no shared state,
+// so one curve can be sampled from any number of threads at once.
+class BezierCurve
+{
+public:
+    BezierCurve(const float P[4]);
+
+    float evaluate(float x) const;
+    void  evaluate(const float* x, float* y, int count) const;
+
+private:
+    float solve(float x) const;
+
+private:
+    float m_ax, m_bx, m_cx;
+    float m_ay, m_by, m_cy;
+};
+
 extern float BezierValue(float dt01, float P[4]);
 extern int   Bezier(const char* label, float P[5]);
 extern void  ShowBezierDemo();
@@ -0,0 +1,166 @@
+#include "job_system.h"
+
+// Queue index of the current thread. The thread that constructs the system uses queue 0.
+static thread_local uint32_t g_queue_index = 0;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+JobSystem::JobSystem(uint32_t worker_count)
+{
+    for (uint32_t i = 0; i < worker_count + 1; i++)
+        m_queues.push_back(std::make_unique<Queue>());
+
+    for (uint32_t i = 0; i < worker_count; i++)
+        m_workers.emplace_back(&JobSystem::worker_main, this, i + 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        m_running = false;
+    }
+
+    m_sleep_cv.notify_all();
+
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void JobSystem::submit(Job job, JobCounter& counter)
+{
+    counter.pending++;
+
+    Queue& queue = *m_queues[g_queue_index];
+
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back({ std::move(job), &counter });
+    }
+
+    {
+        // Taking the sleep mutex orders the increment against a worker that is about to go to sleep.
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        m_queued++;
+    }
+
+    m_sleep_cv.notify_one();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void JobSystem::wait(JobCounter& counter)
+{
+    // Help out instead of blocking, so waiting on the main thread never idles a core.
+    while (counter.pending.load() > 0)
+    {
+        if (!run_one(g_queue_index))
+            std::this_thread::yield();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void JobSystem::parallel_for(uint32_t count, uint32_t batch_size, const RangeJob& job)
+{
+    JobCounter counter;
+
+    batch_size = batch_size > 0 ? batch_size : 1;
+
+    for (uint32_t begin = 0; begin < count; begin += batch_size)
+    {
+        uint32_t end = begin + batch_size < count ? begin + batch_size : count;
+        submit([&job, begin, end]() { job(begin, end); }, counter);
+    }
+
+    wait(counter);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void JobSystem::worker_main(uint32_t index)
+{
+    g_queue_index = index;
+
+    while (true)
+    {
+        if (run_one(index))
+            continue;
+
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+        m_sleep_cv.wait(lock, [this]() { return !m_running || m_queued.load() > 0; });
+
+        if (!m_running)
+            break;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool JobSystem::pop(uint32_t index, Task& task)
+{
+    Queue&                      queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (queue.tasks.empty())
+        return false;
+
+    // Newest first: its data is most likely still in this core's cache.
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool JobSystem::steal(uint32_t index, Task& task)
+{
+    uint32_t count = uint32_t(m_queues.size());
+
+    for (uint32_t i = 1; i < count; i++)
+    {
+        Queue&                      victim = *m_queues[(index + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (victim.tasks.empty())
+            continue;
+
+        // Oldest first: it is the one the owner would get to last.
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+
+        return true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool JobSystem::run_one(uint32_t index)
+{
+    Task task;
+
+    if (!pop(index, task) && !steal(index, task))
+        return false;
+
+    m_queued--;
+    execute(task);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void JobSystem::execute(Task& task)
+{
+    task.job();
+    task.counter->pending--;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tracks a group of submitted jobs. wait() returns once every job that was submitted with it has run.
+struct JobCounter
+{
+    std::atomic<int32_t> pending = { 0 };
+};
+
+// A small work-stealing scheduler for CPU side per-frame work such as emitter bookkeeping and curve
+// sampling. Every thread owns a queue: it pushes and pops at the back, idle threads steal from the
+// front of the others. The thread that created the system takes part in the work while it waits, which
+// keeps GL submission on the main thread: jobs compute data and the main thread records commands.
+class JobSystem
+{
+public:
+    using Job      = std::function<void()>;
+    using RangeJob = std::function<void(uint32_t begin, uint32_t end)>;
+
+    // worker_count excludes the calling thread. Defaults to one worker per remaining hardware thread.
+    JobSystem(uint32_t worker_count = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+    ~JobSystem();
+
+    void submit(Job job, JobCounter& counter);
+    void wait(JobCounter& counter);
+
+    // Splits [0, count) into batches of batch_size and blocks until all of them have run.
+    void parallel_for(uint32_t count, uint32_t batch_size, const RangeJob& job);
+
+    inline uint32_t worker_count() { return uint32_t(m_workers.size()); }
+    inline uint32_t thread_count() { return uint32_t(m_queues.size()); }
+
+private:
+    struct Task
+    {
+        Job         job;
+        JobCounter* counter;
+    };
+
+    struct Queue
+    {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    void worker_main(uint32_t index);
+    bool pop(uint32_t index, Task& task);
+    bool steal(uint32_t index, Task& task);
+    bool run_one(uint32_t index);
+    void execute(Task& task);
+
+private:
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread>            m_workers;
+    std::mutex                          m_sleep_mutex;
+    std::condition_variable             m_sleep_cv;
+    std::atomic<int32_t>                m_queued = { 0 };
+    std::atomic<bool>                   m_running = { true };
+};
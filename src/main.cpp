@@ -9,24 +9,217 @@
 #include <stack>
 #include <random>
 #include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
 #include <random>
+#include <fstream>
+#include <sstream>
 #include <bruneton_sky_model.h>
 #include <shadow_map.h>
 #include <ImGuizmo.h>
+#include <profiler.h>
 #include "imgui_curve_editor.h"
 #include "imgui_color_gradient.h"
+#include "persistent_buffer.h"
+#include "buffer_arena.h"
+#include "sprite_atlas.h"
+#include "job_system.h"
+#include "particle_reference.h"
+#include "particle_budget.h"
+#include "vector_field.h"
+#include "bvh.h"
 
 #undef min
 #undef max
 #define CAMERA_FAR_PLANE 1000.0f
 #define MAX_PARTICLES 1000000
-#define GRADIENT_SAMPLES 32
-#define LOCAL_SIZE 32
-
+#define MAX_EMITTERS 64
+#define CURVE_MAX_MARKS 16
+#define CURVE_ROWS_PER_EMITTER 2
+#define LOCAL_SIZE 32 // Passes the autotuner leaves alone
+#define SHADOW_MAP_SIZE 2048
+#define TILE_SIZE 16
+#define TILE_MAX_PARTICLES 512
+#define UNIFORM_RING_REGIONS 3
+#define UNIFORM_RING_REGION_SIZE 65536
+#define COUNTER_READBACK_SIZE 64
+#define COUNTER_READBACK_REGIONS 4
+#define COUNTER_HISTORY_SIZE 256
+#define MAX_FORCES 32
+#define FORCE_BENCHMARK_FORCES 16
+#define FORCE_BENCHMARK_PARTICLES 1000000
+#define VECTOR_FIELD_SIZE 32
+#define TRAIL_MAX_LENGTH 64
+#define TRAIL_MAX_PARTICLES 65536 // Slots are stored in 16 bits, see shader/trails.glsl
+#define TRAIL_GENERATIONS 256    // Keeps generation * 65536 + slot exact in a float
+#define SUB_EMITTER_MAX_EVENTS 131072 // Must match the shaders
+#define SUB_EMITTER_ON_DEATH 1
+#define SUB_EMITTER_ON_COLLISION 2
+#define BVH_BENCHMARK_PARTICLES 1000000
+#define BVH_VALIDATION_SEGMENTS 10000
+#define BENCHMARK_RUNS 4 // Only the fastest run counts
+#define WORKGROUP_CACHE_PATH "workgroup_sizes.cache"
+#define SPRITE_ATLAS_CACHE_PATH "sprite_atlas.cache"
+#define SPRITE_SMOKE_FRAMES 16
+#define SPRITE_SPARK_FRAMES 8
+#define WORKGROUP_TUNING_WARMUP_FRAMES 8
+#define WORKGROUP_TUNING_FRAMES 32
+#define COUNTER_READBACK_HASH_OFFSET 32
+#define COUNTER_READBACK_EVENTS_OFFSET 40
+#define COUNTER_READBACK_DRAWS_OFFSET 48
+#define COMPACTION_BLOCK_SIZE 1024
+#define POOL_BINDING_PARTICLE_DATA 0 // Pool bindings must match the shaders, they are set once in bind_particle_pool()
+#define POOL_BINDING_DEAD_INDICES 1
+#define POOL_BINDING_COUNTERS 2
+#define POOL_BINDING_DRAW_ARGS 3
+#define POOL_BINDING_ALIVE_FLAGS 4
+#define POOL_BINDING_EMISSION_DISPATCH_ARGS 5
+#define POOL_BINDING_SIMULATION_DISPATCH_ARGS 6
+#define POOL_BINDING_SUB_EMISSION_DISPATCH_ARGS 7
+#define POOL_BINDING_SUB_EMITTER_QUEUE 8
+#define POOL_BINDING_SUB_EMITTER_EVENTS 9
+#define POOL_BINDING_COMPACTION_OFFSETS 10
+#define POOL_BINDING_STATE_HASH 11
+#define POOL_BINDING_DRAW_COMMANDS 12
+#define POOL_BINDING_DRAW_INDICES 13
+#define SSBO_BINDING_DRAW_MATERIALS 14 // Standalone buffers that are also bound once
+#define SSBO_BINDING_SPRITE_FRAMES 15
+#define SSBO_BINDING_PER_PASS 16 // Passes bind the alive lists and their own buffers from here up, injected into the shaders
+#define SSBO_BINDING_ALIVE_PRE_SIM (SSBO_BINDING_PER_PASS + 0)
+#define SSBO_BINDING_ALIVE_POST_SIM (SSBO_BINDING_PER_PASS + 1)
+#define SSBO_BINDING_FORCES (SSBO_BINDING_PER_PASS + 2)
+#define SSBO_BINDING_TRAIL_HISTORY (SSBO_BINDING_PER_PASS + 3)
+#define SSBO_BINDING_TRAIL_SLOTS (SSBO_BINDING_PER_PASS + 4)
+#define SSBO_BINDING_BVH_NODES (SSBO_BINDING_PER_PASS + 5)
+#define SSBO_BINDING_BVH_TRIANGLES (SSBO_BINDING_PER_PASS + 6) // Highest binding, the simulation pass uses it
+#define SSBO_BINDING_BENCHMARK_OUTPUT (SSBO_BINDING_PER_PASS + 0) // Passes without a pre simulation list reuse its binding
+#define SSBO_BINDING_CURVE_KEYS (SSBO_BINDING_PER_PASS + 0)
+#define SSBO_BINDING_RIBBON_VERTICES (SSBO_BINDING_PER_PASS + 0)
+#define SSBO_BINDING_RIBBON_DRAW_ARGS (SSBO_BINDING_PER_PASS + 2)
+#define SSBO_BINDING_SCREEN_PARTICLES (SSBO_BINDING_PER_PASS + 0)
+#define SSBO_BINDING_TILE_COUNTS (SSBO_BINDING_PER_PASS + 2)
+#define SSBO_BINDING_TILE_INDICES (SSBO_BINDING_PER_PASS + 3)
+#define SSBO_BINDING_COUNT (SSBO_BINDING_BVH_TRIANGLES + 1)
+#define DRAW_MATERIAL_EMITTER 0
+#define DRAW_MATERIAL_SUB_EMITTER 1
+#define DRAW_MATERIAL_COUNT 2 // Must match shader/materials.glsl
+#define DRAW_COMMANDS_OFFSET 16 // Past draw_count and its padding, see shader/particle_draw_binning_cs.glsl
+#define DETERMINISTIC_TIME_STEP (1.0f / 60.0f)
+#define DETERMINISTIC_MAX_STEPS 4
+#define DETERMINISM_TEST_FRAMES 1000
+
+// std140 mirrors of the blocks declared in shader/uniforms.glsl.
 struct GlobalUniforms
 {
     DW_ALIGNED(16)
+    glm::mat4  light_view_proj;
+    glm::mat4  collision_view_proj;
+    glm::mat4  prev_collision_view_proj;
+    glm::mat4  camera_view;
+    glm::vec4  light_direction;
+    glm::vec4  light_color;
+    glm::ivec2 screen_size;
+    glm::ivec2 particle_size;
+    glm::ivec2 tile_count;
+    int32_t    particle_scale;
+    int32_t    particle_upsample;
+    float      shadow_bias;
+    float      soft_distance;
+    int32_t    force_count;
+    int32_t    bvh_node_count;
+    int32_t    collision_reprojection;
+};
+
+struct ViewUniforms
+{
+    DW_ALIGNED(16)
+    glm::mat4 view;
+    glm::mat4 proj;
     glm::mat4 view_proj;
+    glm::vec4 position;
+    float     particle_fraction;
+};
+
+struct EmitterUniforms
+{
+    DW_ALIGNED(16)
+    glm::vec3 position;
+    float     sphere_radius;
+    glm::vec3 direction;
+    float     rotation;
+    glm::vec3 constant_velocity;
+    float     viscosity;
+    glm::vec3 seeds;
+    float     delta_time;
+    float     min_initial_speed;
+    float     max_initial_speed;
+    float     min_lifetime;
+    float     max_lifetime;
+    float     restitution;
+    int32_t   emission_shape;
+    int32_t   direction_type;
+    int32_t   affected_by_gravity;
+    int32_t   depth_buffer_collision;
+    int32_t   particles_per_frame;
+    int32_t   pre_sim_idx;
+    int32_t   post_sim_idx;
+    int32_t   curve_row;
+    int32_t   analytic_step;
+    int32_t   deterministic;
+    uint32_t  step_index;
+    int32_t   particle_quota;
+    int32_t   trail_length;
+    int32_t   trail_head;
+    int32_t   trail_particles;
+    float     trail_width;
+    int32_t   sub_emitter_trigger;
+    int32_t   sub_emitter_children;
+    float     sub_emitter_speed;
+    float     sub_emitter_inherit;
+    float     sub_emitter_lifetime;
+    int32_t   max_substeps;
+    int32_t   adaptive_substeps;
+    float     substep_distance;
+    int32_t   measure_substeps;
+    int32_t   mesh_collision;
+    int32_t   billboard_mode;
+    glm::vec3 billboard_axis;
+    float     velocity_stretch;
+    float     rotation_variance;
+    float     min_angular_velocity;
+    float     max_angular_velocity;
+    uint32_t  trail_generation;
+};
+
+// std430 mirror of the per-emitter keys read by shader/curve_bake_cs.glsl.
+struct CurveKeys
+{
+    glm::vec4 colors[CURVE_MAX_MARKS];
+    float     positions[CURVE_MAX_MARKS];
+    glm::vec4 size_curve;
+    float     start_size;
+    float     end_size;
+    int32_t   mark_count;
+    int32_t   row;
+};
+
+// std430 mirror of DrawMaterial in shader/materials.glsl.
+struct DrawMaterial
+{
+    glm::vec4 tint        = glm::vec4(1.0f);
+    int32_t   curve_row   = 0;
+    float     size_scale  = 1.0f;
+    int32_t   first_frame = 0;
+    int32_t   frame_count = 0;
+};
+
+// A run of consecutive frames in the sprite atlas.
+struct SpriteAnimation
+{
+    std::string name;
+    int32_t     first_frame;
+    int32_t     frame_count;
 };
 
 enum EmissionShape
@@ -42,25 +235,89 @@ enum DirectionType
     DIRECTION_TYPE_OUTWARDS
 };
 
+// Selected with a command line flag by the tests in tests/CMakeLists.txt that need a GL context.
+enum GPUTest
+{
+    GPU_TEST_NONE,
+    GPU_TEST_DETERMINISM,
+    GPU_TEST_DIVERGENCE
+};
+
+// Must match shader/billboards.glsl
+enum BillboardMode
+{
+    BILLBOARD_SCREEN,
+    BILLBOARD_VELOCITY,
+    BILLBOARD_AXIS
+};
+
 enum PropertyChangeType
 {
     PROPERTY_CONSTANT,
     PROPERTY_OVER_TIME
 };
 
+enum SimulationLOD
+{
+    SIMULATION_LOD_FULL,
+    SIMULATION_LOD_HALF,
+    SIMULATION_LOD_QUARTER,
+    SIMULATION_LOD_FROZEN
+};
+
+// Passes whose workgroup size is picked by the autotuner. Tile binning and trail ribbons walk the simulation's
+// dispatch arguments, so they are compiled with the simulation's size.
+enum WorkgroupPass
+{
+    WORKGROUP_PASS_EMISSION,
+    WORKGROUP_PASS_SIMULATION,
+    WORKGROUP_PASS_SUB_EMISSION,
+    WORKGROUP_PASS_COUNT
+};
+
+enum ParticleRenderer
+{
+    PARTICLE_RENDERER_RASTERIZED,
+    PARTICLE_RENDERER_TILED
+};
+
+enum ParticleResolution
+{
+    PARTICLE_RESOLUTION_FULL,
+    PARTICLE_RESOLUTION_HALF,
+    PARTICLE_RESOLUTION_QUARTER
+};
+
 class GPUParticleSystem : public dw::Application
 {
+public:
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Exit code of an unattended GPU test, 0 when none was requested.
+    int gpu_test_exit_code() const
+    {
+        return m_gpu_test_exit_code;
+    }
+
 protected:
     // -----------------------------------------------------------------------------------------------------------------------------------
 
     bool init(int argc, const char* argv[]) override
     {
+        load_workgroup_sizes();
+
+        // The draw count read from a buffer and gl_DrawID are only core from 4.6.
+        m_multi_draw_supported = GLAD_GL_ARB_indirect_parameters && GLAD_GL_ARB_shader_draw_parameters;
+
         // Create GPU resources.
         if (!create_shaders())
             return false;
 
         load_mesh();
-        create_buffers();
+        create_bvh();
+        if (!create_buffers())
+            return false;
+
         create_textures();
         create_framebuffers();
 
@@ -75,7 +332,7 @@ protected:
         m_debug_draw.set_fade_start(5.0f);
         m_debug_draw.set_fade_end(10.0f);
 
-        m_color_gradient.getMarks().clear();
+        m_color_gradient.clearMarks();
         m_color_gradient.addMark(0.0f, ImColor(1.0f, 0.0f, 0.0f));
         m_color_gradient.addMark(0.225f, ImColor(1.0f, 1.0f, 0.0f));
         m_color_gradient.addMark(0.4f, ImColor(0.086f, 0.443f, 0.039f));
@@ -83,22 +340,36 @@ protected:
         m_color_gradient.addMark(0.825f, ImColor(0.0f, 0.011f, 0.969f));
         m_color_gradient.addMark(1.0f, ImColor(0.939f, 0.0f, 1.0f));
 
-        update_color_over_time_texture();
-        update_size_over_time_texture();
+        update_curve_keys();
 
         m_generator = std::mt19937(m_random());
 
         m_sky_model.initialize();
-        m_shadow_map.initialize(2048);
+        m_shadow_map.initialize(SHADOW_MAP_SIZE);
 
         m_sky_model.set_sun_angle(glm::radians(-30.0f));
-        m_shadow_map.set_direction(m_sky_model.direction());
         m_shadow_map.set_extents(12.0f);
 
+        create_static_shadow_map();
+
         glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
         m_position_transform = glm::translate(m_position_transform, glm::vec3(0.0f, 3.0f, 0.0f));
 
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::string(argv[i]) == "--determinism-test")
+            {
+                m_gpu_test = GPU_TEST_DETERMINISM;
+                run_determinism_test();
+            }
+            else if (std::string(argv[i]) == "--divergence-test")
+            {
+                m_gpu_test = GPU_TEST_DIVERGENCE;
+                run_divergence_check();
+            }
+        }
+
         return true;
     }
 
@@ -128,31 +399,151 @@ protected:
         // Update camera.
         update_camera();
 
+        collect_lighting_cost();
+
+        if (m_lighting_dirty)
+            update_lighting();
+        else
+            m_lighting_skipped_frames++;
+
+        if (m_collision_targets_dirty)
+            create_collision_targets();
+
+        // Before the uniforms, which carry the trail generation the new buffers belong to.
+        if (m_trails_dirty)
+            create_trail_buffers();
+
+        update_uniforms();
+
+        if (m_curves_dirty)
+            bake_curves();
+
+        // Benchmarks requested from the GUI run here, once this frame's uniform region is current.
+        if (m_run_force_benchmark)
+            run_force_benchmark();
+
+        if (m_run_prepass_benchmark)
+            run_prepass_benchmark();
+
+        if (m_forces_dirty)
+            upload_forces();
+
+        if (m_draw_materials_dirty)
+            upload_draw_materials();
+
         render_depth_prepass();
 
-        particle_kickoff();
-        particle_emission();
-        particle_simulation();
+        read_particle_counters();
+        update_particle_budget();
+
+        if (m_deterministic)
+            update_fixed_steps();
+        else
+            update_simulation_lod();
+
+        // Time elapsed queries can't nest, so the autotuner has the simulation to itself while it runs. Decided once so
+        // the query and the readback that collects it agree.
+        m_time_substeps = m_measure_substeps && !m_tuning_active && m_simulation_steps > 0;
+
+        for (uint32_t i = 0; i < m_simulation_steps; i++)
+        {
+            // The lists are swapped right before a step consumes them, so post always holds the newest written list and
+            // frames that don't step keep drawing it.
+            if (m_alive_swap_pending)
+                swap_alive_lists();
+
+            m_alive_swap_pending = true;
+
+            if (m_deterministic)
+                begin_fixed_step();
+
+            // Every step writes the next history slot, the block keeps pointing at the newest one afterwards.
+            if (m_trail_length > 0)
+                m_trail_head = (m_trail_head + 1) % m_trail_length;
+
+            update_emitter_uniforms();
+
+            particle_kickoff();
+            particle_emission();
+
+            // Only the last step is timed, its substep count is the one left in the counters for the readback.
+            bool timed = m_time_substeps && i == m_simulation_steps - 1;
+
+            if (timed)
+                glBeginQuery(GL_TIME_ELAPSED, m_simulation_queries[m_counter_readback->current_region()]);
+
+            particle_simulation();
+
+            if (timed)
+                glEndQuery(GL_TIME_ELAPSED);
+
+            if (sub_emitter_trigger() != 0)
+                particle_sub_emission();
+
+            if (m_deterministic)
+            {
+                particle_compaction();
+
+                // Every step is hashed into the running hash, so a divergence in a step that isn't the last of its
+                // frame still shows and can't cancel out by the end of the frame.
+                hash_particle_state();
+
+                if (m_divergence_check_active)
+                    m_particle_reference->step(reference_emitter());
+
+                m_step_index++;
+            }
+        }
+
+        // Rendering still reads the emitter block on frames that don't step.
+        if (m_simulation_steps == 0)
+            update_emitter_uniforms();
+
+        if (m_divergence_check_active && m_simulation_steps > 0)
+            check_divergence();
+
+        update_billboards();
+
+        if (multi_draw_active())
+            bin_particle_draws();
+
+        copy_particle_counters();
+
+        if (m_trail_length > 0)
+            generate_trail_ribbons();
 
-        m_sky_model.update_cubemap();
         render_shadow_map();
         render_lit_scene();
 
         m_sky_model.render_skybox(0, 0, m_width, m_height, m_main_camera->m_view, m_main_camera->m_projection, nullptr);
 
+        if (m_particle_renderer == PARTICLE_RENDERER_TILED || m_particle_resolution != PARTICLE_RESOLUTION_FULL)
+            render_particles_offscreen();
+
         if (m_show_grid)
             m_debug_draw.grid(m_main_camera->m_view_projection, 1.0f, 10.0f);
 
         m_debug_draw.render(nullptr, m_width, m_height, m_main_camera->m_view_projection, m_main_camera->m_position);
 
-        m_pre_sim_idx  = m_pre_sim_idx == 0 ? 1 : 0;
-        m_post_sim_idx = m_post_sim_idx == 0 ? 1 : 0;
+        advance_workgroup_tuning();
+
+        if (m_gpu_test != GPU_TEST_NONE)
+            update_gpu_test();
+
+        m_uniform_ring->end_frame();
+        m_counter_readback->end_frame();
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
     void shutdown() override
     {
+        glDeleteQueries(COUNTER_READBACK_REGIONS, m_simulation_queries);
+        glDeleteQueries(1, &m_lighting_query);
+
+        if (m_tuning_active)
+            glDeleteQueries(1, &m_tuning_query);
+
         m_shadow_map.shutdown();
         m_sky_model.shutdown();
     }
@@ -163,6 +554,9 @@ protected:
     {
         // Override window resized method to update camera projection.
         m_main_camera->update_projection(60.0f, 0.1f, CAMERA_FAR_PLANE, float(m_width) / float(m_height));
+
+        // Screen sized targets and the tile lists depend on the resolution.
+        create_framebuffers();
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -235,6 +629,7 @@ protected:
         settings.maximized             = false;
         settings.refresh_rate          = 60;
         settings.major_ver             = 4;
+        settings.minor_ver             = 5;
         settings.width                 = 1920;
         settings.height                = 1080;
         settings.title                 = "GPU Particle System (c) 2020 Dihara Wijetunga";
@@ -250,7 +645,7 @@ private:
 
     void debug_gui()
     {
-        std::string active_count = "Max Active Particles: " + std::to_string(m_max_active_particles);
+        std::string active_count = "Max Active Particles: " + std::to_string(m_max_active_particles) + " (Measured: " + std::to_string(m_alive_particles) + ")";
 
         ImGui::Text(active_count.c_str());
         ImGui::InputFloat3("Position", &m_position.x);
@@ -264,281 +659,2232 @@ private:
         ImGui::Checkbox("Affected by Gravity", &m_affected_by_gravity);
         ImGui::Checkbox("Depth Buffer Collision", &m_depth_buffer_collision);
         if (m_depth_buffer_collision)
+        {
+            m_collision_targets_dirty |= ImGui::SliderFloat("Collision Guard Band", &m_collision_guard_band, 0.0f, 0.5f);
+            ImGui::Checkbox("Reproject Previous Frame", &m_collision_reprojection);
+        }
+        ImGui::Checkbox("Mesh Collision (BVH)", &m_mesh_collision);
+        if (ImGui::Checkbox("Deterministic", &m_deterministic))
+            reset_simulation();
+        if (m_deterministic)
+            ImGui::Text("Step: %u, State Hash: %016llx", m_state_hash_step, (unsigned long long)m_state_hash);
+        ImGui::Checkbox("Simulation LOD", &m_simulation_lod);
+        if (m_simulation_lod)
+        {
+            const char* lods[] = { "Full", "Half", "Quarter", "Frozen" };
+
+            ImGui::SliderFloat("LOD Distance", &m_lod_distance, 1.0f, 100.0f);
+            ImGui::SliderFloat("LOD Bounds Radius", &m_lod_bounds_radius, 0.5f, 50.0f);
+            ImGui::Text("Current LOD: %s", lods[m_simulation_lod_level]);
+        }
+        ImGui::Text("Simulated Particles: %d (Alive: %d)", m_simulated_particles, m_alive_particles);
+        ImGui::Text("Simulation Savings: %.1f%%", m_alive_particle_frames > 0 ? 100.0 * (1.0 - double(m_simulated_particle_frames) / double(m_alive_particle_frames)) : 0.0);
+        if (ImGui::CollapsingHeader("Particle Counters"))
+            counters_gui();
+        if (ImGui::CollapsingHeader("Forces"))
+            forces_gui();
+        if (ImGui::CollapsingHeader("Trails"))
+            trails_gui();
+        if (ImGui::CollapsingHeader("Substeps"))
+            substeps_gui();
+        if (ImGui::CollapsingHeader("Scene BVH"))
+            bvh_gui();
+        if (ImGui::CollapsingHeader("Workgroup Sizes"))
+            workgroup_gui();
+        if (ImGui::CollapsingHeader("Draw Materials"))
+            draw_materials_gui();
+        if (ImGui::CollapsingHeader("Billboards"))
+            billboards_gui();
+        if (ImGui::CollapsingHeader("Sub-Emitters"))
+        {
+            ImGui::Checkbox("Spawn On Death", &m_sub_emitter_on_death);
+            ImGui::Checkbox("Spawn On Collision", &m_sub_emitter_on_collision);
+            ImGui::SliderInt("Children Per Event", &m_sub_emitter_children, 1, 64);
+            ImGui::InputFloat("Child Speed", &m_sub_emitter_speed);
+            ImGui::SliderFloat("Inherit Velocity", &m_sub_emitter_inherit, 0.0f, 1.0f);
+            ImGui::InputFloat("Child Lifetime", &m_sub_emitter_lifetime);
+            ImGui::Text("Queue Capacity: %d events/step", SUB_EMITTER_MAX_EVENTS);
+            if (m_deterministic)
+                ImGui::Text("Disabled in deterministic mode");
+        }
+        if (ImGui::CollapsingHeader("Particle Budget"))
+        {
+            ImGui::SliderInt("Global Particle Cap", &m_global_particle_cap, 1000, MAX_PARTICLES);
+            ImGui::SliderFloat("Emitter Priority", &m_emitter_priority, 0.0f, 10.0f);
+            ImGui::Text("Quota: %d (Weight: %.3f)", m_particle_quota, m_particle_budget.weights().empty() ? 0.0f : m_particle_budget.weights()[0]);
+        }
+        if (m_depth_buffer_collision || m_mesh_collision)
             ImGui::SliderFloat("Restitution", &m_restitution, 0.0f, 1.0f);
         ImGui::SliderFloat("Sphere Radius", &m_sphere_radius, 0.1f, 25.0f);
 
         if (ImGui::InputFloat("Start Size", &m_start_size))
-            update_size_over_time_texture();
+            update_curve_keys();
 
         if (ImGui::InputFloat("End Size", &m_end_size))
-            update_size_over_time_texture();
+            update_curve_keys();
 
         if (ImGui::Bezier("Size Over Time", m_size_curve))
-            update_size_over_time_texture();
+            update_curve_keys();
 
         if (ImGui::GradientEditor("Color Over Time:", &m_color_gradient, m_dragging_mark, m_selected_mark))
-            update_color_over_time_texture();
+            update_curve_keys();
+
+        const char* curve_resolutions[] = { "64", "128", "256", "512", "1024" };
+        if (ImGui::Combo("Curve Resolution", &m_curve_resolution, curve_resolutions, IM_ARRAYSIZE(curve_resolutions)))
+            create_curve_atlas();
+
+        const char* renderers[] = { "Rasterized", "Tiled" };
+        ImGui::Combo("Particle Renderer", (int*)&m_particle_renderer, renderers, IM_ARRAYSIZE(renderers));
+        if (m_particle_renderer == PARTICLE_RENDERER_TILED)
+            ImGui::SliderFloat("Soft Particle Distance", &m_soft_distance, 0.01f, 2.0f);
+
+        const char* resolutions[] = { "Full", "Half", "Quarter" };
+        if (ImGui::Combo("Particle Resolution", (int*)&m_particle_resolution, resolutions, IM_ARRAYSIZE(resolutions)))
+            create_particle_targets();
 
         ImGui::Checkbox("Show Grid", &m_show_grid);
         float sun_angle = m_sky_model.sun_angle();
-        ImGui::SliderAngle("Sun Angle", &sun_angle, 0.0f, -180.0f);
-        m_sky_model.set_sun_angle(sun_angle);
-        m_shadow_map.set_direction(m_sky_model.direction());
+        if (ImGui::SliderAngle("Sun Angle", &sun_angle, 0.0f, -180.0f))
+        {
+            m_sky_model.set_sun_angle(sun_angle);
+            m_lighting_dirty = true;
+        }
+        ImGui::Text("Lighting Updates: %d (Skipped Frames: %d)", m_lighting_updates, m_lighting_skipped_frames);
+        if (m_lighting_cost_samples > 0)
+        {
+            double average_ms = m_lighting_cost_ms / double(m_lighting_cost_samples);
+            ImGui::Text("Update Cost: %.3f ms, Time Saved: %.1f ms", average_ms, average_ms * double(m_lighting_skipped_frames));
+        }
         ImGui::InputFloat("Shadow Bias", &m_shadow_bias);
-    }
+        ImGui::SliderFloat("Particle Shadow Fraction", &m_particle_shadow_fraction, 0.05f, 1.0f);
 
-    // -----------------------------------------------------------------------------------------------------------------------------------
+        if (ImGui::CollapsingHeader("Benchmarks"))
+        {
+            if (ImGui::Button("Run Gradient Benchmark"))
+                run_gradient_benchmark();
 
-    void render_particles(std::unique_ptr<dw::gl::Program>& program, glm::mat4 view, glm::mat4 projection)
-    {
-        glEnable(GL_DEPTH_TEST);
+            ImGui::Text("Gradient Cache Rebuild: %.3f us", m_gradient_refresh_us);
+            ImGui::Text("Gradient Batch Lookup: %.3f ns/sample", m_gradient_sample_ns);
+            ImGui::Text("Gradient Max Cache Error: %f", m_gradient_max_error);
 
-        program->use();
+            if (ImGui::Button("Run Bezier Benchmark"))
+                run_bezier_benchmark();
+
+            ImGui::Text("Bezier Batch Evaluation: %.3f ns/sample", m_bezier_sample_ns);
+            ImGui::Text("Bezier Max Error: %f", m_bezier_max_error);
+
+            if (ImGui::Button("Run Job System Benchmark"))
+                run_job_system_benchmark();
 
-        program->set_uniform("u_Rotation", glm::radians(m_rotation));
-        program->set_uniform("u_View", view);
-        program->set_uniform("u_Proj", projection);
+            for (auto& result : m_job_scaling)
+                ImGui::Text("%2d Threads: %.3f ms (%.2fx)", result.first, result.second, m_job_scaling.front().second / result.second);
 
-        if (program->set_uniform("s_ColorOverTime", 0))
-            m_color_over_time->bind(0);
+            if (m_determinism_test_run == 0)
+            {
+                if (ImGui::Button("Run Determinism Test"))
+                    run_determinism_test();
+            }
+            else
+                ImGui::Text("Determinism Test: Run %d, Frame %d/%d", m_determinism_test_run, int(m_determinism_hashes[m_determinism_test_run - 1].size()), DETERMINISM_TEST_FRAMES);
+
+            ImGui::Text("%s", m_determinism_result.c_str());
+
+            ImGui::InputInt("Divergence Check Frames", &m_divergence_frames);
+            ImGui::InputInt("Divergence Check Interval", &m_divergence_interval);
+            ImGui::InputFloat("Divergence Tolerance", &m_divergence_tolerance, 0.0f, 0.0f, "%.6f");
+
+            if (m_divergence_check_active)
+                ImGui::Text("Divergence Check: Frame %u/%d", m_step_index, m_divergence_frames);
+            else if (ImGui::Button("Run Divergence Check"))
+                run_divergence_check();
+
+            ImGui::Text("%s", m_divergence_result.c_str());
+
+            if (ImGui::Button("Run Prepass Benchmark"))
+                m_run_prepass_benchmark = true;
+
+            ImGui::Text("Depth Prepass: %.3f ms (Screen), %.3f ms (Guard Band, %+.1f%%)", m_prepass_screen_ms, m_prepass_guard_ms, m_prepass_screen_ms > 0.0 ? 100.0 * (m_prepass_guard_ms / m_prepass_screen_ms - 1.0) : 0.0);
+            ImGui::Text("Visible Depth Copy: %.3f ms", m_prepass_copy_ms);
 
-        if (program->set_uniform("s_SizeOverTime", 1))
-            m_size_over_time->bind(1);
+            if (ImGui::Button("Run BVH Benchmark"))
+                run_bvh_benchmark();
 
-        m_particle_data_ssbo->bind_base(0);
-        m_alive_indices_ssbo[m_post_sim_idx]->bind_base(1);
+            ImGui::Text("BVH Build: %.3f ms (1 Thread), %.3f ms (%u Threads)", m_bvh_build_single_ms, m_bvh_build_multi_ms, m_bvh_build_threads);
+            ImGui::Text("BVH Traversal: %.3f ns/particle", m_bvh_traversal_ns);
 
-        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_draw_indirect_args_ssbo->handle());
+            if (ImGui::Button("Validate BVH"))
+                validate_bvh();
 
-        glDrawArraysIndirect(GL_TRIANGLES, 0);
+            ImGui::Text("%s", m_bvh_validation_result.c_str());
+
+            if (ImGui::Button("Run Force Benchmark"))
+                m_run_force_benchmark = true;
+
+            const char* force_types[] = { "Point", "Vortex", "Drag", "Vector Field" };
+
+            for (int i = 0; i < FORCE_TYPE_COUNT; i++)
+                ImGui::Text("%s: %.3f ns/particle/force", force_types[i], m_force_benchmark_ns[i]);
+        }
+
+        if (ImGui::CollapsingHeader("Profiler"))
+            dw::profiler::ui();
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void render_mesh(dw::Mesh* mesh, glm::mat4 model, std::unique_ptr<dw::gl::Program>& program)
+    void counters_gui()
     {
-        program->set_uniform("u_Model", model);
+        ImGui::Text("Read back %d frames late, %d samples dropped", COUNTER_READBACK_REGIONS, m_dropped_readbacks);
+        ImGui::Text("Alive: %d, Dead: %d, Emitted: %d", m_alive_particles, m_dead_particles, m_emitted_particles);
+        ImGui::Text("Pool Usage: %.1f%%", 100.0f * float(m_alive_particles) / float(MAX_PARTICLES));
+        ImGui::Text("Emission Budget: %d (Throttled: %llu)", m_emission_budget, (unsigned long long)m_throttled_particles);
+        ImGui::Text("Sub-Emitter Events: %d (Dropped: %d)", m_sub_emitter_events, m_sub_emitter_dropped);
 
-        // Bind vertex array.
-        mesh->mesh_vertex_array()->bind();
+        const float* graphs[] = { m_alive_history, m_dead_history, m_emitted_history, m_simulated_history };
+        const char*  labels[] = { "Alive", "Dead", "Emitted", "Simulated" };
 
-        for (uint32_t i = 0; i < mesh->sub_mesh_count(); i++)
+        for (int i = 0; i < 4; i++)
+            ImGui::PlotLines(labels[i], graphs[i], COUNTER_HISTORY_SIZE, m_counter_history_offset, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void forces_gui()
+    {
+        const char* force_types[] = { "Point", "Vortex", "Drag", "Vector Field" };
+
+        for (int i = 0; i < int(m_forces.size()); i++)
         {
-            dw::SubMesh& submesh = mesh->sub_meshes()[i];
+            ForceField& force = m_forces[i];
 
-            program->set_uniform("u_Color", glm::vec3(0.7f));
-            program->set_uniform("u_Direction", m_sky_model.direction());
-            program->set_uniform("u_LightColor", m_shadow_map.color());
+            ImGui::PushID(i);
+            ImGui::Separator();
 
-            // Issue draw call.
-            glDrawElementsBaseVertex(GL_TRIANGLES, submesh.index_count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * submesh.base_index), submesh.base_vertex);
+            int previous_type = force.type;
+
+            if (ImGui::Combo("Type", &force.type, force_types, IM_ARRAYSIZE(force_types)))
+                change_force_type(force, previous_type);
+
+            if (force.type == FORCE_VECTOR_FIELD)
+            {
+                m_forces_dirty |= ImGui::InputFloat3("Bounds Min", &force.position.x);
+                m_forces_dirty |= ImGui::InputFloat3("Bounds Max", &force.axis.x);
+            }
+            else if (force.type != FORCE_DRAG)
+            {
+                m_forces_dirty |= ImGui::InputFloat3("Position", &force.position.x);
+                m_forces_dirty |= ImGui::SliderFloat("Radius", &force.radius, 0.1f, 50.0f);
+                m_forces_dirty |= ImGui::SliderFloat("Falloff", &force.falloff, 0.0f, 4.0f);
+
+                if (force.type == FORCE_VORTEX)
+                    m_forces_dirty |= ImGui::InputFloat3("Axis", &force.axis.x);
+            }
+
+            m_forces_dirty |= ImGui::InputFloat("Strength", &force.strength);
+
+            if (ImGui::Button("Remove"))
+            {
+                m_forces.erase(m_forces.begin() + i);
+                m_forces_dirty = true;
+            }
+
+            ImGui::PopID();
+        }
+
+        if (m_forces.size() < MAX_FORCES && ImGui::Button("Add Force"))
+        {
+            ForceField force;
+
+            force.position = glm::vec4(m_position, 0.0f);
+            force.axis     = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+            force.type     = FORCE_POINT;
+            force.strength = 5.0f;
+            force.radius   = 5.0f;
+            force.falloff  = 1.0f;
+
+            m_forces.push_back(force);
+            m_forces_dirty = true;
         }
+
+        ImGui::Separator();
+        ImGui::InputText("Vector Field", m_vector_field_path, sizeof(m_vector_field_path));
+
+        if (ImGui::Button("Load Vector Field"))
+            load_vector_field(m_vector_field_path);
+
+        if (m_vector_field)
+            ImGui::Text("Volume: %dx%dx%d", m_vector_field->width(), m_vector_field->height(), m_vector_field->depth());
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void render_scene(std::unique_ptr<dw::gl::Program>& program)
+    void change_force_type(ForceField& force, int previous_type)
     {
-        // Bind shader program.
-        program->use();
+        if (force.type == previous_type)
+            return;
 
-        program->set_uniform("u_LightViewProj", m_shadow_map.projection() * m_shadow_map.view());
-        program->set_uniform("u_ViewProj", m_main_camera->m_view_projection);
-        program->set_uniform("u_Bias", m_shadow_bias);
+        if (force.type == FORCE_VECTOR_FIELD)
+        {
+            // There is a single volume bound at unit 2, so a second vector field force would only sample it again.
+            for (const ForceField& other : m_forces)
+            {
+                if (&other != &force && other.type == FORCE_VECTOR_FIELD)
+                {
+                    force.type = previous_type;
+                    return;
+                }
+            }
 
-        if (program->set_uniform("s_ShadowMap", 0))
-            m_shadow_map.texture()->bind(0);
+            force.position = glm::vec4(m_vector_field_bounds_min, 0.0f);
+            force.axis     = glm::vec4(m_vector_field_bounds_max, 0.0f);
+        }
+        else if (previous_type == FORCE_VECTOR_FIELD)
+        {
+            // The bounds are meaningless as a position and axis.
+            force.position = glm::vec4(m_position, 0.0f);
+            force.axis     = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+        }
 
-        // Draw scene.
-        render_mesh(m_playground.get(), glm::mat4(1.0f), program);
+        m_forces_dirty = true;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void render_lit_scene()
+    void substeps_gui()
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glViewport(0, 0, m_width, m_height);
+        ImGui::SliderInt("Max Substeps", &m_max_substeps, 1, 16);
+        ImGui::Checkbox("Adaptive Substeps", &m_adaptive_substeps);
+        if (m_adaptive_substeps)
+            ImGui::SliderFloat("Max Distance Per Substep", &m_substep_distance, 0.01f, 1.0f);
+        ImGui::Checkbox("Measure Substep Cost", &m_measure_substeps);
 
-        render_particles(m_particle_program, m_main_camera->m_view, m_main_camera->m_projection);
-        render_scene(m_mesh_lit_program);
+        if (m_measure_substeps && m_substeps_executed > 0)
+        {
+            ImGui::Text("Simulation: %.3f ms, %u substeps (%.2f per particle)", m_simulation_time_ns * 1e-6, m_substeps_executed, m_simulated_particles > 0 ? double(m_substeps_executed) / double(m_simulated_particles) : 0.0);
+            ImGui::Text("Cost: %.3f ns/substep", m_simulation_time_ns / double(m_substeps_executed));
+        }
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void render_shadow_map()
+    void workgroup_gui()
     {
-        m_shadow_map.begin_render();
+        const char* passes[] = { "Emission", "Simulation", "Sub-Emission" };
 
-        render_particles(m_particle_depth_program, m_shadow_map.view(), m_shadow_map.projection());
+        ImGui::Text("Device: %s", m_device_string.c_str());
 
-        m_mesh_depth_program->use();
-        m_mesh_depth_program->set_uniform("u_ViewProj", m_shadow_map.projection() * m_shadow_map.view());
-        render_mesh(m_playground.get(), glm::mat4(1.0f), m_mesh_depth_program);
+        for (int i = 0; i < WORKGROUP_PASS_COUNT; i++)
+            ImGui::Text("%s: %u", passes[i], m_workgroup_sizes[i]);
 
-        m_shadow_map.end_render();
+        if (m_tuning_active)
+            ImGui::Text("Tuning %s: %u (%u/%d)", passes[m_tuning_pass], m_tuning_candidates[m_tuning_candidate], m_tuning_candidate + 1, int(m_tuning_candidates.size()));
+        else if (ImGui::Button("Run Workgroup Autotuner"))
+            start_workgroup_tuning();
+
+        // Mean GPU time per dispatch, zero for candidates that weren't reached or whose pass never ran.
+        for (int i = 0; i < int(m_tuning_results.size()); i++)
+        {
+            for (uint32_t j = 0; j < m_tuning_candidates.size(); j++)
+            {
+                if (m_tuning_results[i][j] > 0.0)
+                    ImGui::Text("%s %4u: %.3f us", passes[i], m_tuning_candidates[j], m_tuning_results[i][j] * 1e-3);
+            }
+        }
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void render_depth_prepass()
+    void billboards_gui()
     {
-        m_scene_depth_fbo->bind();
-        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glViewport(0, 0, m_width, m_height);
+        const char* modes[] = { "Screen Aligned", "Velocity Stretched", "Axis Aligned" };
 
-        render_scene(m_depth_prepass_program);
+        ImGui::Combo("Billboard Mode", (int*)&m_billboard_mode, modes, IM_ARRAYSIZE(modes));
+
+        if (m_billboard_mode == BILLBOARD_VELOCITY)
+            ImGui::SliderFloat("Velocity Stretch", &m_velocity_stretch, 0.0f, 0.5f);
+        else if (m_billboard_mode == BILLBOARD_AXIS)
+            ImGui::InputFloat3("Billboard Axis", &m_billboard_axis.x);
+
+        // Rotation still spins particles at rest in velocity mode and the ones facing down the axis in axis mode
+        ImGui::SliderFloat("Rotation", &m_rotation, -180.0f, 180.0f);
+        ImGui::SliderFloat("Rotation Variance", &m_rotation_variance, 0.0f, 180.0f);
+        ImGui::InputFloat("Min Angular Velocity", &m_min_angular_velocity);
+        ImGui::InputFloat("Max Angular Velocity", &m_max_angular_velocity);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void particle_initialize()
+    void draw_materials_gui()
     {
-        m_particle_initialize_program->use();
+        const char* materials[] = { "Emitter", "Sub-Emitter" };
 
-        m_dead_indices_ssbo->bind_base(0);
-        m_counters_ssbo->bind_base(1);
+        if (m_multi_draw_supported)
+            ImGui::Checkbox("Multi-Draw Indirect", &m_multi_draw);
+        else
+            ImGui::Text("Multi-draw needs ARB_indirect_parameters and ARB_shader_draw_parameters");
 
-        m_particle_initialize_program->set_uniform("u_MaxParticles", MAX_PARTICLES);
+        if (multi_draw_active())
+            ImGui::Text("Draws: %u", m_multi_draw_count);
 
-        glDispatchCompute(ceil(float(MAX_PARTICLES) / float(LOCAL_SIZE)), 1, 1);
+        const SpriteAtlasStats& stats = m_sprite_atlas->stats();
 
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-    }
+        ImGui::Text("Sprite Atlas: %d frames, %u pages, %.0f%% occupied", int(m_sprite_atlas->frames().size()), m_sprite_atlas->page_count(), stats.occupancy * 100.0f);
+        ImGui::Text("%s in %.2f ms", stats.cached ? "Loaded from cache" : "Packed", stats.build_ms);
 
-    // -----------------------------------------------------------------------------------------------------------------------------------
+        std::vector<const char*> flipbooks = { "None" };
 
-    void particle_kickoff()
-    {
-        m_particle_update_kickoff_program->use();
+        for (const auto& animation : m_sprite_animations)
+            flipbooks.push_back(animation.name.c_str());
 
-        m_emission_delta = 1.0f / float(m_emission_rate); // In seconds
+        for (int i = 0; i < DRAW_MATERIAL_COUNT; i++)
+        {
+            ImGui::PushID(i);
+            ImGui::Separator();
+            ImGui::Text("%s", materials[i]);
 
-        m_particles_per_frame = 0;
+            int32_t flipbook = 0;
 
-        while (m_accumulator >= m_emission_delta)
-        {
-            m_accumulator -= m_emission_delta;
-            m_particles_per_frame++;
+            for (int32_t j = 0; j < int32_t(m_sprite_animations.size()); j++)
+            {
+                if (m_draw_materials[i].frame_count > 0 && m_draw_materials[i].first_frame == m_sprite_animations[j].first_frame)
+                    flipbook = j + 1;
+            }
+
+            if (ImGui::Combo("Flipbook", &flipbook, flipbooks.data(), int(flipbooks.size())))
+                set_material_flipbook(m_draw_materials[i], flipbook - 1);
+
+            m_draw_materials_dirty |= ImGui::ColorEdit4("Tint", &m_draw_materials[i].tint.x);
+            m_draw_materials_dirty |= ImGui::SliderFloat("Size Scale", &m_draw_materials[i].size_scale, 0.1f, 4.0f);
+
+            ImGui::PopID();
         }
+    }
 
-        m_particle_update_kickoff_program->set_uniform("u_ParticlesPerFrame", m_particles_per_frame);
-        m_particle_update_kickoff_program->set_uniform("u_PreSimIdx", m_pre_sim_idx);
-        m_particle_update_kickoff_program->set_uniform("u_PostSimIdx", m_post_sim_idx);
+    // -----------------------------------------------------------------------------------------------------------------------------------
 
-        m_particle_data_ssbo->bind_base(0);
-        m_dispatch_emission_indirect_args_ssbo->bind_base(1);
-        m_dispatch_simulation_indirect_args_ssbo->bind_base(2);
-        m_draw_indirect_args_ssbo->bind_base(3);
-        m_counters_ssbo->bind_base(4);
+    void bvh_gui()
+    {
+        const BVHStats& stats = m_bvh.stats();
 
-        glDispatchCompute(1, 1, 1);
+        ImGui::Text("Triangles: %d, Nodes: %u, Leaves: %u, Depth: %u", int(m_bvh.triangles().size()), stats.node_count, stats.leaf_count, stats.max_depth);
+        ImGui::Text("Memory: %.2f MB", double(stats.memory) / (1024.0 * 1024.0));
+        ImGui::Text("Build: %.3f ms", stats.build_ms);
 
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        if (m_mesh_collision && m_depth_buffer_collision)
+            ImGui::Text("Mesh collision replaces depth buffer collision");
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void particle_emission()
+    void trails_gui()
     {
-        m_particle_emission_program->use();
-
-        m_particle_emission_program->set_uniform("u_Seeds", m_seeds);
-        m_particle_emission_program->set_uniform("u_Position", m_position);
-        m_particle_emission_program->set_uniform("u_MinInitialSpeed", m_min_initial_speed);
-        m_particle_emission_program->set_uniform("u_MaxInitialSpeed", m_max_initial_speed);
-        m_particle_emission_program->set_uniform("u_MinLifetime", m_max_lifetime);
-        m_particle_emission_program->set_uniform("u_MaxLifetime", m_max_lifetime);
-        m_particle_emission_program->set_uniform("u_EmissionShape", int(m_emission_shape));
-        m_particle_emission_program->set_uniform("u_DirectionType", int(m_direction_type));
-        m_particle_emission_program->set_uniform("u_Direction", m_direction);
-        m_particle_emission_program->set_uniform("u_SphereRadius", m_sphere_radius);
-        m_particle_emission_program->set_uniform("u_PreSimIdx", m_pre_sim_idx);
+        m_trails_dirty |= ImGui::SliderInt("Trail Length", &m_trail_length, 0, TRAIL_MAX_LENGTH);
+        m_trails_dirty |= ImGui::SliderInt("Trail Particles", &m_trail_particles, 1, TRAIL_MAX_PARTICLES);
+        ImGui::SliderFloat("Trail Width", &m_trail_width, 0.01f, 2.0f);
 
-        m_particle_data_ssbo->bind_base(0);
-        m_dead_indices_ssbo->bind_base(1);
-        m_alive_indices_ssbo[m_pre_sim_idx]->bind_base(2);
-        m_counters_ssbo->bind_base(3);
+        // Both buffers are sized for every slot that can own a trail, so memory grows linearly with the length.
+        size_t history_size  = m_trail_history_ssbo ? sizeof(glm::vec4) * m_trail_particles * m_trail_length : 0;
+        size_t vertices_size = m_ribbon_vertices_ssbo ? sizeof(glm::vec4) * 4 * m_trail_particles * m_trail_length : 0;
 
-        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, m_dispatch_emission_indirect_args_ssbo->handle());
+        // Per frame: one history write per step, the ribbon pass reading the history and writing two vertices
+        // per point, and the draw reading the vertices back. Emission seeds the whole history of new particles.
+        uint64_t trails    = std::min(m_alive_particles, uint32_t(m_trail_particles));
+        uint64_t bandwidth = trails * (sizeof(glm::vec4) * m_simulation_steps + sizeof(glm::vec4) * m_trail_length + sizeof(glm::vec4) * 8 * m_trail_length);
 
-        glDispatchComputeIndirect(0);
+        bandwidth += uint64_t(std::min(m_emitted_particles, uint32_t(m_trail_particles))) * sizeof(glm::vec4) * m_trail_length;
 
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        ImGui::Text("History: %.2f MB, Ribbon Vertices: %.2f MB", double(history_size) / (1024.0 * 1024.0), double(vertices_size) / (1024.0 * 1024.0));
+        ImGui::Text("Trail Bandwidth: %.2f MB/frame (upper bound)", m_trail_length > 0 ? double(bandwidth) / (1024.0 * 1024.0) : 0.0);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void particle_simulation()
+    void run_gradient_benchmark()
     {
-        m_particle_simulation_program->use();
+        const int kMarks      = CURVE_MAX_MARKS;
+        const int kSamples    = 4096;
+        const int kIterations = 1000;
 
-        m_particle_simulation_program->set_uniform("u_DeltaTime", float(m_delta_seconds));
-        m_particle_simulation_program->set_uniform("u_Viscosity", m_viscosity);
-        m_particle_simulation_program->set_uniform("u_PreSimIdx", m_pre_sim_idx);
-        m_particle_simulation_program->set_uniform("u_PostSimIdx", m_post_sim_idx);
-        m_particle_simulation_program->set_uniform("u_ConstantVelocity", m_constant_velocity);
-        m_particle_simulation_program->set_uniform("u_AffectedByGravity", (int)m_affected_by_gravity);
-        m_particle_simulation_program->set_uniform("u_DepthBufferCollision", (int)m_depth_buffer_collision);
-        m_particle_simulation_program->set_uniform("u_Restitution", m_restitution);
-        m_particle_simulation_program->set_uniform("u_ViewProj", m_main_camera->m_view_projection);
-
-        if (m_particle_simulation_program->set_uniform("s_Depth", 0))
-            m_scene_depth_rt->bind(0);
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
 
-        if (m_particle_simulation_program->set_uniform("s_Normals", 1))
-            m_scene_normals_rt->bind(1);
+        ImGradient gradient;
+        gradient.clearMarks();
 
-        m_particle_data_ssbo->bind_base(0);
-        m_dead_indices_ssbo->bind_base(1);
-        m_alive_indices_ssbo[m_pre_sim_idx]->bind_base(2);
-        m_alive_indices_ssbo[m_post_sim_idx]->bind_base(3);
-        m_draw_indirect_args_ssbo->bind_base(4);
-        m_counters_ssbo->bind_base(5);
+        for (int i = 0; i < kMarks; i++)
+            gradient.addMark(dist(m_generator), ImColor(dist(m_generator), dist(m_generator), dist(m_generator), dist(m_generator)));
 
-        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, m_dispatch_simulation_indirect_args_ssbo->handle());
+        std::vector<float> positions(kSamples);
+        std::vector<float> colors(kSamples * 4);
 
-        glDispatchComputeIndirect(0);
+        for (int i = 0; i < kSamples; i++)
+            positions[i] = dist(m_generator);
 
-        glMemoryBarrier(GL_ALL_BARRIER_BITS);
-    }
+        auto start = std::chrono::high_resolution_clock::now();
 
-    // -----------------------------------------------------------------------------------------------------------------------------------
+        for (int i = 0; i < kIterations; i++)
+            gradient.refreshCache();
 
-    void load_mesh()
-    {
-        m_playground = dw::Mesh::load("Particle_Playground.obj");
-    }
+        auto middle = std::chrono::high_resolution_clock::now();
 
-    // -----------------------------------------------------------------------------------------------------------------------------------
+        for (int i = 0; i < kIterations; i++)
+            gradient.getColorsAt(positions.data(), colors.data(), kSamples);
+
+        auto end = std::chrono::high_resolution_clock::now();
+
+        m_gradient_refresh_us = std::chrono::duration<double, std::micro>(middle - start).count() / double(kIterations);
+        m_gradient_sample_ns  = std::chrono::duration<double, std::nano>(end - middle).count() / double(kIterations * kSamples);
+
+        // Check the single sweep cache against a brute force search for the surrounding marks.
+        const std::vector<ImGradientMark>& marks = gradient.getMarks();
+
+        m_gradient_max_error = 0.0f;
+
+        for (int i = 0; i < IM_GRADIENT_CACHE_SIZE; i++)
+        {
+            float                 position = i / float(IM_GRADIENT_CACHE_SIZE - 1);
+            const ImGradientMark* lower    = nullptr;
+            const ImGradientMark* upper    = nullptr;
+
+            for (const ImGradientMark& mark : marks)
+            {
+                if (mark.position < position && (!lower || lower->position < mark.position))
+                    lower = &mark;
+
+                if (mark.position >= position && (!upper || upper->position > mark.position))
+                    upper = &mark;
+            }
+
+            lower = lower ? lower : upper;
+            upper = upper ? upper : lower;
+
+            float delta = upper == lower ? 0.0f : (position - lower->position) / (upper->position - lower->position);
+            float color[4];
+
+            gradient.getColorAt((i + 0.5f) / float(IM_GRADIENT_CACHE_SIZE - 1), color);
+
+            for (int c = 0; c < 4; c++)
+            {
+                float expected       = lower->color[c] + (upper->color[c] - lower->color[c]) * delta;
+                m_gradient_max_error = std::max(m_gradient_max_error, std::abs(expected - color[c]));
+            }
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void run_bezier_benchmark()
+    {
+        const int kSamples    = 4096;
+        const int kIterations = 250;
+
+        ImGui::BezierCurve curve(m_size_curve);
+
+        std::vector<float> x(kSamples);
+        std::vector<float> y(kSamples);
+
+        for (int i = 0; i < kSamples; i++)
+            x[i] = i / float(kSamples - 1);
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (int i = 0; i < kIterations; i++)
+            curve.evaluate(x.data(), y.data(), kSamples);
+
+        auto end = std::chrono::high_resolution_clock::now();
+
+        m_bezier_sample_ns = std::chrono::duration<double, std::nano>(end - start).count() / double(kIterations * kSamples);
+
+        // Points generated directly from the curve parameter must map back onto the curve.
+        const float* P = m_size_curve;
+
+        m_bezier_max_error = 0.0f;
+
+        for (int i = 0; i < kSamples; i++)
+        {
+            float t  = i / float(kSamples - 1);
+            float u  = 1.0f - t;
+            float px = 3.0f * u * u * t * P[0] + 3.0f * u * t * t * P[2] + t * t * t;
+            float py = 3.0f * u * u * t * P[1] + 3.0f * u * t * t * P[3] + t * t * t;
+
+            m_bezier_max_error = std::max(m_bezier_max_error, std::abs(curve.evaluate(px) - py));
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void run_job_system_benchmark()
+    {
+        const uint32_t kEmitters   = 4096;
+        const uint32_t kSamples    = 256;
+        const uint32_t kBatchSize  = 64;
+        const uint32_t kIterations = 10;
+
+        // Per-emitter work representative of what a frame needs: advance the emission accumulator,
+        // sample both curves and pack the results for upload.
+        struct EmitterWork
+        {
+            float     accumulator;
+            float     size_curve[4];
+            glm::vec4 colors[kSamples];
+            float     sizes[kSamples];
+        };
+
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+        std::vector<EmitterWork>              emitters(kEmitters);
+        std::vector<float>                    positions(kSamples);
+
+        for (auto& emitter : emitters)
+        {
+            emitter.accumulator = 0.0f;
+
+            for (int i = 0; i < 4; i++)
+                emitter.size_curve[i] = dist(m_generator);
+        }
+
+        for (uint32_t i = 0; i < kSamples; i++)
+            positions[i] = i / float(kSamples - 1);
+
+        const ImGradient& gradient = m_color_gradient;
+        float             delta    = float(m_delta_seconds);
+
+        auto work = [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                EmitterWork& emitter = emitters[i];
+
+                emitter.accumulator += delta;
+
+                ImGui::BezierCurve curve(emitter.size_curve);
+                curve.evaluate(positions.data(), emitter.sizes, kSamples);
+                gradient.getColorsAt(positions.data(), &emitter.colors[0].x, kSamples);
+            }
+        };
+
+        m_job_scaling.clear();
+
+        uint32_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+        for (uint32_t threads = 1; ; threads = std::min(threads * 2, max_threads))
+        {
+            JobSystem jobs(threads - 1);
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            for (uint32_t i = 0; i < kIterations; i++)
+                jobs.parallel_for(kEmitters, kBatchSize, work);
+
+            auto end = std::chrono::high_resolution_clock::now();
+
+            m_job_scaling.push_back({ threads, std::chrono::duration<double, std::milli>(end - start).count() / double(kIterations) });
+
+            if (threads == max_threads)
+                break;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Runs the same scenario twice from a reset, one fixed step per frame, and compares the state hash of every step.
+    void run_determinism_test()
+    {
+        m_deterministic        = true;
+        m_determinism_test_run = 1;
+        m_determinism_result   = "";
+
+        m_determinism_hashes[0].clear();
+        m_determinism_hashes[1].clear();
+
+        reset_simulation();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Started with a command line flag, the app runs the test unattended and asks the framework to exit once it is
+    // done, main() then returns the result.
+    void update_gpu_test()
+    {
+        if (m_gpu_test == GPU_TEST_DETERMINISM && m_determinism_test_run == 0)
+        {
+            std::cout << m_determinism_result << std::endl;
+
+            m_gpu_test_exit_code = m_determinism_passed ? 0 : 1;
+        }
+        else if (m_gpu_test == GPU_TEST_DIVERGENCE && !m_divergence_check_active)
+        {
+            std::cout << m_divergence_result << std::endl;
+
+            m_gpu_test_exit_code = m_divergence_passed ? 0 : 1;
+        }
+        else
+            return;
+
+        m_gpu_test = GPU_TEST_NONE;
+        request_exit();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void record_determinism_hash(uint64_t hash)
+    {
+        std::vector<uint64_t>& hashes = m_determinism_hashes[m_determinism_test_run - 1];
+
+        if (hashes.size() >= DETERMINISM_TEST_FRAMES)
+            return;
+
+        hashes.push_back(hash);
+
+        if (hashes.size() < DETERMINISM_TEST_FRAMES)
+            return;
+
+        if (m_determinism_test_run == 1)
+        {
+            // Steps of the first run still in flight are ignored since they carry the old run id.
+            m_determinism_test_run = 2;
+            reset_simulation();
+            return;
+        }
+
+        m_determinism_test_run = 0;
+
+        auto mismatch = std::mismatch(m_determinism_hashes[0].begin(), m_determinism_hashes[0].end(), m_determinism_hashes[1].begin());
+
+        m_determinism_passed = mismatch.first == m_determinism_hashes[0].end();
+
+        if (m_determinism_passed)
+            m_determinism_result = "Determinism Test: Passed, " + std::to_string(DETERMINISM_TEST_FRAMES) + " frames identical";
+        else
+            m_determinism_result = "Determinism Test: Failed, first divergence at frame " + std::to_string(mismatch.first - m_determinism_hashes[0].begin());
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Steps the CPU reference alongside the GPU and compares both states every m_divergence_interval frames.
+    void run_divergence_check()
+    {
+        if (!m_particle_reference)
+            m_particle_reference = std::make_unique<ParticleReference>(MAX_PARTICLES);
+
+        m_deterministic           = true;
+        m_divergence_check_active = true;
+        m_divergence_interval     = std::max(m_divergence_interval, 1);
+        m_divergence_checks       = 0;
+        m_divergence_exact        = 0;
+        m_divergence_result       = "";
+
+        reset_simulation();
+        m_particle_reference->reset();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void check_divergence()
+    {
+        if (m_step_index % m_divergence_interval != 0 && m_step_index < uint32_t(m_divergence_frames))
+            return;
+
+        DW_SCOPED_SAMPLE("Divergence Check");
+
+        // A debug tool, so a blocking readback of the whole pool is acceptable here.
+        uint32_t counters[5];
+
+        m_particle_pool->get_data(m_counters_range, 0, sizeof(counters), counters);
+
+        uint32_t alive_count = counters[1 + m_post_sim_idx];
+
+        m_divergence_alive.resize(alive_count);
+        m_divergence_particles.resize(MAX_PARTICLES);
+
+        m_particle_pool->get_data(m_alive_indices_range[m_post_sim_idx], 0, sizeof(uint32_t) * alive_count, m_divergence_alive.data());
+        m_particle_pool->get_data(m_particle_data_range, 0, sizeof(ReferenceParticle) * MAX_PARTICLES, m_divergence_particles.data());
+
+        ParticleDivergence divergence = m_particle_reference->compare(m_divergence_particles.data(), m_divergence_alive.data(), alive_count, m_divergence_tolerance);
+
+        m_divergence_checks++;
+
+        if (divergence.diverged)
+        {
+            char message[256];
+            snprintf(message, sizeof(message), "Diverged at frame %u: particle %u (slot %u) %s, GPU %f, CPU %f", m_step_index, divergence.list_index, divergence.slot, divergence.field.c_str(), divergence.gpu, divergence.cpu);
+
+            m_divergence_result       = message;
+            m_divergence_check_active = false;
+            m_divergence_passed       = false;
+            return;
+        }
+
+        // Hashes only match when both backends produce bit identical floats, which is reported but not required.
+        if (ParticleReference::step_hash(m_divergence_particles.data(), m_divergence_alive.data(), alive_count, m_step_index - 1) == m_particle_reference->step_hash())
+            m_divergence_exact++;
+
+        if (m_step_index >= uint32_t(m_divergence_frames))
+        {
+            m_divergence_result       = "No divergence in " + std::to_string(m_divergence_checks) + " checks (" + std::to_string(m_divergence_exact) + " bit exact)";
+            m_divergence_check_active = false;
+            m_divergence_passed       = true;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    ReferenceEmitter reference_emitter()
+    {
+        ReferenceEmitter emitter;
+
+        emitter.position            = m_position;
+        emitter.direction           = m_direction;
+        emitter.constant_velocity   = m_constant_velocity;
+        emitter.sphere_radius       = m_sphere_radius;
+        emitter.viscosity           = m_viscosity;
+        emitter.delta_time          = m_simulation_delta;
+        emitter.min_initial_speed   = m_min_initial_speed;
+        emitter.max_initial_speed   = m_max_initial_speed;
+        emitter.min_lifetime        = m_min_lifetime;
+        emitter.max_lifetime        = m_max_lifetime;
+        emitter.emission_shape      = m_emission_shape;
+        emitter.direction_type      = m_direction_type;
+        emitter.affected_by_gravity = m_affected_by_gravity;
+        emitter.emission_count      = m_particles_per_frame;
+        emitter.step_index          = m_step_index;
+        emitter.particle_quota      = m_particle_quota;
+        emitter.forces              = m_forces.data();
+        emitter.force_count         = uint32_t(m_forces.size());
+        emitter.max_substeps        = m_max_substeps;
+        emitter.adaptive_substeps   = m_adaptive_substeps;
+        emitter.substep_distance    = m_substep_distance;
+
+        return emitter;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // GPU time of the fastest of a few runs in nanoseconds, which keeps clock ramp up and other work out of the numbers.
+    template <typename F>
+    double time_gpu_best_of(int runs, F&& dispatch)
+    {
+        GLuint query;
+        glGenQueries(1, &query);
+
+        GLuint64 best = UINT64_MAX;
+
+        for (int i = 0; i < runs; i++)
+        {
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            dispatch();
+            glEndQuery(GL_TIME_ELAPSED);
+
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+
+            best = std::min(best, elapsed);
+        }
+
+        glDeleteQueries(1, &query);
+
+        return double(best);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Times FORCE_BENCHMARK_FORCES forces of each type against a synthetic particle pool, net of the cost with an empty list.
+    void run_force_benchmark()
+    {
+        m_run_force_benchmark = false;
+
+        auto time_forces = [&](uint32_t force_count) {
+            GlobalUniforms global = m_global_uniforms;
+            global.force_count    = force_count;
+
+            size_t offset = 0;
+            void*  data   = m_uniform_ring->allocate(sizeof(GlobalUniforms), offset);
+
+            memcpy(data, &global, sizeof(GlobalUniforms));
+            m_uniform_ring->bind_range(0, offset, sizeof(GlobalUniforms));
+
+            m_force_benchmark_program->use();
+            m_force_benchmark_program->set_uniform("u_ParticleCount", FORCE_BENCHMARK_PARTICLES);
+
+            m_force_benchmark_ssbo->bind_base(SSBO_BINDING_BENCHMARK_OUTPUT);
+            m_forces_ssbo->bind_base(SSBO_BINDING_FORCES);
+
+            if (m_vector_field)
+                m_vector_field->bind(2);
+
+            return time_gpu_best_of(BENCHMARK_RUNS, [&]() { glDispatchCompute((FORCE_BENCHMARK_PARTICLES + LOCAL_SIZE - 1) / LOCAL_SIZE, 1, 1); });
+        };
+
+        double baseline = time_forces(0);
+
+        for (int type = 0; type < FORCE_TYPE_COUNT; type++)
+        {
+            std::vector<ForceField> forces(FORCE_BENCHMARK_FORCES);
+
+            for (int i = 0; i < FORCE_BENCHMARK_FORCES; i++)
+            {
+                float angle = float(i) / float(FORCE_BENCHMARK_FORCES) * 2.0f * float(M_PI);
+
+                forces[i].position = type == FORCE_VECTOR_FIELD ? glm::vec4(-10.0f) : glm::vec4(cosf(angle) * 5.0f, 2.0f, sinf(angle) * 5.0f, 0.0f);
+                forces[i].axis     = type == FORCE_VECTOR_FIELD ? glm::vec4(10.0f) : glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+                forces[i].type     = type;
+                forces[i].strength = 1.0f;
+                forces[i].radius   = 5.0f;
+                forces[i].falloff  = 1.0f;
+            }
+
+            m_forces_ssbo->set_data(0, sizeof(ForceField) * forces.size(), forces.data());
+
+            m_force_benchmark_ns[type] = std::max(time_forces(FORCE_BENCHMARK_FORCES) - baseline, 0.0) / (double(FORCE_BENCHMARK_PARTICLES) * FORCE_BENCHMARK_FORCES);
+        }
+
+        // Put back this frame's global block and the scene's force list.
+        m_uniform_ring->bind_range(0, m_global_uniforms_offset, sizeof(GlobalUniforms));
+        m_forces_dirty = true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Build time with one thread against the whole pool, then the GPU cost of traversing one particle step per thread,
+    // net of the cost of the dispatch without the traversal.
+    void run_bvh_benchmark()
+    {
+        std::vector<glm::vec3> positions;
+        gather_scene_triangles(positions);
+
+        auto time_build = [&](uint32_t threads) {
+            JobSystem jobs(threads - 1);
+            BVH       bvh;
+            double    best = DBL_MAX;
+
+            for (int i = 0; i < 3; i++)
+            {
+                bvh.build(positions, jobs);
+                best = std::min(best, bvh.stats().build_ms);
+            }
+
+            return best;
+        };
+
+        m_bvh_build_threads   = std::max(std::thread::hardware_concurrency(), 1u);
+        m_bvh_build_single_ms = time_build(1);
+        m_bvh_build_multi_ms  = time_build(m_bvh_build_threads);
+
+        if (!m_bvh_nodes_ssbo)
+            return;
+
+        m_bvh_benchmark_program->use();
+        m_bvh_benchmark_program->set_uniform("u_ParticleCount", BVH_BENCHMARK_PARTICLES);
+        m_bvh_benchmark_program->set_uniform("u_BoundsMin", m_bvh.bounds_min());
+        m_bvh_benchmark_program->set_uniform("u_BoundsMax", m_bvh.bounds_max());
+        m_bvh_benchmark_program->set_uniform("u_SegmentLength", m_max_initial_speed * DETERMINISTIC_TIME_STEP);
+
+        m_force_benchmark_ssbo->bind_base(SSBO_BINDING_BENCHMARK_OUTPUT);
+        m_bvh_nodes_ssbo->bind_base(SSBO_BINDING_BVH_NODES);
+        m_bvh_triangles_ssbo->bind_base(SSBO_BINDING_BVH_TRIANGLES);
+
+        auto time_traversal = [&](int32_t traverse) {
+            m_bvh_benchmark_program->set_uniform("u_Traverse", traverse);
+
+            return time_gpu_best_of(BENCHMARK_RUNS, [&]() { glDispatchCompute((BVH_BENCHMARK_PARTICLES + LOCAL_SIZE - 1) / LOCAL_SIZE, 1, 1); });
+        };
+
+        double baseline = time_traversal(0);
+
+        m_bvh_traversal_ns = std::max(time_traversal(1) - baseline, 0.0) / double(BVH_BENCHMARK_PARTICLES);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Checks the structure of the scene BVH, then that the stackless traversal finds the same closest hit as testing
+    // every triangle for random segments through the scene.
+    void validate_bvh()
+    {
+        std::string error;
+
+        if (!m_bvh.validate(error))
+        {
+            m_bvh_validation_result = "BVH Invalid: " + error;
+            return;
+        }
+
+        std::mt19937                          generator(1234);
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+        glm::vec3 bounds_min = m_bvh.bounds_min();
+        glm::vec3 extent     = m_bvh.bounds_max() - bounds_min;
+        float     length     = glm::length(extent);
+        uint32_t  hits       = 0;
+        uint32_t  mismatches = 0;
+
+        for (uint32_t i = 0; i < BVH_VALIDATION_SEGMENTS; i++)
+        {
+            // Segments start anywhere in the bounds and reach up to half way across them.
+            glm::vec3 origin    = bounds_min + extent * glm::vec3(dist(generator), dist(generator), dist(generator));
+            glm::vec3 direction = glm::vec3(dist(generator), dist(generator), dist(generator)) * 2.0f - 1.0f;
+
+            direction *= 0.5f * length * dist(generator);
+
+            float    t, expected_t;
+            uint32_t triangle, expected_triangle;
+
+            bool hit      = m_bvh.intersect(origin, direction, 1.0f, t, triangle);
+            bool expected = m_bvh.intersect_brute_force(origin, direction, 1.0f, expected_t, expected_triangle);
+
+            // Triangles sharing the hit point may be reported in a different order, so only the distance is compared.
+            if (hit != expected || (hit && fabsf(t - expected_t) > 1e-5f))
+                mismatches++;
+
+            if (expected)
+                hits++;
+        }
+
+        char result[256];
+        snprintf(result, sizeof(result), "BVH %s: %u/%d segments hit, %u mismatches", mismatches == 0 ? "Valid" : "Invalid", hits, BVH_VALIDATION_SEGMENTS, mismatches);
+
+        m_bvh_validation_result = result;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool multi_draw_active()
+    {
+        return m_multi_draw && m_multi_draw_supported;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_particles(std::unique_ptr<dw::gl::Program>& program, std::unique_ptr<dw::gl::Program>& multi_draw_program)
+    {
+        glEnable(GL_DEPTH_TEST);
+
+        bool multi_draw = multi_draw_active();
+
+        if (multi_draw)
+            multi_draw_program->use();
+        else
+            program->use();
+
+        m_curve_atlas->bind(0);
+        m_sprite_atlas->bind(1);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_particle_pool->handle());
+
+        if (multi_draw)
+        {
+            // One command per material with particles, the count is read from the parameter buffer.
+            glMultiDrawArraysIndirectCountARB(GL_TRIANGLES, (const void*)(m_draw_commands_range.offset + DRAW_COMMANDS_OFFSET), m_draw_commands_range.offset, DRAW_MATERIAL_COUNT, 0);
+        }
+        else
+        {
+            m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_ALIVE_POST_SIM, m_alive_indices_range[m_post_sim_idx]);
+
+            glDrawArraysIndirect(GL_TRIANGLES, (const void*)m_draw_args_range.offset);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_trails()
+    {
+        if (m_trail_length == 0)
+            return;
+
+        DW_SCOPED_SAMPLE("Trail Render");
+
+        m_trail_program->use();
+
+        m_ribbon_vertices_ssbo->bind_base(SSBO_BINDING_RIBBON_VERTICES);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_ribbon_draw_args_ssbo->handle());
+
+        glDrawArraysIndirect(GL_TRIANGLE_STRIP, 0);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_particles_tiled()
+    {
+        // Bin every visible particle into the screen tiles it overlaps.
+        m_particle_tile_binning_program->use();
+
+        m_curve_atlas->bind(0);
+
+        glClearNamedBufferData(m_tile_counts_ssbo->handle(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_ALIVE_POST_SIM, m_alive_indices_range[m_post_sim_idx]);
+        m_screen_particles_ssbo->bind_base(SSBO_BINDING_SCREEN_PARTICLES);
+        m_tile_counts_ssbo->bind_base(SSBO_BINDING_TILE_COUNTS);
+        m_tile_indices_ssbo->bind_base(SSBO_BINDING_TILE_INDICES);
+
+        // The simulation dispatch covers at least as many threads as there are alive particles.
+        glDispatchComputeIndirect(m_simulation_dispatch_args_range.offset);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // Blend each tile's particles in shared memory against the scene depth.
+        m_particle_tile_render_program->use();
+
+        if (m_particle_resolution == PARTICLE_RESOLUTION_FULL)
+            m_scene_depth_rt->bind(0);
+        else
+            m_particle_depth_rt->bind(0);
+
+        m_screen_particles_ssbo->bind_base(SSBO_BINDING_SCREEN_PARTICLES);
+        m_tile_counts_ssbo->bind_base(SSBO_BINDING_TILE_COUNTS);
+        m_tile_indices_ssbo->bind_base(SSBO_BINDING_TILE_INDICES);
+
+        m_particle_rt->bind_image(0, 0, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+        glDispatchCompute(m_tile_count_x, m_tile_count_y, 1);
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void downsample_scene_depth()
+    {
+        m_particle_fbo->bind();
+        glViewport(0, 0, m_particle_width, m_particle_height);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_ALWAYS);
+
+        m_depth_downsample_program->use();
+
+        m_scene_depth_rt->bind(0);
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glDepthFunc(GL_LESS);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_particles_offscreen()
+    {
+        {
+            DW_SCOPED_SAMPLE("Offscreen Particles");
+
+            if (m_particle_resolution != PARTICLE_RESOLUTION_FULL)
+                downsample_scene_depth();
+
+            if (m_particle_renderer == PARTICLE_RENDERER_TILED)
+                render_particles_tiled();
+            else
+            {
+                // Depth was already filled by the downsample, only the color needs clearing.
+                m_particle_fbo->bind();
+                glViewport(0, 0, m_particle_width, m_particle_height);
+                glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+
+                // The depth target holds the downsampled scene depth the upsample weights against, so particles only test it.
+                glDepthMask(GL_FALSE);
+
+                render_particles(m_particle_program, m_particle_multi_draw_program);
+                render_trails();
+
+                glDepthMask(GL_TRUE);
+            }
+        }
+
+        {
+            DW_SCOPED_SAMPLE("Particle Upsample");
+            composite_particles();
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void composite_particles()
+    {
+        // Composite the premultiplied result over the lit scene in a single pass.
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, m_width, m_height);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+        m_particle_composite_program->use();
+
+        m_particle_rt->bind(0);
+        m_particle_depth_rt->bind(1);
+        m_scene_depth_rt->bind(2);
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_mesh(dw::Mesh* mesh, glm::mat4 model, std::unique_ptr<dw::gl::Program>& program)
+    {
+        program->set_uniform("u_Model", model);
+        program->set_uniform("u_Color", glm::vec3(0.7f));
+
+        // Bind vertex array.
+        mesh->mesh_vertex_array()->bind();
+
+        for (uint32_t i = 0; i < mesh->sub_mesh_count(); i++)
+        {
+            dw::SubMesh& submesh = mesh->sub_meshes()[i];
+
+            // Issue draw call.
+            glDrawElementsBaseVertex(GL_TRIANGLES, submesh.index_count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * submesh.base_index), submesh.base_vertex);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_scene(std::unique_ptr<dw::gl::Program>& program)
+    {
+        // Bind shader program.
+        program->use();
+
+        m_shadow_map.texture()->bind(0);
+
+        // Draw scene.
+        render_mesh(m_playground.get(), glm::mat4(1.0f), program);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_lit_scene()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glViewport(0, 0, m_width, m_height);
+
+        if (m_particle_renderer == PARTICLE_RENDERER_RASTERIZED && m_particle_resolution == PARTICLE_RESOLUTION_FULL)
+        {
+            render_particles(m_particle_program, m_particle_multi_draw_program);
+            render_trails();
+        }
+
+        render_scene(m_mesh_lit_program);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void update_lighting()
+    {
+        DW_SCOPED_SAMPLE("Update Lighting");
+
+        // Only one update is timed at a time, a sun dragged every frame is sampled as fast as results come back.
+        bool timed = !m_lighting_query_pending;
+        auto start = std::chrono::high_resolution_clock::now();
+
+        if (timed)
+            glBeginQuery(GL_TIME_ELAPSED, m_lighting_query);
+
+        // Everything derived from the sun direction is only regenerated when it changes.
+        m_sky_model.update_cubemap();
+        m_shadow_map.set_direction(m_sky_model.direction());
+
+        if (timed)
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+
+            m_lighting_query_pending = true;
+            m_lighting_cpu_ms        = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+
+        m_lighting_dirty      = false;
+        m_static_shadow_dirty = true;
+        m_lighting_updates++;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // The cost of an update is its CPU submission time plus the GPU time of the cubemap regeneration, read back once
+    // the query is available so it never stalls.
+    void collect_lighting_cost()
+    {
+        if (!m_lighting_query_pending)
+            return;
+
+        GLint available = 0;
+        glGetQueryObjectiv(m_lighting_query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (!available)
+            return;
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(m_lighting_query, GL_QUERY_RESULT, &elapsed);
+
+        m_lighting_cost_ms += m_lighting_cpu_ms + double(elapsed) / 1000000.0;
+        m_lighting_cost_samples++;
+        m_lighting_query_pending = false;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_static_shadow_map()
+    {
+        m_static_shadow_fbo->bind();
+        glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+
+        m_mesh_depth_program->use();
+        render_mesh(m_playground.get(), glm::mat4(1.0f), m_mesh_depth_program);
+
+        m_static_shadow_dirty = false;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_shadow_map()
+    {
+        m_uniform_ring->bind_range(1, m_light_view_uniforms, sizeof(ViewUniforms));
+
+        // Rendered here rather than in update_lighting() so the light's view block is already in the ring.
+        if (m_static_shadow_dirty)
+            render_static_shadow_map();
+
+        m_shadow_map.begin_render();
+
+        glCopyImageSubData(m_static_shadow_rt->id(), GL_TEXTURE_2D, 0, 0, 0, 0, m_shadow_map.texture()->id(), GL_TEXTURE_2D, 0, 0, 0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1);
+
+        render_particles(m_particle_depth_program, m_particle_depth_multi_draw_program);
+
+        m_shadow_map.end_render();
+
+        m_uniform_ring->bind_range(1, m_camera_view_uniforms, sizeof(ViewUniforms));
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_depth_prepass()
+    {
+        // Last frame's targets become the history the simulation reprojects into.
+        m_collision_index = 1 - m_collision_index;
+
+        render_collision_depth(m_collision_index, true);
+        copy_visible_depth(m_collision_index);
+
+        m_collision_history_valid = true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_collision_depth(int32_t index, bool guard_band)
+    {
+        m_collision_fbo[index]->bind();
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        if (guard_band)
+        {
+            glViewport(0, 0, m_width + 2 * m_collision_guard_x, m_height + 2 * m_collision_guard_y);
+            m_uniform_ring->bind_range(1, m_collision_view_uniforms, sizeof(ViewUniforms));
+        }
+        else
+            glViewport(m_collision_guard_x, m_collision_guard_y, m_width, m_height);
+
+        render_scene(m_depth_prepass_program);
+
+        m_uniform_ring->bind_range(1, m_camera_view_uniforms, sizeof(ViewUniforms));
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void copy_visible_depth(int32_t index)
+    {
+        glCopyImageSubData(m_collision_depth_rt[index]->id(), GL_TEXTURE_2D, 0, m_collision_guard_x, m_collision_guard_y, 0, m_scene_depth_rt->id(), GL_TEXTURE_2D, 0, 0, 0, 0, m_width, m_height, 1);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Prepass with and without the guard band, and the copy of the visible depth. Rendered into the targets the next
+    // prepass overwrites, so the history stays intact.
+    void run_prepass_benchmark()
+    {
+        m_run_prepass_benchmark = false;
+
+        int32_t index = 1 - m_collision_index;
+
+        m_prepass_screen_ms = time_gpu_best_of(BENCHMARK_RUNS, [&]() { render_collision_depth(index, false); }) * 1e-6;
+        m_prepass_guard_ms  = time_gpu_best_of(BENCHMARK_RUNS, [&]() { render_collision_depth(index, true); }) * 1e-6;
+        m_prepass_copy_ms   = time_gpu_best_of(BENCHMARK_RUNS, [&]() { copy_visible_depth(index); }) * 1e-6;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void particle_initialize()
+    {
+        m_particle_initialize_program->use();
+
+        m_particle_initialize_program->set_uniform("u_MaxParticles", MAX_PARTICLES);
+
+        glDispatchCompute(ceil(float(MAX_PARTICLES) / float(LOCAL_SIZE)), 1, 1);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Starts over from an empty pool so that a deterministic run only depends on the step index.
+    void reset_simulation()
+    {
+        particle_initialize();
+        reset_trail_slots();
+
+        m_particle_pool->clear(m_state_hash_range);
+
+        m_pre_sim_idx                = 0;
+        m_post_sim_idx               = 1;
+        m_alive_swap_pending         = false;
+        m_step_index                 = 0;
+        m_accumulator                = 0.0f;
+        m_fixed_step_accumulator     = 0.0f;
+        m_fixed_emission_accumulator = 0.0f;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void update_fixed_steps()
+    {
+        // LOD and the variable rate emission accumulator depend on the camera and frame timing.
+        m_simulation_lod_level = SIMULATION_LOD_FULL;
+        m_accumulator          = 0.0f;
+        m_analytic_step        = false;
+        m_simulation_steps     = 0;
+
+        // The determinism test steps exactly once per frame so every step's hash gets read back.
+        if (m_determinism_test_run != 0 || m_divergence_check_active)
+        {
+            m_simulation_steps = 1;
+            return;
+        }
+
+        m_fixed_step_accumulator += float(m_delta_seconds);
+
+        while (m_fixed_step_accumulator >= DETERMINISTIC_TIME_STEP && m_simulation_steps < DETERMINISTIC_MAX_STEPS)
+        {
+            m_fixed_step_accumulator -= DETERMINISTIC_TIME_STEP;
+            m_simulation_steps++;
+        }
+
+        // Drop time we can't catch up on instead of falling further behind every frame.
+        m_fixed_step_accumulator = std::min(m_fixed_step_accumulator, DETERMINISTIC_TIME_STEP);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void begin_fixed_step()
+    {
+        m_emission_delta      = 1.0f / float(m_emission_rate); // In seconds
+        m_simulation_delta    = DETERMINISTIC_TIME_STEP;
+        m_particles_per_frame = 0;
+
+        m_fixed_emission_accumulator += DETERMINISTIC_TIME_STEP;
+
+        while (m_fixed_emission_accumulator >= m_emission_delta)
+        {
+            m_fixed_emission_accumulator -= m_emission_delta;
+            m_particles_per_frame++;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void swap_alive_lists()
+    {
+        m_pre_sim_idx  = m_pre_sim_idx == 0 ? 1 : 0;
+        m_post_sim_idx = m_post_sim_idx == 0 ? 1 : 0;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void update_simulation_lod()
+    {
+        float distance = glm::length(m_main_camera->m_position - m_position);
+
+        SimulationLOD previous_lod = m_simulation_lod_level;
+
+        if (!m_simulation_lod)
+            m_simulation_lod_level = SIMULATION_LOD_FULL;
+        else if (!is_sphere_visible(m_position, m_lod_bounds_radius))
+            m_simulation_lod_level = SIMULATION_LOD_FROZEN;
+        else if (distance > m_lod_distance * 2.0f)
+            m_simulation_lod_level = SIMULATION_LOD_QUARTER;
+        else if (distance > m_lod_distance)
+            m_simulation_lod_level = SIMULATION_LOD_HALF;
+        else
+            m_simulation_lod_level = SIMULATION_LOD_FULL;
+
+        m_lod_elapsed_time += float(m_delta_seconds);
+        m_lod_frames_pending++;
+
+        // Coarser levels step every 2nd or 4th frame with the time accumulated since their last step.
+        uint32_t interval = 1 << m_simulation_lod_level;
+
+        m_simulation_steps = m_simulation_lod_level != SIMULATION_LOD_FROZEN && m_lod_frames_pending >= interval ? 1 : 0;
+
+        if (m_simulation_lod_level == SIMULATION_LOD_FROZEN)
+        {
+            // Anything emitted longer ago than the max lifetime would be dead by now anyway.
+            m_accumulator = std::min(m_accumulator, m_max_lifetime);
+        }
+
+        m_particles_per_frame = 0;
+        m_simulation_delta    = 0.0f;
+        m_analytic_step       = false;
+
+        if (m_simulation_steps == 0)
+            return;
+
+        m_emission_delta = 1.0f / float(m_emission_rate); // In seconds
+
+        while (m_accumulator >= m_emission_delta)
+        {
+            m_accumulator -= m_emission_delta;
+            m_particles_per_frame++;
+        }
+
+        // The kickoff would drop anything beyond the free slots anyway, so don't request it.
+        if (m_particles_per_frame > m_emission_budget)
+        {
+            m_throttled_particles += m_particles_per_frame - m_emission_budget;
+            m_particles_per_frame = m_emission_budget;
+        }
+
+        m_emission_budget -= m_particles_per_frame;
+        m_frame_emission_requests += m_particles_per_frame;
+
+        m_simulation_delta   = m_lod_elapsed_time;
+        m_analytic_step      = previous_lod == SIMULATION_LOD_FROZEN; // Catch up on the whole frozen interval at once
+        m_lod_elapsed_time   = 0.0f;
+        m_lod_frames_pending = 0;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool is_sphere_visible(const glm::vec3& center, float radius)
+    {
+        const glm::mat4& m = m_main_camera->m_view_projection;
+
+        glm::vec4 rows[4];
+
+        for (int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+        // Left, right, bottom, top, near and far planes extracted from the view projection matrix.
+        glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+
+        for (const glm::vec4& plane : planes)
+        {
+            float length = glm::length(glm::vec3(plane));
+
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius * length)
+                return false;
+        }
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void read_particle_counters()
+    {
+        // The determinism test needs the hash of every step, so only it may wait on the GPU. Otherwise a
+        // region whose copy hasn't landed after COUNTER_READBACK_REGIONS frames is dropped rather than waited on.
+        if (m_determinism_test_run != 0)
+            m_counter_readback->begin_frame();
+        else
+            m_counter_readback->next_region();
+
+        uint32_t region = m_counter_readback->current_region();
+
+        m_frame_emission_requests = 0;
+
+        if (!m_counter_readback_valid[region])
+            return;
+
+        m_counter_readback_valid[region] = false;
+
+        if (!m_counter_readback->try_wait(region))
+        {
+            m_dropped_readbacks++;
+            return;
+        }
+
+        const uint32_t* counters = (const uint32_t*)m_counter_readback->data(region);
+
+        m_dead_particles      = counters[0];
+        m_alive_particles     = counters[1 + m_counter_readback_post_idx[region]];
+        m_simulated_particles = m_counter_readback_simulated[region] ? counters[3] : 0;
+        m_emitted_particles   = m_counter_readback_simulated[region] ? counters[4] : 0;
+
+        const uint32_t* events = counters + COUNTER_READBACK_EVENTS_OFFSET / sizeof(uint32_t);
+
+        m_sub_emitter_events  = m_counter_readback_simulated[region] && sub_emitter_trigger() != 0 ? events[0] : 0;
+        m_sub_emitter_dropped = events[1];
+        m_multi_draw_count    = m_counter_readback_draws[region] ? counters[COUNTER_READBACK_DRAWS_OFFSET / sizeof(uint32_t)] : 0;
+
+        // The query ended before the copy, so it is available once the region's fence has passed.
+        if (m_counter_readback_timed[region])
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(m_simulation_queries[region], GL_QUERY_RESULT, &elapsed);
+
+            m_simulation_time_ns = double(elapsed);
+            m_substeps_executed  = counters[5];
+        }
+
+        m_alive_particle_frames += m_alive_particles;
+        m_simulated_particle_frames += m_simulated_particles;
+
+        m_alive_history[m_counter_history_offset]     = float(m_alive_particles);
+        m_dead_history[m_counter_history_offset]      = float(m_dead_particles);
+        m_emitted_history[m_counter_history_offset]   = float(m_emitted_particles);
+        m_simulated_history[m_counter_history_offset] = float(m_simulated_particles);
+        m_counter_history_offset                      = (m_counter_history_offset + 1) % COUNTER_HISTORY_SIZE;
+
+        if (!m_counter_readback_hashed[region])
+            return;
+
+        const uint32_t* hash = counters + COUNTER_READBACK_HASH_OFFSET / sizeof(uint32_t);
+
+        m_state_hash      = (uint64_t(hash[0]) << 32) | uint64_t(hash[1]);
+        m_state_hash_step = m_counter_readback_step[region];
+
+        if (m_determinism_test_run != 0 && m_counter_readback_run[region] == m_determinism_test_run)
+            record_determinism_hash(m_state_hash);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Rebalances the global cap across emitters every frame. The kickoff enforces the quota on the GPU against the
+    // exact alive count, the CPU only uses the read back counters to avoid requesting what would be dropped.
+    void update_particle_budget()
+    {
+        BudgetRequest request;
+
+        request.priority = m_emitter_priority;
+        request.distance = glm::length(m_main_camera->m_position - m_position);
+        request.radius   = m_lod_bounds_radius;
+        request.visible  = is_sphere_visible(m_position, m_lod_bounds_radius);
+        request.demand   = uint32_t(std::ceil(float(m_emission_rate) * m_max_lifetime));
+
+        m_budget_requests.assign(1, request);
+        m_particle_budget.assign(m_budget_requests, m_global_particle_cap, m_main_camera->m_projection[1][1]);
+
+        // Quotas follow the camera, which a deterministic run must not depend on.
+        m_particle_quota = m_deterministic ? m_global_particle_cap : m_particle_budget.quotas()[0];
+
+        // Free slots and quota room as of the last sample, minus whatever the frames still in flight asked for since.
+        // Particles that died in the meantime only make this conservative.
+        int64_t budget = std::min(int64_t(m_dead_particles), int64_t(m_particle_quota) - int64_t(m_alive_particles));
+
+        for (uint32_t i = 0; i < COUNTER_READBACK_REGIONS; i++)
+        {
+            if (m_counter_readback_valid[i])
+                budget -= m_counter_readback_requests[i];
+        }
+
+        m_emission_budget = int32_t(std::max(budget, int64_t(0)));
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void copy_particle_counters()
+    {
+        uint32_t region = m_counter_readback->current_region();
+
+        m_particle_pool->copy(m_counters_range, 0, m_counter_readback->handle(), m_counter_readback->offset(region), sizeof(int32_t) * 6);
+
+        m_counter_readback_valid[region]     = true;
+        m_counter_readback_simulated[region] = m_simulation_steps > 0;
+        m_counter_readback_post_idx[region]  = m_post_sim_idx;
+        m_counter_readback_hashed[region]    = m_deterministic && m_simulation_steps > 0;
+        m_counter_readback_step[region]      = m_step_index;
+        m_counter_readback_run[region]       = m_determinism_test_run;
+        m_counter_readback_requests[region]  = m_frame_emission_requests;
+        m_counter_readback_timed[region]     = m_time_substeps;
+        m_counter_readback_draws[region]     = multi_draw_active();
+
+        // event_count and dropped, see shader/particle_sub_emission_cs.glsl
+        m_particle_pool->copy(m_sub_emitter_queue_range, sizeof(uint32_t) * 2, m_counter_readback->handle(), m_counter_readback->offset(region) + COUNTER_READBACK_EVENTS_OFFSET, sizeof(uint32_t) * 2);
+
+        if (m_counter_readback_hashed[region])
+            m_particle_pool->copy(m_state_hash_range, 0, m_counter_readback->handle(), m_counter_readback->offset(region) + COUNTER_READBACK_HASH_OFFSET, sizeof(uint32_t) * 2);
+
+        if (m_counter_readback_draws[region])
+            m_particle_pool->copy(m_draw_commands_range, 0, m_counter_readback->handle(), m_counter_readback->offset(region) + COUNTER_READBACK_DRAWS_OFFSET, sizeof(uint32_t));
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void particle_kickoff()
+    {
+        m_particle_update_kickoff_program->use();
+
+        glDispatchCompute(1, 1, 1);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void particle_emission()
+    {
+        m_particle_emission_program->use();
+
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_ALIVE_PRE_SIM, m_alive_indices_range[m_pre_sim_idx]);
+
+        if (m_trail_history_ssbo)
+        {
+            m_trail_history_ssbo->bind_base(SSBO_BINDING_TRAIL_HISTORY);
+            m_trail_slots_ssbo->bind_base(SSBO_BINDING_TRAIL_SLOTS);
+        }
+
+        begin_tuning_sample(WORKGROUP_PASS_EMISSION);
+        glDispatchComputeIndirect(m_emission_dispatch_args_range.offset);
+        end_tuning_sample(WORKGROUP_PASS_EMISSION);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void particle_simulation()
+    {
+        m_particle_simulation_program->use();
+
+        m_collision_depth_rt[m_collision_index]->bind(0);
+        m_collision_normals_rt[m_collision_index]->bind(1);
+        m_collision_depth_rt[1 - m_collision_index]->bind(3);
+        m_collision_normals_rt[1 - m_collision_index]->bind(4);
+
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_ALIVE_PRE_SIM, m_alive_indices_range[m_pre_sim_idx]);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_ALIVE_POST_SIM, m_alive_indices_range[m_post_sim_idx]);
+        m_forces_ssbo->bind_base(SSBO_BINDING_FORCES);
+
+        if (m_trail_history_ssbo)
+        {
+            m_trail_history_ssbo->bind_base(SSBO_BINDING_TRAIL_HISTORY);
+            m_trail_slots_ssbo->bind_base(SSBO_BINDING_TRAIL_SLOTS);
+        }
+
+        if (m_bvh_nodes_ssbo)
+        {
+            m_bvh_nodes_ssbo->bind_base(SSBO_BINDING_BVH_NODES);
+            m_bvh_triangles_ssbo->bind_base(SSBO_BINDING_BVH_TRIANGLES);
+        }
+
+        if (m_vector_field)
+            m_vector_field->bind(2);
+
+        if (m_deterministic)
+            m_particle_pool->clear(m_alive_flags_range);
+
+        begin_tuning_sample(WORKGROUP_PASS_SIMULATION);
+        glDispatchComputeIndirect(m_simulation_dispatch_args_range.offset);
+        end_tuning_sample(WORKGROUP_PASS_SIMULATION);
+
+        glMemoryBarrier(GL_ALL_BARRIER_BITS);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Sub-emitters are off in deterministic mode: children are appended to the alive list in atomic order,
+    // which the slot ordered compaction would have to absorb.
+    int32_t sub_emitter_trigger()
+    {
+        if (m_deterministic)
+            return 0;
+
+        return (m_sub_emitter_on_death ? SUB_EMITTER_ON_DEATH : 0) | (m_sub_emitter_on_collision ? SUB_EMITTER_ON_COLLISION : 0);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Spawns children for the death and collision events the simulation pass queued, sized on the GPU.
+    void particle_sub_emission()
+    {
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_ALIVE_POST_SIM, m_alive_indices_range[m_post_sim_idx]);
+
+        if (m_trail_history_ssbo)
+        {
+            m_trail_history_ssbo->bind_base(SSBO_BINDING_TRAIL_HISTORY);
+            m_trail_slots_ssbo->bind_base(SSBO_BINDING_TRAIL_SLOTS);
+        }
+
+        m_particle_sub_emission_kickoff_program->use();
+
+        glDispatchCompute(1, 1, 1);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        m_particle_sub_emission_spawn_program->use();
+
+        begin_tuning_sample(WORKGROUP_PASS_SUB_EMISSION);
+        glDispatchComputeIndirect(m_sub_emission_dispatch_args_range.offset);
+        end_tuning_sample(WORKGROUP_PASS_SUB_EMISSION);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Rebuilds the alive and dead lists in slot order from the flags written by the simulation pass.
+    void particle_compaction()
+    {
+        uint32_t block_count = (MAX_PARTICLES + COMPACTION_BLOCK_SIZE - 1) / COMPACTION_BLOCK_SIZE;
+
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_ALIVE_POST_SIM, m_alive_indices_range[m_post_sim_idx]);
+
+        m_particle_compaction_count_program->use();
+        m_particle_compaction_count_program->set_uniform("u_MaxParticles", MAX_PARTICLES);
+
+        glDispatchCompute(block_count, 1, 1);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        m_particle_compaction_scan_program->use();
+        m_particle_compaction_scan_program->set_uniform("u_MaxParticles", MAX_PARTICLES);
+
+        glDispatchCompute(1, 1, 1);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        m_particle_compaction_write_program->use();
+        m_particle_compaction_write_program->set_uniform("u_MaxParticles", MAX_PARTICLES);
+
+        glDispatchCompute(block_count, 1, 1);
+
+        glMemoryBarrier(GL_ALL_BARRIER_BITS);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void hash_particle_state()
+    {
+        m_particle_state_hash_program->use();
+
+        // The compaction left the newest alive list in the post sim slot.
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_ALIVE_POST_SIM, m_alive_indices_range[m_post_sim_idx]);
+
+        glDispatchCompute(ceil(float(MAX_PARTICLES) / float(LOCAL_SIZE)), 1, 1);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Splits the final alive list into one instance range per material and writes a draw command for every
+    // material that has particles, so a single multi-draw covers all of them.
+    void bin_particle_draws()
+    {
+        DW_SCOPED_SAMPLE("Draw Binning");
+
+        m_particle_pool->clear(m_draw_commands_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_ALIVE_POST_SIM, m_alive_indices_range[m_post_sim_idx]);
+
+        m_particle_draw_binning_count_program->use();
+
+        glDispatchComputeIndirect(m_simulation_dispatch_args_range.offset);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        m_particle_draw_binning_scan_program->use();
+
+        glDispatchCompute(1, 1, 1);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        m_particle_draw_binning_scatter_program->use();
+
+        glDispatchComputeIndirect(m_simulation_dispatch_args_range.offset);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    std::string shader_define(const char* name, uint32_t value)
+    {
+        return std::string(name) + " " + std::to_string(value);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Appends the per pass bindings, which the passes and the included shader headers have to agree on.
+    std::vector<std::string> binding_defines(std::vector<std::string> defines)
+    {
+        defines.push_back(shader_define("SSBO_BINDING_ALIVE_PRE_SIM", SSBO_BINDING_ALIVE_PRE_SIM));
+        defines.push_back(shader_define("SSBO_BINDING_ALIVE_POST_SIM", SSBO_BINDING_ALIVE_POST_SIM));
+        defines.push_back(shader_define("SSBO_BINDING_FORCES", SSBO_BINDING_FORCES));
+        defines.push_back(shader_define("SSBO_BINDING_TRAIL_HISTORY", SSBO_BINDING_TRAIL_HISTORY));
+        defines.push_back(shader_define("SSBO_BINDING_TRAIL_SLOTS", SSBO_BINDING_TRAIL_SLOTS));
+        defines.push_back(shader_define("SSBO_BINDING_BVH_NODES", SSBO_BINDING_BVH_NODES));
+        defines.push_back(shader_define("SSBO_BINDING_BVH_TRIANGLES", SSBO_BINDING_BVH_TRIANGLES));
+        defines.push_back(shader_define("SSBO_BINDING_BENCHMARK_OUTPUT", SSBO_BINDING_BENCHMARK_OUTPUT));
+        defines.push_back(shader_define("SSBO_BINDING_CURVE_KEYS", SSBO_BINDING_CURVE_KEYS));
+        defines.push_back(shader_define("SSBO_BINDING_RIBBON_VERTICES", SSBO_BINDING_RIBBON_VERTICES));
+        defines.push_back(shader_define("SSBO_BINDING_RIBBON_DRAW_ARGS", SSBO_BINDING_RIBBON_DRAW_ARGS));
+        defines.push_back(shader_define("SSBO_BINDING_SCREEN_PARTICLES", SSBO_BINDING_SCREEN_PARTICLES));
+        defines.push_back(shader_define("SSBO_BINDING_TILE_COUNTS", SSBO_BINDING_TILE_COUNTS));
+        defines.push_back(shader_define("SSBO_BINDING_TILE_INDICES", SSBO_BINDING_TILE_INDICES));
+
+        return defines;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    std::string device_string()
+    {
+        return std::string((const char*)glGetString(GL_VENDOR)) + " " + (const char*)glGetString(GL_RENDERER) + " " + (const char*)glGetString(GL_VERSION);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // One line per device: the device string, a tab, then the size of every tuned pass in WorkgroupPass order.
+    void load_workgroup_sizes()
+    {
+        m_device_string = device_string();
+
+        std::ifstream file(WORKGROUP_CACHE_PATH);
+        std::string   line;
+
+        while (std::getline(file, line))
+        {
+            size_t tab = line.find('\t');
+
+            if (tab == std::string::npos || line.substr(0, tab) != m_device_string)
+                continue;
+
+            std::istringstream stream(line.substr(tab + 1));
+            uint32_t           sizes[WORKGROUP_PASS_COUNT];
+
+            for (int i = 0; i < WORKGROUP_PASS_COUNT; i++)
+                stream >> sizes[i];
+
+            if (!stream)
+            {
+                DW_LOG_ERROR("Malformed workgroup sizes in " WORKGROUP_CACHE_PATH ", using defaults");
+                return;
+            }
+
+            // The cache may come from an older driver or a copied working directory, so sizes the device can't run
+            // are dropped instead of failing the shader compile.
+            uint32_t max_size = max_workgroup_size();
+
+            for (int i = 0; i < WORKGROUP_PASS_COUNT; i++)
+            {
+                if (sizes[i] == 0)
+                {
+                    DW_LOG_ERROR("Cached workgroup size of zero in " WORKGROUP_CACHE_PATH ", using the default");
+                    sizes[i] = LOCAL_SIZE;
+                }
+                else if (sizes[i] > max_size)
+                {
+                    DW_LOG_ERROR("Cached workgroup size " + std::to_string(sizes[i]) + " exceeds the device limit of " + std::to_string(max_size) + ", using the default");
+                    sizes[i] = LOCAL_SIZE;
+                }
+
+                m_workgroup_sizes[i] = sizes[i];
+            }
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Largest one dimensional workgroup the device runs, limited by both the x dimension and the total invocations.
+    uint32_t max_workgroup_size()
+    {
+        GLint max_invocations = 0;
+        GLint max_size_x      = 0;
+
+        glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &max_invocations);
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &max_size_x);
+
+        return uint32_t(std::max(std::min(max_invocations, max_size_x), 0));
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void save_workgroup_sizes()
+    {
+        std::vector<std::string> lines;
+        std::string              line;
+
+        // Keep the entries of every other device.
+        {
+            std::ifstream file(WORKGROUP_CACHE_PATH);
+
+            while (std::getline(file, line))
+            {
+                if (line.compare(0, m_device_string.size() + 1, m_device_string + "\t") != 0)
+                    lines.push_back(line);
+            }
+        }
+
+        line = m_device_string + "\t";
+
+        for (int i = 0; i < WORKGROUP_PASS_COUNT; i++)
+            line += std::to_string(m_workgroup_sizes[i]) + (i + 1 < WORKGROUP_PASS_COUNT ? " " : "");
+
+        lines.push_back(line);
+
+        std::ofstream file(WORKGROUP_CACHE_PATH);
+
+        if (!file)
+        {
+            DW_LOG_ERROR("Failed to write " WORKGROUP_CACHE_PATH);
+            return;
+        }
+
+        for (const auto& entry : lines)
+            file << entry << "\n";
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Times every power of two size the device allows for one pass after another, on the live scene, and keeps the
+    // fastest. Each candidate is recompiled and gets a few frames to settle before its dispatches are timed.
+    void start_workgroup_tuning()
+    {
+        uint32_t max_size = max_workgroup_size();
+
+        m_tuning_candidates.clear();
+
+        for (uint32_t size = 32; size <= max_size; size *= 2)
+            m_tuning_candidates.push_back(size);
+
+        if (m_tuning_candidates.empty())
+            return;
+
+        m_tuning_results.assign(WORKGROUP_PASS_COUNT, std::vector<double>(m_tuning_candidates.size(), 0.0));
+
+        for (int i = 0; i < WORKGROUP_PASS_COUNT; i++)
+            m_tuning_previous_sizes[i] = m_workgroup_sizes[i];
+
+        glGenQueries(1, &m_tuning_query);
+
+        m_tuning_active = true;
+        m_tuning_pass   = 0;
+
+        begin_tuning_candidate(0);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void begin_tuning_candidate(uint32_t candidate)
+    {
+        m_tuning_candidate = candidate;
+        m_tuning_frame     = 0;
+        m_tuning_time_ns   = 0.0;
+        m_tuning_samples   = 0;
+
+        m_workgroup_sizes[m_tuning_pass] = m_tuning_candidates[candidate];
+
+        if (!create_shaders())
+        {
+            DW_LOG_ERROR("Workgroup size " + std::to_string(m_tuning_candidates[candidate]) + " failed to compile, tuning aborted");
+
+            for (int i = 0; i < WORKGROUP_PASS_COUNT; i++)
+                m_workgroup_sizes[i] = m_tuning_previous_sizes[i];
+
+            finish_workgroup_tuning();
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void finish_workgroup_tuning()
+    {
+        m_tuning_active = false;
+
+        glDeleteQueries(1, &m_tuning_query);
+
+        create_shaders();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void begin_tuning_sample(WorkgroupPass pass)
+    {
+        if (m_tuning_active && m_tuning_pass == pass)
+            glBeginQuery(GL_TIME_ELAPSED, m_tuning_query);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Waits for the result right away: a stall is fine while tuning and keeps every sample with its own candidate.
+    void end_tuning_sample(WorkgroupPass pass)
+    {
+        if (!m_tuning_active || m_tuning_pass != pass)
+            return;
+
+        glEndQuery(GL_TIME_ELAPSED);
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(m_tuning_query, GL_QUERY_RESULT, &elapsed);
+
+        if (m_tuning_frame >= WORKGROUP_TUNING_WARMUP_FRAMES)
+        {
+            m_tuning_time_ns += double(elapsed);
+            m_tuning_samples++;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void advance_workgroup_tuning()
+    {
+        if (!m_tuning_active || ++m_tuning_frame < WORKGROUP_TUNING_WARMUP_FRAMES + WORKGROUP_TUNING_FRAMES)
+            return;
+
+        m_tuning_results[m_tuning_pass][m_tuning_candidate] = m_tuning_samples > 0 ? m_tuning_time_ns / double(m_tuning_samples) : 0.0;
+
+        if (m_tuning_candidate + 1 < m_tuning_candidates.size())
+        {
+            begin_tuning_candidate(m_tuning_candidate + 1);
+            return;
+        }
+
+        // Passes that never ran, e.g. sub-emission without a trigger, keep the default size.
+        const std::vector<double>& results = m_tuning_results[m_tuning_pass];
+        double                     best    = DBL_MAX;
+
+        m_workgroup_sizes[m_tuning_pass] = LOCAL_SIZE;
+
+        for (uint32_t i = 0; i < results.size(); i++)
+        {
+            if (results[i] > 0.0 && results[i] < best)
+            {
+                best                             = results[i];
+                m_workgroup_sizes[m_tuning_pass] = m_tuning_candidates[i];
+            }
+        }
+
+        if (++m_tuning_pass < WORKGROUP_PASS_COUNT)
+        {
+            begin_tuning_candidate(0);
+            return;
+        }
+
+        save_workgroup_sizes();
+        finish_workgroup_tuning();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void load_mesh()
+    {
+        m_playground = dw::Mesh::load("Particle_Playground.obj");
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Three positions per triangle, gathered from every submesh of the playground.
+    void gather_scene_triangles(std::vector<glm::vec3>& positions)
+    {
+        positions.clear();
+
+        if (!m_playground)
+            return;
+
+        const auto& vertices = m_playground->vertices();
+        const auto& indices  = m_playground->indices();
+
+        for (uint32_t i = 0; i < m_playground->sub_mesh_count(); i++)
+        {
+            dw::SubMesh& submesh = m_playground->sub_meshes()[i];
+
+            for (uint32_t j = 0; j < submesh.index_count; j++)
+                positions.push_back(vertices[submesh.base_vertex + indices[submesh.base_index + j]].position);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // The scene is static, so the BVH is built once at load time and mesh collision only costs the traversal.
+    void create_bvh()
+    {
+        std::vector<glm::vec3> positions;
+        gather_scene_triangles(positions);
+
+        JobSystem jobs(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        m_bvh.build(positions, jobs);
+
+        if (m_bvh.nodes().empty())
+        {
+            DW_LOG_ERROR("Scene has no triangles, mesh collision disabled");
+            return;
+        }
+
+        m_bvh_nodes_ssbo     = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(BVHNode) * m_bvh.nodes().size(), (void*)m_bvh.nodes().data());
+        m_bvh_triangles_ssbo = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(BVHTriangle) * m_bvh.triangles().size(), (void*)m_bvh.triangles().data());
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
 
     bool create_shaders()
     {
         {
+            // Workgroup sizes are injected so the autotuner can recompile the passes it times, per pass bindings so the
+            // shaders can't drift from the passes that bind them.
+            std::string default_size       = shader_define("LOCAL_SIZE", LOCAL_SIZE);
+            std::string emission_size      = shader_define("EMISSION_LOCAL_SIZE", m_workgroup_sizes[WORKGROUP_PASS_EMISSION]);
+            std::string simulation_size    = shader_define("SIMULATION_LOCAL_SIZE", m_workgroup_sizes[WORKGROUP_PASS_SIMULATION]);
+            std::string emission_local     = shader_define("LOCAL_SIZE", m_workgroup_sizes[WORKGROUP_PASS_EMISSION]);
+            std::string simulation_local   = shader_define("LOCAL_SIZE", m_workgroup_sizes[WORKGROUP_PASS_SIMULATION]);
+            std::string sub_emission_local = shader_define("LOCAL_SIZE", m_workgroup_sizes[WORKGROUP_PASS_SUB_EMISSION]);
+
             // Create general shaders
-            m_particle_vs                = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, "shader/particle_vs.glsl"));
-            m_particle_fs                = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/particle_fs.glsl"));
-            m_particle_initialize_cs     = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_initialize_cs.glsl"));
-            m_particle_update_kickoff_cs = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_update_kickoff_cs.glsl"));
-            m_particle_emission_cs       = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_emission_cs.glsl"));
-            m_particle_simulation_cs     = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_simulation_cs.glsl"));
-            m_mesh_vs                    = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, "shader/mesh_vs.glsl"));
-            m_mesh_fs                    = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/mesh_fs.glsl"));
-            m_depth_fs                   = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/depth_fs.glsl"));
-            m_depth_prepass_fs           = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/depth_prepass_fs.glsl"));
+            m_particle_vs                      = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, "shader/particle_vs.glsl", binding_defines({})));
+            m_particle_fs                      = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/particle_fs.glsl"));
+            m_particle_sprite_fs               = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/particle_fs.glsl", { "SPRITE_ATLAS" }));
+            m_particle_initialize_cs           = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_initialize_cs.glsl", { default_size }));
+            m_particle_update_kickoff_cs       = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_update_kickoff_cs.glsl", { emission_size, simulation_size }));
+            m_particle_emission_cs             = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_emission_cs.glsl", binding_defines({ emission_local })));
+            m_particle_simulation_cs           = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_simulation_cs.glsl", binding_defines({ simulation_local })));
+            m_mesh_vs                          = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, "shader/mesh_vs.glsl"));
+            m_mesh_fs                          = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/mesh_fs.glsl"));
+            m_depth_fs                         = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/depth_fs.glsl"));
+            m_particle_depth_fs                = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/depth_fs.glsl", { "SPRITE_ATLAS" }));
+            m_depth_prepass_fs                 = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/depth_prepass_fs.glsl"));
+            m_particle_tile_binning_cs         = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_tile_binning_cs.glsl", binding_defines({ simulation_local })));
+            m_particle_tile_render_cs          = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_tile_render_cs.glsl", binding_defines({})));
+            m_fullscreen_triangle_vs           = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, "shader/fullscreen_triangle_vs.glsl"));
+            m_particle_composite_fs            = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/particle_composite_fs.glsl"));
+            m_depth_downsample_fs              = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/depth_downsample_fs.glsl"));
+            m_curve_bake_cs                    = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/curve_bake_cs.glsl", binding_defines({ default_size })));
+            m_particle_compaction_count_cs     = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_compaction_cs.glsl", binding_defines({ "COMPACTION_PASS_COUNT" })));
+            m_particle_compaction_scan_cs      = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_compaction_cs.glsl", binding_defines({ "COMPACTION_PASS_SCAN" })));
+            m_particle_compaction_write_cs     = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_compaction_cs.glsl", binding_defines({ "COMPACTION_PASS_WRITE" })));
+            m_particle_state_hash_cs           = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_state_hash_cs.glsl", binding_defines({ default_size })));
+            m_force_benchmark_cs               = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/force_benchmark_cs.glsl", binding_defines({ default_size })));
+            m_particle_ribbon_cs               = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_ribbon_cs.glsl", binding_defines({ simulation_local })));
+            m_particle_billboard_cs            = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_billboard_cs.glsl", binding_defines({ simulation_local })));
+            m_particle_ribbon_vs               = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, "shader/particle_ribbon_vs.glsl", binding_defines({})));
+            m_particle_sub_emission_kickoff_cs = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_sub_emission_cs.glsl", binding_defines({ "SUB_EMISSION_PASS_KICKOFF", sub_emission_local, simulation_size })));
+            m_particle_sub_emission_spawn_cs   = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_sub_emission_cs.glsl", binding_defines({ "SUB_EMISSION_PASS_SPAWN", sub_emission_local, simulation_size })));
+            m_bvh_benchmark_cs                 = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/bvh_benchmark_cs.glsl", binding_defines({ default_size })));
+            m_particle_draw_binning_count_cs   = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_draw_binning_cs.glsl", binding_defines({ "DRAW_BINNING_PASS_COUNT", simulation_local })));
+            m_particle_draw_binning_scan_cs    = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_draw_binning_cs.glsl", binding_defines({ "DRAW_BINNING_PASS_SCAN" })));
+            m_particle_draw_binning_scatter_cs = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_COMPUTE_SHADER, "shader/particle_draw_binning_cs.glsl", binding_defines({ "DRAW_BINNING_PASS_SCATTER", simulation_local })));
+
+            // The multi-draw variant requires ARB_shader_draw_parameters, so it is only compiled where it can run.
+            if (m_multi_draw_supported)
+                m_particle_multi_draw_vs = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, "shader/particle_vs.glsl", binding_defines({ "MULTI_DRAW" })));
 
             {
-                if (!m_particle_vs || !m_particle_fs)
+                if (!m_particle_vs || !m_particle_sprite_fs)
                 {
                     DW_LOG_FATAL("Failed to create Shaders");
                     return false;
                 }
 
                 // Create general shader program
-                dw::gl::Shader* shaders[] = { m_particle_vs.get(), m_particle_fs.get() };
+                dw::gl::Shader* shaders[] = { m_particle_vs.get(), m_particle_sprite_fs.get() };
                 m_particle_program        = std::make_unique<dw::gl::Program>(2, shaders);
 
                 if (!m_particle_program)
@@ -549,14 +2895,14 @@ private:
             }
 
             {
-                if (!m_particle_vs || !m_depth_fs)
+                if (!m_particle_vs || !m_particle_depth_fs)
                 {
                     DW_LOG_FATAL("Failed to create Shaders");
                     return false;
                 }
 
                 // Create general shader program
-                dw::gl::Shader* shaders[] = { m_particle_vs.get(), m_depth_fs.get() };
+                dw::gl::Shader* shaders[] = { m_particle_vs.get(), m_particle_depth_fs.get() };
                 m_particle_depth_program  = std::make_unique<dw::gl::Program>(2, shaders);
 
                 if (!m_particle_depth_program)
@@ -649,7 +2995,316 @@ private:
                 dw::gl::Shader* shaders[]         = { m_particle_update_kickoff_cs.get() };
                 m_particle_update_kickoff_program = std::make_unique<dw::gl::Program>(1, shaders);
 
-                if (!m_particle_update_kickoff_program)
+                if (!m_particle_update_kickoff_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_particle_emission_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[]   = { m_particle_emission_cs.get() };
+                m_particle_emission_program = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_particle_emission_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_particle_simulation_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[]     = { m_particle_simulation_cs.get() };
+                m_particle_simulation_program = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_particle_simulation_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_particle_tile_binning_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[]       = { m_particle_tile_binning_cs.get() };
+                m_particle_tile_binning_program = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_particle_tile_binning_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_particle_tile_render_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[]      = { m_particle_tile_render_cs.get() };
+                m_particle_tile_render_program = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_particle_tile_render_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_fullscreen_triangle_vs || !m_particle_composite_fs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[]    = { m_fullscreen_triangle_vs.get(), m_particle_composite_fs.get() };
+                m_particle_composite_program = std::make_unique<dw::gl::Program>(2, shaders);
+
+                if (!m_particle_composite_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_fullscreen_triangle_vs || !m_depth_downsample_fs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[]  = { m_fullscreen_triangle_vs.get(), m_depth_downsample_fs.get() };
+                m_depth_downsample_program = std::make_unique<dw::gl::Program>(2, shaders);
+
+                if (!m_depth_downsample_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_curve_bake_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[] = { m_curve_bake_cs.get() };
+                m_curve_bake_program      = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_curve_bake_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_particle_compaction_count_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[]           = { m_particle_compaction_count_cs.get() };
+                m_particle_compaction_count_program = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_particle_compaction_count_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_particle_compaction_scan_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[]          = { m_particle_compaction_scan_cs.get() };
+                m_particle_compaction_scan_program = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_particle_compaction_scan_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_particle_compaction_write_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[]           = { m_particle_compaction_write_cs.get() };
+                m_particle_compaction_write_program = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_particle_compaction_write_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_particle_state_hash_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[]     = { m_particle_state_hash_cs.get() };
+                m_particle_state_hash_program = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_particle_state_hash_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_force_benchmark_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[] = { m_force_benchmark_cs.get() };
+                m_force_benchmark_program = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_force_benchmark_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_bvh_benchmark_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[] = { m_bvh_benchmark_cs.get() };
+                m_bvh_benchmark_program   = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_bvh_benchmark_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_particle_ribbon_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[] = { m_particle_ribbon_cs.get() };
+                m_particle_ribbon_program = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_particle_ribbon_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_particle_billboard_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[]    = { m_particle_billboard_cs.get() };
+                m_particle_billboard_program = std::make_unique<dw::gl::Program>(1, shaders);
+
+                if (!m_particle_billboard_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_particle_ribbon_vs || !m_particle_fs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* shaders[] = { m_particle_ribbon_vs.get(), m_particle_fs.get() };
+                m_trail_program           = std::make_unique<dw::gl::Program>(2, shaders);
+
+                if (!m_trail_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+
+            {
+                if (!m_particle_sub_emission_kickoff_cs || !m_particle_sub_emission_spawn_cs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::gl::Shader* kickoff_shaders[] = { m_particle_sub_emission_kickoff_cs.get() };
+                m_particle_sub_emission_kickoff_program = std::make_unique<dw::gl::Program>(1, kickoff_shaders);
+
+                dw::gl::Shader* spawn_shaders[] = { m_particle_sub_emission_spawn_cs.get() };
+                m_particle_sub_emission_spawn_program = std::make_unique<dw::gl::Program>(1, spawn_shaders);
+
+                if (!m_particle_sub_emission_kickoff_program || !m_particle_sub_emission_spawn_program)
                 {
                     DW_LOG_FATAL("Failed to create Shader Program");
                     return false;
@@ -657,35 +3312,45 @@ private:
             }
 
             {
-                if (!m_particle_emission_cs)
+                if (!m_particle_draw_binning_count_cs || !m_particle_draw_binning_scan_cs || !m_particle_draw_binning_scatter_cs)
                 {
                     DW_LOG_FATAL("Failed to create Shaders");
                     return false;
                 }
 
                 // Create general shader program
-                dw::gl::Shader* shaders[]   = { m_particle_emission_cs.get() };
-                m_particle_emission_program = std::make_unique<dw::gl::Program>(1, shaders);
+                dw::gl::Shader* count_shaders[] = { m_particle_draw_binning_count_cs.get() };
+                m_particle_draw_binning_count_program = std::make_unique<dw::gl::Program>(1, count_shaders);
 
-                if (!m_particle_emission_program)
+                dw::gl::Shader* scan_shaders[] = { m_particle_draw_binning_scan_cs.get() };
+                m_particle_draw_binning_scan_program = std::make_unique<dw::gl::Program>(1, scan_shaders);
+
+                dw::gl::Shader* scatter_shaders[] = { m_particle_draw_binning_scatter_cs.get() };
+                m_particle_draw_binning_scatter_program = std::make_unique<dw::gl::Program>(1, scatter_shaders);
+
+                if (!m_particle_draw_binning_count_program || !m_particle_draw_binning_scan_program || !m_particle_draw_binning_scatter_program)
                 {
                     DW_LOG_FATAL("Failed to create Shader Program");
                     return false;
                 }
             }
 
+            if (m_multi_draw_supported)
             {
-                if (!m_particle_simulation_cs)
+                if (!m_particle_multi_draw_vs || !m_particle_sprite_fs || !m_particle_depth_fs)
                 {
                     DW_LOG_FATAL("Failed to create Shaders");
                     return false;
                 }
 
                 // Create general shader program
-                dw::gl::Shader* shaders[]     = { m_particle_simulation_cs.get() };
-                m_particle_simulation_program = std::make_unique<dw::gl::Program>(1, shaders);
+                dw::gl::Shader* shaders[]     = { m_particle_multi_draw_vs.get(), m_particle_sprite_fs.get() };
+                m_particle_multi_draw_program = std::make_unique<dw::gl::Program>(2, shaders);
 
-                if (!m_particle_simulation_program)
+                dw::gl::Shader* depth_shaders[]     = { m_particle_multi_draw_vs.get(), m_particle_depth_fs.get() };
+                m_particle_depth_multi_draw_program = std::make_unique<dw::gl::Program>(2, depth_shaders);
+
+                if (!m_particle_multi_draw_program || !m_particle_depth_multi_draw_program)
                 {
                     DW_LOG_FATAL("Failed to create Shader Program");
                     return false;
@@ -698,24 +3363,103 @@ private:
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
+    // Binds every pool range whose binding never changes, at the low indices. Only the two alive lists swap between
+    // passes, so they are the only pool ranges bound per pass, from SSBO_BINDING_PER_PASS up with each pass's own buffers.
+    void bind_particle_pool()
+    {
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_PARTICLE_DATA, m_particle_data_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_DEAD_INDICES, m_dead_indices_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_COUNTERS, m_counters_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_DRAW_ARGS, m_draw_args_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_ALIVE_FLAGS, m_alive_flags_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_EMISSION_DISPATCH_ARGS, m_emission_dispatch_args_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_SIMULATION_DISPATCH_ARGS, m_simulation_dispatch_args_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_SUB_EMISSION_DISPATCH_ARGS, m_sub_emission_dispatch_args_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_SUB_EMITTER_QUEUE, m_sub_emitter_queue_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_SUB_EMITTER_EVENTS, m_sub_emitter_events_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_COMPACTION_OFFSETS, m_compaction_offsets_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_STATE_HASH, m_state_hash_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_DRAW_COMMANDS, m_draw_commands_range);
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, POOL_BINDING_DRAW_INDICES, m_draw_indices_range);
+        m_draw_materials_ssbo->bind_base(SSBO_BINDING_DRAW_MATERIALS);
+
+        // Every indirect dispatch reads its arguments from the pool, draws rebind their own indirect buffer.
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, m_particle_pool->handle());
+
+        if (m_multi_draw_supported)
+            glBindBuffer(GL_PARAMETER_BUFFER_ARB, m_particle_pool->handle());
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
     bool create_buffers()
     {
         struct Particle
         {
             glm::vec4 lifetime;
             glm::vec4 velocity;
+            glm::vec4 position;
+            glm::vec4 orientation;
+        };
+
+        GLint max_bindings = 0;
+        glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &max_bindings);
+
+        if (max_bindings < SSBO_BINDING_COUNT)
+        {
+            DW_LOG_FATAL("The simulation pass binds shader storage buffers up to index " + std::to_string(SSBO_BINDING_COUNT - 1) + ", which needs GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS of at least " + std::to_string(SSBO_BINDING_COUNT) + ", the device has " + std::to_string(max_bindings));
+            return false;
+        }
+
+        // Everything the GPU reads and writes per particle lives in one arena the CPU never touches, so the storage
+        // is created without any client access flags.
+        m_particle_pool = std::make_unique<BufferArena>();
+
+        m_particle_data_range              = m_particle_pool->reserve(sizeof(Particle) * MAX_PARTICLES);
+        m_alive_indices_range[0]           = m_particle_pool->reserve(sizeof(int32_t) * MAX_PARTICLES);
+        m_alive_indices_range[1]           = m_particle_pool->reserve(sizeof(int32_t) * MAX_PARTICLES);
+        m_dead_indices_range               = m_particle_pool->reserve(sizeof(int32_t) * MAX_PARTICLES);
+        m_alive_flags_range                = m_particle_pool->reserve(sizeof(int32_t) * MAX_PARTICLES);
+        m_counters_range                   = m_particle_pool->reserve(sizeof(int32_t) * 6);
+        m_draw_args_range                  = m_particle_pool->reserve(sizeof(int32_t) * 4);
+        m_emission_dispatch_args_range     = m_particle_pool->reserve(sizeof(int32_t) * 3);
+        m_simulation_dispatch_args_range   = m_particle_pool->reserve(sizeof(int32_t) * 3);
+        m_sub_emission_dispatch_args_range = m_particle_pool->reserve(sizeof(int32_t) * 3);
+        m_sub_emitter_queue_range          = m_particle_pool->reserve(sizeof(uint32_t) * 4);
+        m_sub_emitter_events_range         = m_particle_pool->reserve(sizeof(glm::vec4) * 2 * SUB_EMITTER_MAX_EVENTS);
+        m_compaction_offsets_range         = m_particle_pool->reserve(sizeof(int32_t) * COMPACTION_BLOCK_SIZE);
+        m_state_hash_range                 = m_particle_pool->reserve(sizeof(uint32_t) * 2);
+        m_draw_commands_range              = m_particle_pool->reserve(sizeof(uint32_t) * (4 + DRAW_MATERIAL_COUNT * 7));
+        m_draw_indices_range               = m_particle_pool->reserve(sizeof(int32_t) * MAX_PARTICLES);
+
+        m_particle_pool->create(0);
+
+        m_draw_materials_ssbo = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_DYNAMIC_DRAW, sizeof(DrawMaterial) * DRAW_MATERIAL_COUNT, nullptr);
+
+        bind_particle_pool();
+
+        m_curve_keys_ssbo       = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_DYNAMIC_DRAW, sizeof(CurveKeys) * MAX_EMITTERS, nullptr);
+        m_forces_ssbo           = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_DYNAMIC_DRAW, sizeof(ForceField) * MAX_FORCES, nullptr);
+        m_force_benchmark_ssbo  = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(glm::vec4), nullptr);
+        m_ribbon_draw_args_ssbo = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_DYNAMIC_DRAW, sizeof(int32_t) * 4, nullptr);
+
+        struct ScreenParticle
+        {
             glm::vec4 position;
             glm::vec4 color;
         };
 
-        m_draw_indirect_args_ssbo                = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(int32_t) * 4, nullptr);
-        m_dispatch_emission_indirect_args_ssbo   = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(int32_t) * 3, nullptr);
-        m_dispatch_simulation_indirect_args_ssbo = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(int32_t) * 3, nullptr);
-        m_particle_data_ssbo                     = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(Particle) * MAX_PARTICLES, nullptr);
-        m_alive_indices_ssbo[0]                  = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(int32_t) * MAX_PARTICLES, nullptr);
-        m_alive_indices_ssbo[1]                  = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(int32_t) * MAX_PARTICLES, nullptr);
-        m_dead_indices_ssbo                      = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(int32_t) * MAX_PARTICLES, nullptr);
-        m_counters_ssbo                          = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(int32_t) * 5, nullptr);
+        // Sized by the pool rather than the resolution, so it survives resizes.
+        m_screen_particles_ssbo = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_DYNAMIC_DRAW, sizeof(ScreenParticle) * MAX_PARTICLES, nullptr);
+
+        // Triple buffered so the CPU can fill one frame's uniforms while the GPU still reads the previous two.
+        m_uniform_ring = std::make_unique<PersistentBuffer>(GL_UNIFORM_BUFFER, UNIFORM_RING_REGION_SIZE, UNIFORM_RING_REGIONS, GL_MAP_WRITE_BIT);
+
+        // Counters are copied here every frame and read back once the region's fence has passed.
+        m_counter_readback = std::make_unique<PersistentBuffer>(GL_COPY_WRITE_BUFFER, COUNTER_READBACK_SIZE, COUNTER_READBACK_REGIONS, GL_MAP_READ_BIT);
+
+        glGenQueries(COUNTER_READBACK_REGIONS, m_simulation_queries);
+        glGenQueries(1, &m_lighting_query);
 
         return true;
     }
@@ -724,72 +3468,489 @@ private:
 
     void create_framebuffers()
     {
-        m_scene_depth_rt   = std::make_unique<dw::gl::Texture2D>(m_width, m_height, 1, 1, 1, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT);
-        m_scene_normals_rt = std::make_unique<dw::gl::Texture2D>(m_width, m_height, 1, 1, 1, GL_RGB32F, GL_RGB, GL_FLOAT);
+        // Visible part of the collision depth, for the screen space passes.
+        m_scene_depth_rt = std::make_unique<dw::gl::Texture2D>(m_width, m_height, 1, 1, 1, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT);
+
+        create_collision_targets();
+        create_particle_targets();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Depth and normals with a guard band of m_collision_guard_band of the screen on every side, double buffered so the
+    // simulation can fall back to the previous frame's view of the scene.
+    void create_collision_targets()
+    {
+        m_collision_guard_x = int32_t(float(m_width) * m_collision_guard_band);
+        m_collision_guard_y = int32_t(float(m_height) * m_collision_guard_band);
+
+        int32_t width  = m_width + 2 * m_collision_guard_x;
+        int32_t height = m_height + 2 * m_collision_guard_y;
+
+        for (int i = 0; i < 2; i++)
+        {
+            m_collision_depth_rt[i]   = std::make_unique<dw::gl::Texture2D>(width, height, 1, 1, 1, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT);
+            m_collision_normals_rt[i] = std::make_unique<dw::gl::Texture2D>(width, height, 1, 1, 1, GL_RGB32F, GL_RGB, GL_FLOAT);
+
+            m_collision_fbo[i] = std::make_unique<dw::gl::Framebuffer>();
+            m_collision_fbo[i]->attach_render_target(0, m_collision_normals_rt[i].get(), 0, 0);
+            m_collision_fbo[i]->attach_depth_stencil_target(m_collision_depth_rt[i].get(), 0, 0);
+        }
+
+        m_collision_history_valid = false;
+        m_collision_targets_dirty = false;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Widens the frustum so the guard band lands outside the visible viewport, keeping the same texel density.
+    glm::mat4 collision_projection()
+    {
+        float scale_x = float(m_width) / float(m_width + 2 * m_collision_guard_x);
+        float scale_y = float(m_height) / float(m_height + 2 * m_collision_guard_y);
+
+        return glm::scale(glm::mat4(1.0f), glm::vec3(scale_x, scale_y, 1.0f)) * m_main_camera->m_projection;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void create_static_shadow_map()
+    {
+        // Cached depth of the static scene from the light, copied into the shadow map every frame.
+        m_static_shadow_rt = std::make_unique<dw::gl::Texture2D>(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1, 1, 1, m_shadow_map.texture()->internal_format(), GL_DEPTH_COMPONENT, GL_FLOAT);
+
+        m_static_shadow_fbo = std::make_unique<dw::gl::Framebuffer>();
+        m_static_shadow_fbo->attach_depth_stencil_target(m_static_shadow_rt.get(), 0, 0);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    int32_t particle_resolution_scale()
+    {
+        return 1 << int32_t(m_particle_resolution);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void create_particle_targets()
+    {
+        m_particle_width  = std::max(int32_t(m_width) / particle_resolution_scale(), 1);
+        m_particle_height = std::max(int32_t(m_height) / particle_resolution_scale(), 1);
 
-        m_scene_depth_fbo = std::make_unique<dw::gl::Framebuffer>();
-        m_scene_depth_fbo->attach_render_target(0, m_scene_normals_rt.get(), 0, 0);
-        m_scene_depth_fbo->attach_depth_stencil_target(m_scene_depth_rt.get(), 0, 0);
+        m_particle_rt = std::make_unique<dw::gl::Texture2D>(m_particle_width, m_particle_height, 1, 1, 1, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+        m_particle_rt->set_min_filter(GL_LINEAR);
+        m_particle_rt->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+
+        m_particle_depth_rt = std::make_unique<dw::gl::Texture2D>(m_particle_width, m_particle_height, 1, 1, 1, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT);
+        m_particle_depth_rt->set_min_filter(GL_NEAREST);
+        m_particle_depth_rt->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+
+        m_particle_fbo = std::make_unique<dw::gl::Framebuffer>();
+        m_particle_fbo->attach_render_target(0, m_particle_rt.get(), 0, 0);
+        m_particle_fbo->attach_depth_stencil_target(m_particle_depth_rt.get(), 0, 0);
+
+        m_tile_count_x = (m_particle_width + TILE_SIZE - 1) / TILE_SIZE;
+        m_tile_count_y = (m_particle_height + TILE_SIZE - 1) / TILE_SIZE;
+
+        // One leading visible-particle counter followed by a counter per tile.
+        m_tile_counts_ssbo  = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_DYNAMIC_DRAW, sizeof(uint32_t) * (m_tile_count_x * m_tile_count_y + 1), nullptr);
+        m_tile_indices_ssbo = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_DYNAMIC_DRAW, sizeof(uint32_t) * m_tile_count_x * m_tile_count_y * TILE_MAX_PARTICLES, nullptr);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
     void create_textures()
     {
-        m_color_over_time = std::make_unique<dw::gl::Texture1D>(GRADIENT_SAMPLES, 1, 1, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
-        m_size_over_time  = std::make_unique<dw::gl::Texture1D>(GRADIENT_SAMPLES, 1, 1, GL_R32F, GL_RED, GL_FLOAT);
+        create_curve_atlas();
+        create_sprite_atlas();
+
+        // Ship a procedural swirl the first time so the import path always has something to load.
+        if (!load_vector_field(m_vector_field_path))
+        {
+            write_default_vector_field(m_vector_field_path);
+            load_vector_field(m_vector_field_path);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Packs the flipbooks into the sprite atlas, or loads the packed result from the cache when the sources are unchanged.
+    void create_sprite_atlas()
+    {
+        std::vector<SpriteImage> sources;
+
+        generate_sprite_sources(sources);
+
+        m_sprite_atlas = std::make_unique<SpriteAtlas>();
+
+        if (!m_sprite_atlas->build(sources, SPRITE_ATLAS_CACHE_PATH))
+        {
+            DW_LOG_ERROR("Failed to build sprite atlas");
+            m_sprite_animations.clear();
+        }
+
+        m_sprite_atlas->upload();
+
+        const std::vector<SpriteFrame>& frames = m_sprite_atlas->frames();
+
+        m_sprite_frames_ssbo = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(SpriteFrame) * std::max(frames.size(), size_t(1)), frames.empty() ? nullptr : (void*)frames.data());
+        m_sprite_frames_ssbo->bind_base(SSBO_BINDING_SPRITE_FRAMES);
+
+        if (m_sprite_animations.size() == 2)
+        {
+            set_material_flipbook(m_draw_materials[DRAW_MATERIAL_EMITTER], 0);
+            set_material_flipbook(m_draw_materials[DRAW_MATERIAL_SUB_EMITTER], 1);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Procedural flipbooks standing in for authored sprite sheets, frames of an animation grow so the packer sees mixed sizes.
+    void generate_sprite_sources(std::vector<SpriteImage>& sources)
+    {
+        m_sprite_animations.clear();
+        m_sprite_animations.push_back({ "Smoke", int32_t(sources.size()), SPRITE_SMOKE_FRAMES });
+
+        for (int i = 0; i < SPRITE_SMOKE_FRAMES; i++)
+        {
+            float       t = float(i) / float(SPRITE_SMOKE_FRAMES - 1);
+            SpriteImage image;
+
+            image.width  = 32 + uint32_t(t * 96.0f);
+            image.height = image.width;
+            image.pixels.resize(image.width * image.height * 4);
+
+            for (uint32_t y = 0; y < image.height; y++)
+            {
+                for (uint32_t x = 0; x < image.width; x++)
+                {
+                    glm::vec2 p = (glm::vec2(x, y) + 0.5f) / float(image.width) * 2.0f - 1.0f;
+
+                    // A puff with drifting lumps that thins out as it ages.
+                    float lumps = 0.5f + 0.5f * sinf(p.x * 7.0f + t * 3.0f) * sinf(p.y * 5.0f - t * 2.0f);
+                    float shade = 0.7f + 0.3f * lumps;
+                    float alpha = glm::clamp((1.0f - glm::length(p)) * 2.0f, 0.0f, 1.0f) * (0.6f + 0.4f * lumps) * (1.0f - 0.6f * t);
+
+                    uint8_t* pixel = &image.pixels[(y * image.width + x) * 4];
+
+                    pixel[0] = pixel[1] = pixel[2] = uint8_t(shade * 255.0f);
+                    pixel[3] = uint8_t(alpha * 255.0f);
+                }
+            }
+
+            sources.push_back(std::move(image));
+        }
+
+        m_sprite_animations.push_back({ "Spark", int32_t(sources.size()), SPRITE_SPARK_FRAMES });
+
+        for (int i = 0; i < SPRITE_SPARK_FRAMES; i++)
+        {
+            float       t = float(i) / float(SPRITE_SPARK_FRAMES - 1);
+            SpriteImage image;
+
+            image.width  = 32;
+            image.height = 32;
+            image.pixels.resize(image.width * image.height * 4);
+
+            for (uint32_t y = 0; y < image.height; y++)
+            {
+                for (uint32_t x = 0; x < image.width; x++)
+                {
+                    glm::vec2 p = (glm::vec2(x, y) + 0.5f) / float(image.width) * 2.0f - 1.0f;
 
-        m_color_over_time->set_min_filter(GL_NEAREST);
-        m_size_over_time->set_min_filter(GL_NEAREST);
+                    // A four pointed star whose rays shrink over the spark's life.
+                    float ray   = 1.0f - std::min(std::abs(p.x), std::abs(p.y)) * (4.0f + 8.0f * t);
+                    float core  = 1.0f - glm::length(p) * (1.5f + t);
+                    float alpha = glm::clamp(std::max(ray * (1.0f - glm::length(p)), core), 0.0f, 1.0f);
 
-        m_color_over_time->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
-        m_size_over_time->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+                    uint8_t* pixel = &image.pixels[(y * image.width + x) * 4];
+
+                    pixel[0] = 255;
+                    pixel[1] = uint8_t(glm::clamp(0.6f + core, 0.0f, 1.0f) * 255.0f);
+                    pixel[2] = uint8_t(glm::clamp(core, 0.0f, 1.0f) * 255.0f);
+                    pixel[3] = uint8_t(alpha * 255.0f);
+                }
+            }
+
+            sources.push_back(std::move(image));
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // An animation index of -1 turns the flipbook off.
+    void set_material_flipbook(DrawMaterial& material, int32_t animation)
+    {
+        material.first_frame = animation < 0 ? 0 : m_sprite_animations[animation].first_frame;
+        material.frame_count = animation < 0 ? 0 : m_sprite_animations[animation].frame_count;
+
+        m_draw_materials_dirty = true;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void update_color_over_time_texture()
+    bool load_vector_field(const std::string& path)
     {
-        float delta = 1.0f / float(GRADIENT_SAMPLES);
-        float x     = 0.0f;
+        VectorFieldVolume volume;
+
+        if (!volume.open(path))
+            return false;
+
+        const VectorFieldHeader& header = volume.header();
 
-        std::vector<uint8_t> samples;
+        // Uploaded straight from the mapped file, the mapping is released once the texture owns the data.
+        m_vector_field = std::make_unique<dw::gl::Texture3D>(header.width, header.height, header.depth, 1, GL_RGB32F, GL_RGB, GL_FLOAT);
+        m_vector_field->set_data(0, (void*)volume.vectors());
+        m_vector_field->set_min_filter(GL_LINEAR);
+        m_vector_field->set_mag_filter(GL_LINEAR);
+        m_vector_field->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
 
-        for (uint32_t i = 0; i < GRADIENT_SAMPLES; i++)
+        // The volume covers the box stored with it, which every vector field force starts from.
+        m_vector_field_bounds_min = glm::vec3(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]);
+        m_vector_field_bounds_max = glm::vec3(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]);
+
+        for (ForceField& force : m_forces)
         {
-            glm::vec4 color;
-            m_color_gradient.getColorAt(x, &color.x);
+            if (force.type == FORCE_VECTOR_FIELD)
+            {
+                force.position = glm::vec4(m_vector_field_bounds_min, 0.0f);
+                force.axis     = glm::vec4(m_vector_field_bounds_max, 0.0f);
+                m_forces_dirty = true;
+            }
+        }
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void write_default_vector_field(const std::string& path)
+    {
+        VectorFieldHeader header;
+
+        memcpy(header.magic, VECTOR_FIELD_MAGIC, 4);
+        header.version = VECTOR_FIELD_VERSION;
+        header.width   = VECTOR_FIELD_SIZE;
+        header.height  = VECTOR_FIELD_SIZE;
+        header.depth   = VECTOR_FIELD_SIZE;
+
+        for (int i = 0; i < 3; i++)
+        {
+            header.bounds_min[i] = -10.0f;
+            header.bounds_max[i] = 10.0f;
+        }
+
+        std::vector<float> vectors(VECTOR_FIELD_SIZE * VECTOR_FIELD_SIZE * VECTOR_FIELD_SIZE * 3);
+
+        for (int z = 0; z < VECTOR_FIELD_SIZE; z++)
+        {
+            for (int y = 0; y < VECTOR_FIELD_SIZE; y++)
+            {
+                for (int x = 0; x < VECTOR_FIELD_SIZE; x++)
+                {
+                    glm::vec3 p = glm::vec3(x, y, z) / float(VECTOR_FIELD_SIZE - 1) * 2.0f - 1.0f;
+                    float*    v = &vectors[((z * VECTOR_FIELD_SIZE + y) * VECTOR_FIELD_SIZE + x) * 3];
+
+                    // Swirl around the y axis with a gentle updraft in the middle.
+                    v[0] = -p.z;
+                    v[1] = 1.0f - glm::length(glm::vec2(p.x, p.z));
+                    v[2] = p.x;
+                }
+            }
+        }
+
+        if (!VectorFieldVolume::write(path, header, vectors.data()))
+            DW_LOG_ERROR("Failed to write vector field: " + path);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void create_trail_buffers()
+    {
+        m_trails_dirty = false;
+        m_trail_head   = 0;
+
+        // Slots taken from the old buffers no longer match, so particles alive across the resize go without a trail.
+        m_trail_generation = (m_trail_generation + 1) % TRAIL_GENERATIONS;
+
+        if (m_trail_length == 0)
+        {
+            m_trail_history_ssbo.reset();
+            m_ribbon_vertices_ssbo.reset();
+            m_trail_slots_ssbo.reset();
+            return;
+        }
+
+        m_trail_history_ssbo   = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(glm::vec4) * m_trail_particles * m_trail_length, nullptr);
+        m_ribbon_vertices_ssbo = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_STATIC_DRAW, sizeof(glm::vec4) * 4 * m_trail_particles * m_trail_length, nullptr);
+        m_trail_slots_ssbo     = std::make_unique<dw::gl::ShaderStorageBuffer>(GL_DYNAMIC_DRAW, sizeof(uint32_t) * (m_trail_particles + 1), nullptr);
+
+        reset_trail_slots();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Fills the free list in shader/trails.glsl with every slot: a count followed by the slot indices.
+    void reset_trail_slots()
+    {
+        if (!m_trail_slots_ssbo)
+            return;
+
+        std::vector<uint32_t> slots(m_trail_particles + 1);
+
+        slots[0] = uint32_t(m_trail_particles);
+
+        for (int32_t i = 0; i < m_trail_particles; i++)
+            slots[i + 1] = uint32_t(m_trail_particles - 1 - i);
+
+        m_trail_slots_ssbo->set_data(0, sizeof(uint32_t) * slots.size(), slots.data());
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // The basis depends on the camera, so it is rebuilt for the drawn list every frame, including frames that don't step.
+    void update_billboards()
+    {
+        DW_SCOPED_SAMPLE("Billboards");
+
+        m_particle_billboard_program->use();
+
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_ALIVE_POST_SIM, m_alive_indices_range[m_post_sim_idx]);
+
+        glDispatchComputeIndirect(m_simulation_dispatch_args_range.offset);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void generate_trail_ribbons()
+    {
+        DW_SCOPED_SAMPLE("Trail Ribbons");
+
+        // Every ribbon is a strip of two vertices per history point, the pass appends the instances.
+        uint32_t args[] = { uint32_t(m_trail_length) * 2, 0, 0, 0 };
+
+        m_ribbon_draw_args_ssbo->set_data(0, sizeof(args), args);
+
+        m_particle_ribbon_program->use();
+
+        m_curve_atlas->bind(0);
+
+        m_particle_pool->bind(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_ALIVE_POST_SIM, m_alive_indices_range[m_post_sim_idx]);
+        m_trail_history_ssbo->bind_base(SSBO_BINDING_TRAIL_HISTORY);
+        m_ribbon_vertices_ssbo->bind_base(SSBO_BINDING_RIBBON_VERTICES);
+        m_ribbon_draw_args_ssbo->bind_base(SSBO_BINDING_RIBBON_DRAW_ARGS);
 
-            samples.push_back(color.x * 255.0f);
-            samples.push_back(color.y * 255.0f);
-            samples.push_back(color.z * 255.0f);
-            samples.push_back(color.w * 255.0f);
+        glDispatchComputeIndirect(m_simulation_dispatch_args_range.offset);
 
-            x += delta;
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void upload_draw_materials()
+    {
+        // Both materials sample the emitter's curves, they only differ by tint and size.
+        for (auto& material : m_draw_materials)
+            material.curve_row = m_curve_row;
+
+        m_draw_materials_ssbo->set_data(0, sizeof(m_draw_materials), m_draw_materials);
+
+        m_draw_materials_dirty = false;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void upload_forces()
+    {
+        if (!m_forces.empty())
+        {
+            // The vortex shader projects onto the axis, so upload it normalized and keep the typed value for the GUI.
+            std::vector<ForceField> forces = m_forces;
+
+            for (ForceField& force : forces)
+            {
+                if (force.type == FORCE_VORTEX)
+                {
+                    glm::vec3 axis = glm::vec3(force.axis);
+                    float     len  = glm::length(axis);
+
+                    force.axis = len > 1e-6f ? glm::vec4(axis / len, 0.0f) : glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+                }
+            }
+
+            m_forces_ssbo->set_data(0, sizeof(ForceField) * forces.size(), forces.data());
         }
 
-        m_color_over_time->set_data(0, 0, samples.data());
+        m_forces_dirty = false;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void create_curve_atlas()
+    {
+        // Every emitter's curves live in one texture so a single bind serves all of them.
+        m_curve_atlas = std::make_unique<dw::gl::Texture2D>(curve_resolution(), MAX_EMITTERS * CURVE_ROWS_PER_EMITTER, 1, 1, 1, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+
+        m_curve_atlas->set_min_filter(GL_LINEAR);
+        m_curve_atlas->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+
+        m_curves_dirty = true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    uint32_t curve_resolution()
+    {
+        return 64 << m_curve_resolution;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void update_size_over_time_texture()
+    void update_curve_keys()
     {
-        float delta     = 1.0f / float(GRADIENT_SAMPLES);
-        float x         = 0.0f;
-        float size_diff = m_end_size - m_start_size;
+        CurveKeys& keys = m_curve_keys;
 
-        std::vector<float> samples;
+        keys.mark_count = 0;
 
-        for (uint32_t i = 0; i < GRADIENT_SAMPLES; i++)
+        // Marks are kept sorted by position, which is the order the bake shader expects.
+        for (const ImGradientMark& mark : m_color_gradient.getMarks())
         {
-            float size = m_start_size + ImGui::BezierValue(x, m_size_curve) * size_diff;
-            samples.push_back(size);
+            if (keys.mark_count == CURVE_MAX_MARKS)
+                break;
 
-            x += delta;
+            keys.colors[keys.mark_count]    = glm::vec4(mark.color[0], mark.color[1], mark.color[2], mark.color[3]);
+            keys.positions[keys.mark_count] = mark.position;
+            keys.mark_count++;
         }
 
-        m_size_over_time->set_data(0, 0, samples.data());
+        keys.size_curve = glm::vec4(m_size_curve[0], m_size_curve[1], m_size_curve[2], m_size_curve[3]);
+        keys.start_size = m_start_size;
+        keys.end_size   = m_end_size;
+        keys.row        = m_curve_row;
+
+        m_curve_keys_ssbo->set_data(0, sizeof(CurveKeys), &keys);
+
+        m_curves_dirty = true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void bake_curves()
+    {
+        DW_SCOPED_SAMPLE("Bake Curves");
+
+        m_curve_bake_program->use();
+
+        m_curve_keys_ssbo->bind_base(SSBO_BINDING_CURVE_KEYS);
+        m_curve_atlas->bind_image(0, 0, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+        glDispatchCompute((curve_resolution() + LOCAL_SIZE - 1) / LOCAL_SIZE, 1, 1);
+
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        m_curves_dirty = false;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -803,10 +3964,114 @@ private:
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void update_transforms(dw::Camera* camera)
+    void update_uniforms()
+    {
+        // Waits on the fence of the region written UNIFORM_RING_REGIONS frames ago before reusing it.
+        m_uniform_ring->begin_frame();
+
+        glm::mat4 collision_proj = collision_projection();
+
+        m_global_uniforms.light_view_proj          = m_shadow_map.projection() * m_shadow_map.view();
+        m_global_uniforms.prev_collision_view_proj = m_global_uniforms.collision_view_proj;
+        m_global_uniforms.collision_view_proj      = collision_proj * m_main_camera->m_view;
+        m_global_uniforms.camera_view              = m_main_camera->m_view;
+        m_global_uniforms.light_direction          = glm::vec4(m_sky_model.direction(), 0.0f);
+        m_global_uniforms.light_color              = glm::vec4(m_shadow_map.color(), 1.0f);
+        m_global_uniforms.screen_size              = glm::ivec2(m_width, m_height);
+        m_global_uniforms.particle_size            = glm::ivec2(m_particle_width, m_particle_height);
+        m_global_uniforms.tile_count               = glm::ivec2(m_tile_count_x, m_tile_count_y);
+        m_global_uniforms.particle_scale           = particle_resolution_scale();
+        m_global_uniforms.particle_upsample        = m_particle_resolution != PARTICLE_RESOLUTION_FULL;
+        m_global_uniforms.shadow_bias              = m_shadow_bias;
+        m_global_uniforms.soft_distance            = m_soft_distance;
+        m_global_uniforms.force_count              = int32_t(m_forces.size());
+        m_global_uniforms.bvh_node_count           = m_bvh_nodes_ssbo ? int32_t(m_bvh.nodes().size()) : 0;
+        m_global_uniforms.collision_reprojection   = m_collision_reprojection && m_collision_history_valid; // No history right after the targets were created
+
+        void* global = m_uniform_ring->allocate(sizeof(GlobalUniforms), m_global_uniforms_offset);
+
+        memcpy(global, &m_global_uniforms, sizeof(GlobalUniforms));
+
+        m_camera_view_uniforms    = write_view_uniforms(m_main_camera->m_view, m_main_camera->m_projection, m_main_camera->m_position, 1.0f);
+        m_light_view_uniforms     = write_view_uniforms(m_shadow_map.view(), m_shadow_map.projection(), m_sky_model.direction(), m_particle_shadow_fraction);
+        m_collision_view_uniforms = write_view_uniforms(m_main_camera->m_view, collision_proj, m_main_camera->m_position, 1.0f);
+
+        m_uniform_ring->bind_range(0, m_global_uniforms_offset, sizeof(GlobalUniforms));
+        m_uniform_ring->bind_range(1, m_camera_view_uniforms, sizeof(ViewUniforms));
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    size_t write_view_uniforms(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position, float particle_fraction)
+    {
+        size_t        offset   = 0;
+        ViewUniforms* uniforms = (ViewUniforms*)m_uniform_ring->allocate(sizeof(ViewUniforms), offset);
+
+        uniforms->view              = view;
+        uniforms->proj              = projection;
+        uniforms->view_proj         = projection * view;
+        uniforms->position          = glm::vec4(position, 1.0f);
+        uniforms->particle_fraction = particle_fraction;
+
+        return offset;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void update_emitter_uniforms()
     {
-        // Update camera matrices.
-        m_global_uniforms.view_proj = camera->m_projection * camera->m_view;
+        size_t           offset  = 0;
+        EmitterUniforms* emitter = (EmitterUniforms*)m_uniform_ring->allocate(sizeof(EmitterUniforms), offset);
+
+        emitter->position               = m_position;
+        emitter->sphere_radius          = m_sphere_radius;
+        emitter->direction              = m_direction;
+        emitter->rotation               = glm::radians(m_rotation);
+        emitter->constant_velocity      = m_constant_velocity;
+        emitter->viscosity              = m_viscosity;
+        emitter->seeds                  = m_seeds;
+        emitter->delta_time             = m_simulation_delta;
+        emitter->min_initial_speed      = m_min_initial_speed;
+        emitter->max_initial_speed      = m_max_initial_speed;
+        emitter->min_lifetime           = m_min_lifetime;
+        emitter->max_lifetime           = m_max_lifetime;
+        emitter->restitution            = m_restitution;
+        emitter->emission_shape         = m_emission_shape;
+        emitter->direction_type         = m_direction_type;
+        emitter->affected_by_gravity    = m_affected_by_gravity;
+        emitter->depth_buffer_collision = m_depth_buffer_collision && !m_deterministic; // Depends on the camera
+        emitter->particles_per_frame    = m_particles_per_frame;
+        emitter->pre_sim_idx            = m_pre_sim_idx;
+        emitter->post_sim_idx           = m_post_sim_idx;
+        emitter->curve_row              = m_curve_row;
+        emitter->analytic_step          = m_analytic_step;
+        emitter->deterministic          = m_deterministic;
+        emitter->step_index             = m_step_index;
+        emitter->particle_quota         = m_particle_quota;
+        emitter->trail_length           = m_trail_length;
+        emitter->trail_head             = m_trail_head;
+        emitter->trail_particles        = m_trail_length > 0 ? m_trail_particles : 0;
+        emitter->trail_width            = m_trail_width;
+        emitter->trail_generation       = m_trail_generation;
+        emitter->sub_emitter_trigger    = sub_emitter_trigger();
+        emitter->sub_emitter_children   = m_sub_emitter_children;
+        emitter->sub_emitter_speed      = m_sub_emitter_speed;
+        emitter->sub_emitter_inherit    = m_sub_emitter_inherit;
+        emitter->sub_emitter_lifetime   = m_sub_emitter_lifetime;
+        emitter->max_substeps           = m_max_substeps;
+        emitter->adaptive_substeps      = m_adaptive_substeps;
+        emitter->substep_distance       = m_substep_distance;
+        emitter->measure_substeps       = m_measure_substeps;
+        emitter->mesh_collision         = m_mesh_collision && !m_divergence_check_active; // Not modelled by the reference
+        emitter->billboard_mode         = m_billboard_mode;
+        emitter->billboard_axis         = glm::length(m_billboard_axis) > 0.0f ? glm::normalize(m_billboard_axis) : glm::vec3(0.0f, 1.0f, 0.0f);
+        emitter->velocity_stretch       = m_velocity_stretch;
+        emitter->rotation_variance      = glm::radians(m_rotation_variance);
+        emitter->min_angular_velocity   = glm::radians(m_min_angular_velocity);
+        emitter->max_angular_velocity   = glm::radians(m_max_angular_velocity);
+
+        // Stays bound for the emission, simulation and rendering passes that follow.
+        m_uniform_ring->bind_range(2, offset, sizeof(EmitterUniforms));
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -839,7 +4104,6 @@ private:
         }
 
         current->update();
-        update_transforms(current);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -847,6 +4111,7 @@ private:
 private:
     std::unique_ptr<dw::gl::Shader> m_particle_vs;
     std::unique_ptr<dw::gl::Shader> m_particle_fs;
+    std::unique_ptr<dw::gl::Shader> m_particle_sprite_fs;
     std::unique_ptr<dw::gl::Shader> m_particle_initialize_cs;
     std::unique_ptr<dw::gl::Shader> m_particle_update_kickoff_cs;
     std::unique_ptr<dw::gl::Shader> m_particle_emission_cs;
@@ -854,7 +4119,29 @@ private:
     std::unique_ptr<dw::gl::Shader> m_mesh_vs;
     std::unique_ptr<dw::gl::Shader> m_mesh_fs;
     std::unique_ptr<dw::gl::Shader> m_depth_fs;
+    std::unique_ptr<dw::gl::Shader> m_particle_depth_fs;
     std::unique_ptr<dw::gl::Shader> m_depth_prepass_fs;
+    std::unique_ptr<dw::gl::Shader> m_particle_tile_binning_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_tile_render_cs;
+    std::unique_ptr<dw::gl::Shader> m_fullscreen_triangle_vs;
+    std::unique_ptr<dw::gl::Shader> m_particle_composite_fs;
+    std::unique_ptr<dw::gl::Shader> m_depth_downsample_fs;
+    std::unique_ptr<dw::gl::Shader> m_curve_bake_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_compaction_count_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_compaction_scan_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_compaction_write_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_state_hash_cs;
+    std::unique_ptr<dw::gl::Shader> m_force_benchmark_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_ribbon_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_billboard_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_ribbon_vs;
+    std::unique_ptr<dw::gl::Shader> m_particle_sub_emission_kickoff_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_sub_emission_spawn_cs;
+    std::unique_ptr<dw::gl::Shader> m_bvh_benchmark_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_draw_binning_count_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_draw_binning_scan_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_draw_binning_scatter_cs;
+    std::unique_ptr<dw::gl::Shader> m_particle_multi_draw_vs;
 
     std::unique_ptr<dw::gl::Program> m_particle_program;
     std::unique_ptr<dw::gl::Program> m_particle_initialize_program;
@@ -865,21 +4152,79 @@ private:
     std::unique_ptr<dw::gl::Program> m_mesh_depth_program;
     std::unique_ptr<dw::gl::Program> m_particle_depth_program;
     std::unique_ptr<dw::gl::Program> m_depth_prepass_program;
-
-    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_draw_indirect_args_ssbo;
-    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_dispatch_emission_indirect_args_ssbo;
-    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_dispatch_simulation_indirect_args_ssbo;
-    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_particle_data_ssbo;
-    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_alive_indices_ssbo[2];
-    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_dead_indices_ssbo;
-    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_counters_ssbo;
+    std::unique_ptr<dw::gl::Program> m_particle_tile_binning_program;
+    std::unique_ptr<dw::gl::Program> m_particle_tile_render_program;
+    std::unique_ptr<dw::gl::Program> m_particle_composite_program;
+    std::unique_ptr<dw::gl::Program> m_depth_downsample_program;
+    std::unique_ptr<dw::gl::Program> m_curve_bake_program;
+    std::unique_ptr<dw::gl::Program> m_particle_compaction_count_program;
+    std::unique_ptr<dw::gl::Program> m_particle_compaction_scan_program;
+    std::unique_ptr<dw::gl::Program> m_particle_compaction_write_program;
+    std::unique_ptr<dw::gl::Program> m_particle_state_hash_program;
+    std::unique_ptr<dw::gl::Program> m_force_benchmark_program;
+    std::unique_ptr<dw::gl::Program> m_particle_ribbon_program;
+    std::unique_ptr<dw::gl::Program> m_particle_billboard_program;
+    std::unique_ptr<dw::gl::Program> m_trail_program;
+    std::unique_ptr<dw::gl::Program> m_particle_sub_emission_kickoff_program;
+    std::unique_ptr<dw::gl::Program> m_particle_sub_emission_spawn_program;
+    std::unique_ptr<dw::gl::Program> m_bvh_benchmark_program;
+    std::unique_ptr<dw::gl::Program> m_particle_draw_binning_count_program;
+    std::unique_ptr<dw::gl::Program> m_particle_draw_binning_scan_program;
+    std::unique_ptr<dw::gl::Program> m_particle_draw_binning_scatter_program;
+    std::unique_ptr<dw::gl::Program> m_particle_multi_draw_program;
+    std::unique_ptr<dw::gl::Program> m_particle_depth_multi_draw_program;
+
+    std::unique_ptr<BufferArena>                 m_particle_pool;
+    BufferRange                                  m_particle_data_range;
+    BufferRange                                  m_alive_indices_range[2];
+    BufferRange                                  m_dead_indices_range;
+    BufferRange                                  m_alive_flags_range;
+    BufferRange                                  m_counters_range;
+    BufferRange                                  m_draw_args_range;
+    BufferRange                                  m_emission_dispatch_args_range;
+    BufferRange                                  m_simulation_dispatch_args_range;
+    BufferRange                                  m_sub_emission_dispatch_args_range;
+    BufferRange                                  m_sub_emitter_queue_range;
+    BufferRange                                  m_sub_emitter_events_range;
+    BufferRange                                  m_compaction_offsets_range;
+    BufferRange                                  m_state_hash_range;
+    BufferRange                                  m_draw_commands_range;
+    BufferRange                                  m_draw_indices_range;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_draw_materials_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_sprite_frames_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_screen_particles_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_tile_counts_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_tile_indices_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_curve_keys_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_forces_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_force_benchmark_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_trail_history_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_trail_slots_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_ribbon_vertices_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_ribbon_draw_args_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_bvh_nodes_ssbo;
+    std::unique_ptr<dw::gl::ShaderStorageBuffer> m_bvh_triangles_ssbo;
+
+    // Uniforms
+    std::unique_ptr<PersistentBuffer> m_uniform_ring;
+    std::unique_ptr<PersistentBuffer> m_counter_readback;
 
     std::unique_ptr<dw::gl::Texture2D>   m_scene_depth_rt;
-    std::unique_ptr<dw::gl::Texture2D>   m_scene_normals_rt;
-    std::unique_ptr<dw::gl::Framebuffer> m_scene_depth_fbo;
-
-    std::unique_ptr<dw::gl::Texture1D> m_size_over_time;
-    std::unique_ptr<dw::gl::Texture1D> m_color_over_time;
+    std::unique_ptr<dw::gl::Texture2D>   m_collision_depth_rt[2];
+    std::unique_ptr<dw::gl::Texture2D>   m_collision_normals_rt[2];
+    std::unique_ptr<dw::gl::Framebuffer> m_collision_fbo[2];
+    std::unique_ptr<dw::gl::Texture2D>   m_particle_rt;
+    std::unique_ptr<dw::gl::Texture2D>   m_particle_depth_rt;
+    std::unique_ptr<dw::gl::Framebuffer> m_particle_fbo;
+    std::unique_ptr<dw::gl::Texture2D>   m_static_shadow_rt;
+    std::unique_ptr<dw::gl::Framebuffer> m_static_shadow_fbo;
+
+    // Curves
+    std::unique_ptr<dw::gl::Texture2D> m_curve_atlas;
+    CurveKeys                          m_curve_keys;
+    int32_t                            m_curve_resolution = 2; // 256 samples
+    int32_t                            m_curve_row        = 0;
+    bool                               m_curves_dirty     = true;
 
     std::unique_ptr<dw::Camera> m_main_camera;
 
@@ -888,6 +4233,10 @@ private:
     dw::Mesh::Ptr        m_playground;
 
     GlobalUniforms m_global_uniforms;
+    size_t         m_global_uniforms_offset  = 0;
+    size_t         m_camera_view_uniforms    = 0;
+    size_t         m_light_view_uniforms     = 0;
+    size_t         m_collision_view_uniforms = 0;
 
     // Camera controls.
     bool  m_debug_gui          = true;
@@ -917,9 +4266,16 @@ private:
     glm::mat4     m_position_transform     = glm::mat4(1.0f);
     glm::vec3     m_direction              = glm::vec3(0.0f, 1.0f, 0.0f);
     glm::vec3     m_constant_velocity      = glm::vec3(0.0f);
-    float         m_rotation               = 0.0f;
+    float         m_rotation               = 0.0f;   // Degrees
+    float         m_rotation_variance      = 180.0f; // Degrees
+    float         m_min_angular_velocity   = -90.0f; // Degrees/second
+    float         m_max_angular_velocity   = 90.0f;  // Degrees/second
+    BillboardMode m_billboard_mode         = BILLBOARD_SCREEN;
+    glm::vec3     m_billboard_axis         = glm::vec3(0.0f, 1.0f, 0.0f);
+    float         m_velocity_stretch       = 0.05f;  // Seconds of on screen travel added to the length
     int32_t       m_pre_sim_idx            = 0;
     int32_t       m_post_sim_idx           = 1;
+    bool          m_alive_swap_pending     = false; // Set once post holds a list the next step should consume
     float         m_accumulator            = 0.0f;
     float         m_emission_delta         = 0.0f;
     float         m_viscosity              = 0.0f;
@@ -930,6 +4286,181 @@ private:
     float         m_sphere_radius          = 0.1f;
     float         m_shadow_bias            = 0.00001f;
 
+    // Simulation LOD
+    bool          m_simulation_lod         = false;
+    SimulationLOD m_simulation_lod_level   = SIMULATION_LOD_FULL;
+    float         m_lod_distance           = 20.0f;
+    float         m_lod_bounds_radius      = 5.0f;
+    float         m_lod_elapsed_time       = 0.0f;
+    uint32_t      m_lod_frames_pending     = 0;
+    uint32_t      m_simulation_steps       = 1;
+    bool          m_analytic_step          = false;
+    float         m_simulation_delta       = 0.0f;
+
+    // Deterministic lockstep
+    bool                  m_deterministic              = false;
+    uint32_t              m_step_index                 = 0;
+    float                 m_fixed_step_accumulator     = 0.0f;
+    float                 m_fixed_emission_accumulator = 0.0f;
+    uint64_t              m_state_hash                 = 0;
+    uint32_t              m_state_hash_step            = 0;
+    int32_t               m_determinism_test_run       = 0; // 0 when idle, otherwise the run being recorded
+    std::vector<uint64_t> m_determinism_hashes[2];
+    std::string           m_determinism_result;
+    bool                  m_determinism_passed         = false;
+    GPUTest               m_gpu_test                   = GPU_TEST_NONE;
+    int                   m_gpu_test_exit_code         = 0;
+
+    // CPU reference and divergence checker
+    std::unique_ptr<ParticleReference> m_particle_reference;
+    bool                               m_divergence_check_active = false;
+    int32_t                            m_divergence_frames       = 300;
+    int32_t                            m_divergence_interval     = 30;
+    float                              m_divergence_tolerance    = 0.001f;
+    uint32_t                           m_divergence_checks       = 0;
+    uint32_t                           m_divergence_exact        = 0;
+    std::vector<ReferenceParticle>     m_divergence_particles;
+    std::vector<uint32_t>              m_divergence_alive;
+    std::string                        m_divergence_result;
+    bool                               m_divergence_passed       = false;
+
+    // Particle counters, read back COUNTER_READBACK_REGIONS frames late
+    bool     m_counter_readback_valid[COUNTER_READBACK_REGIONS]     = {};
+    bool     m_counter_readback_simulated[COUNTER_READBACK_REGIONS] = {};
+    int32_t  m_counter_readback_post_idx[COUNTER_READBACK_REGIONS]  = {};
+    bool     m_counter_readback_hashed[COUNTER_READBACK_REGIONS]    = {};
+    uint32_t m_counter_readback_step[COUNTER_READBACK_REGIONS]      = {};
+    int32_t  m_counter_readback_run[COUNTER_READBACK_REGIONS]       = {};
+    uint32_t m_counter_readback_requests[COUNTER_READBACK_REGIONS]  = {};
+    bool     m_counter_readback_timed[COUNTER_READBACK_REGIONS]     = {};
+    bool     m_counter_readback_draws[COUNTER_READBACK_REGIONS]     = {};
+    uint32_t m_alive_particles                                      = 0;
+    uint32_t m_dead_particles                                       = MAX_PARTICLES;
+    uint32_t m_emitted_particles                                    = 0;
+    uint32_t m_simulated_particles                                  = 0;
+    uint32_t m_dropped_readbacks                                    = 0;
+    uint32_t m_frame_emission_requests                              = 0;
+    int32_t  m_emission_budget                                      = MAX_PARTICLES;
+    uint64_t m_throttled_particles                                  = 0;
+    uint32_t m_counter_history_offset                               = 0;
+    float    m_alive_history[COUNTER_HISTORY_SIZE]                  = {};
+    float    m_dead_history[COUNTER_HISTORY_SIZE]                   = {};
+    float    m_emitted_history[COUNTER_HISTORY_SIZE]                = {};
+    float    m_simulated_history[COUNTER_HISTORY_SIZE]              = {};
+    uint64_t m_alive_particle_frames                                = 0;
+    uint64_t m_simulated_particle_frames                            = 0;
+
+    // Forces
+    std::vector<ForceField>            m_forces;
+    std::unique_ptr<dw::gl::Texture3D> m_vector_field;
+    char                               m_vector_field_path[256]               = "vector_field.vf";
+    glm::vec3                          m_vector_field_bounds_min              = glm::vec3(-10.0f);
+    glm::vec3                          m_vector_field_bounds_max              = glm::vec3(10.0f);
+    bool                               m_forces_dirty                         = true;
+    bool                               m_run_force_benchmark                  = false;
+    double                             m_force_benchmark_ns[FORCE_TYPE_COUNT] = {};
+
+    // Trails
+    int32_t  m_trail_length     = 0;
+    int32_t  m_trail_particles  = 16384;
+    int32_t  m_trail_head       = 0;
+    float    m_trail_width      = 0.5f;
+    bool     m_trails_dirty     = false;
+    uint32_t m_trail_generation = 0;
+
+    // Sub-emitters
+    bool     m_sub_emitter_on_death     = false;
+    bool     m_sub_emitter_on_collision = false;
+    int32_t  m_sub_emitter_children     = 16;
+    float    m_sub_emitter_speed        = 5.0f;
+    float    m_sub_emitter_inherit      = 0.25f;
+    float    m_sub_emitter_lifetime     = 1.5f;
+    uint32_t m_sub_emitter_events       = 0;
+    uint32_t m_sub_emitter_dropped      = 0;
+
+    // Substepping
+    int32_t  m_max_substeps                                 = 1;
+    bool     m_adaptive_substeps                            = false;
+    float    m_substep_distance                             = 0.1f;
+    bool     m_measure_substeps                             = false;
+    bool     m_time_substeps                                = false;
+    GLuint   m_simulation_queries[COUNTER_READBACK_REGIONS] = {};
+    double   m_simulation_time_ns                           = 0.0;
+    uint32_t m_substeps_executed                            = 0;
+
+    // Collision buffers
+    float   m_collision_guard_band    = 0.1f; // Fraction of the screen added on every side
+    bool    m_collision_reprojection  = true;
+    int32_t m_collision_guard_x       = 0;
+    int32_t m_collision_guard_y       = 0;
+    int32_t m_collision_index         = 0;
+    bool    m_collision_history_valid = false;
+    bool    m_collision_targets_dirty = false;
+    bool    m_run_prepass_benchmark   = false;
+    double  m_prepass_screen_ms       = 0.0;
+    double  m_prepass_guard_ms        = 0.0;
+    double  m_prepass_copy_ms         = 0.0;
+
+    // Workgroup sizes
+    uint32_t                         m_workgroup_sizes[WORKGROUP_PASS_COUNT]       = { LOCAL_SIZE, LOCAL_SIZE, LOCAL_SIZE };
+    uint32_t                         m_tuning_previous_sizes[WORKGROUP_PASS_COUNT] = {};
+    std::string                      m_device_string;
+    bool                             m_tuning_active                               = false;
+    int32_t                          m_tuning_pass                                 = 0;
+    uint32_t                         m_tuning_candidate                            = 0;
+    uint32_t                         m_tuning_frame                                = 0;
+    double                           m_tuning_time_ns                              = 0.0;
+    uint32_t                         m_tuning_samples                              = 0;
+    GLuint                           m_tuning_query                                = 0;
+    std::vector<uint32_t>            m_tuning_candidates;
+    std::vector<std::vector<double>> m_tuning_results;
+
+    // Mesh collision
+    BVH         m_bvh;
+    bool        m_mesh_collision        = false;
+    double      m_bvh_build_single_ms   = 0.0;
+    double      m_bvh_build_multi_ms    = 0.0;
+    uint32_t    m_bvh_build_threads     = 0;
+    double      m_bvh_traversal_ns      = 0.0;
+    std::string m_bvh_validation_result = "";
+
+    // Budget
+    ParticleBudget             m_particle_budget;
+    std::vector<BudgetRequest> m_budget_requests;
+    int32_t                    m_global_particle_cap = MAX_PARTICLES;
+    int32_t                    m_particle_quota      = MAX_PARTICLES;
+    float                      m_emitter_priority    = 1.0f;
+
+    // Lighting
+    bool    m_lighting_dirty           = true;
+    bool    m_static_shadow_dirty      = true;
+    int32_t m_lighting_updates         = 0;
+    int32_t m_lighting_skipped_frames  = 0;
+    float   m_particle_shadow_fraction = 0.25f;
+    GLuint  m_lighting_query           = 0;
+    bool    m_lighting_query_pending   = false;
+    double  m_lighting_cpu_ms          = 0.0;
+    double  m_lighting_cost_ms         = 0.0; // Sum over every measured update
+    int32_t m_lighting_cost_samples    = 0;
+
+    // Offscreen particle rendering
+    ParticleRenderer   m_particle_renderer   = PARTICLE_RENDERER_RASTERIZED;
+    ParticleResolution m_particle_resolution = PARTICLE_RESOLUTION_FULL;
+    float              m_soft_distance       = 0.25f;
+    int32_t            m_particle_width      = 0;
+    int32_t            m_particle_height     = 0;
+    int32_t            m_tile_count_x        = 0;
+    int32_t            m_tile_count_y        = 0;
+
+    // Draw materials
+    DrawMaterial                 m_draw_materials[DRAW_MATERIAL_COUNT];
+    bool                         m_draw_materials_dirty = true;
+    bool                         m_multi_draw_supported = false;
+    bool                         m_multi_draw           = true;
+    uint32_t                     m_multi_draw_count     = 0;
+    std::unique_ptr<SpriteAtlas> m_sprite_atlas;
+    std::vector<SpriteAnimation> m_sprite_animations;
+
     // Random
     glm::vec3          m_seeds = glm::vec4(0.0f);
     std::random_device m_random;
@@ -938,8 +4469,25 @@ private:
     // UI
     ImGradient      m_color_gradient;
     float           m_size_curve[5] = { 0.000f, 0.000f, 1.000f, 1.000f, 0.0f };
-    ImGradientMark* m_dragging_mark = nullptr;
-    ImGradientMark* m_selected_mark = nullptr;
+    int32_t         m_dragging_mark = -1;
+    int32_t         m_selected_mark = -1;
+
+    // Benchmarks
+    double m_gradient_refresh_us = 0.0;
+    double m_gradient_sample_ns  = 0.0;
+    float  m_gradient_max_error  = 0.0f;
+    double m_bezier_sample_ns    = 0.0;
+    float  m_bezier_max_error    = 0.0f;
+
+    std::vector<std::pair<uint32_t, double>> m_job_scaling;
 };
 
-DW_DECLARE_MAIN(GPUParticleSystem)
\ No newline at end of file
+int main(int argc, const char* argv[])
+{
+    GPUParticleSystem app;
+
+    int result = app.run(argc, argv);
+
+    // The framework has torn down the window and context by now, a failed GPU test still has to fail the process.
+    return result != 0 ? result : app.gpu_test_exit_code();
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "particle_budget.h"
+#include <algorithm>
+
+// Off-screen emitters keep a small share so they don't start from nothing when they come back into view.
+#define BUDGET_MIN_COVERAGE 0.01f
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float ParticleBudget::weight(const BudgetRequest& request, float projection_scale)
+{
+    float coverage = BUDGET_MIN_COVERAGE;
+
+    if (request.visible)
+    {
+        // Projected radius as a fraction of the half screen height, squared for the covered area.
+        float projected = request.radius * projection_scale / std::max(request.distance, request.radius);
+        coverage        = std::max(std::min(projected * projected, 1.0f), BUDGET_MIN_COVERAGE);
+    }
+
+    return request.priority * coverage;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ParticleBudget::assign(const std::vector<BudgetRequest>& requests, uint32_t cap, float projection_scale)
+{
+    uint32_t count = uint32_t(requests.size());
+
+    m_quotas.assign(count, 0);
+    m_weights.resize(count);
+    m_order.resize(count);
+
+    double total_weight = 0.0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        m_weights[i] = weight(requests[i], projection_scale);
+        m_order[i]   = i;
+
+        if (requests[i].demand > 0)
+            total_weight += m_weights[i];
+    }
+
+    // Water filling: visit emitters by demand per unit of weight. As long as an emitter's proportional share of
+    // what's left covers its demand it is satisfied and drops out, every emitter after that gets its plain share.
+    std::sort(m_order.begin(), m_order.end(), [&](uint32_t a, uint32_t b) {
+        return double(requests[a].demand) * m_weights[b] < double(requests[b].demand) * m_weights[a];
+    });
+
+    double remaining = cap;
+
+    for (uint32_t i : m_order)
+    {
+        if (requests[i].demand == 0 || m_weights[i] <= 0.0f || total_weight <= 0.0)
+            continue;
+
+        double share = remaining * m_weights[i] / total_weight;
+
+        m_quotas[i] = uint32_t(std::min(share, double(requests[i].demand)));
+
+        remaining -= m_quotas[i];
+        total_weight -= m_weights[i];
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
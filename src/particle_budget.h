@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// What the budget manager knows about one emitter for the current frame.
+struct BudgetRequest
+{
+    float    priority; // User set importance, scales the emitter's share
+    float    distance; // Camera to emitter bounds center
+    float    radius;   // Emitter bounds radius
+    bool     visible;  // Bounds intersect the view frustum
+    uint32_t demand;   // Particles needed to run unthrottled, emission rate * max lifetime
+};
+
+// Splits a global particle cap into per-emitter quotas. Shares are weighted by priority and projected screen size,
+// so near, large and important emitters keep their particles when the pool runs dry. An emitter never gets more
+// than it demands and whatever it leaves is handed on to the others, so the quotas never add up to more than the cap.
+class ParticleBudget
+{
+public:
+    // projection_scale is the vertical cotangent of half the field of view, proj[1][1].
+    void assign(const std::vector<BudgetRequest>& requests, uint32_t cap, float projection_scale);
+
+    static float weight(const BudgetRequest& request, float projection_scale);
+
+    inline const std::vector<uint32_t>& quotas() const { return m_quotas; }
+    inline const std::vector<float>&    weights() const { return m_weights; }
+
+private:
+    std::vector<uint32_t> m_quotas;
+    std::vector<float>    m_weights;
+    std::vector<uint32_t> m_order;
+};
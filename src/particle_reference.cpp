@@ -0,0 +1,429 @@
+#include "particle_reference.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Must match the defines in the emission and noise shaders.
+#define EMISSION_SHAPE_SPHERE 0
+#define DIRECTION_TYPE_OUTWARD 1
+#define NOISE_EPSILON 1e-3f
+#define NOISE_PI 3.1415926535f
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint32_t pcg_hash(uint32_t value)
+{
+    uint32_t state = value * 747796405u + 2891336453u;
+    uint32_t word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static float counter_rand(uint32_t counter, uint32_t stream)
+{
+    return float(pcg_hash(counter ^ pcg_hash(stream)) >> 8u) / 16777216.0f;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint32_t hash_combine(uint32_t seed, uint32_t value)
+{
+    return pcg_hash(seed ^ value);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint32_t hash_combine(uint32_t seed, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    return hash_combine(seed, bits);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static glm::vec3 random_point_on_sphere(float u, float v, float radius)
+{
+    float theta = 2.0f * NOISE_PI * u;
+    float phi   = acosf(2.0f * v - 1.0f);
+
+    return glm::vec3(radius * sinf(phi) * cosf(theta), radius * sinf(phi) * sinf(theta), radius * cosf(phi));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static float mod289(float x)
+{
+    return x - floorf(x / 289.0f) * 289.0f;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static float permute(float x)
+{
+    return mod289((x * 34.0f + 1.0f) * x);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Scalar port of snoise() from shader/simplex_noise.glsl, one simplex corner at a time.
+static float snoise(const glm::vec3& v)
+{
+    const float cx = 1.0f / 6.0f;
+    const float cy = 1.0f / 3.0f;
+
+    // First corner
+    float     s  = (v.x + v.y + v.z) * cy;
+    glm::vec3 i  = glm::vec3(floorf(v.x + s), floorf(v.y + s), floorf(v.z + s));
+    float     t  = (i.x + i.y + i.z) * cx;
+    glm::vec3 x0 = v - i + glm::vec3(t);
+
+    // Other corners
+    glm::vec3 g  = glm::vec3(x0.x < x0.y ? 0.0f : 1.0f, x0.y < x0.z ? 0.0f : 1.0f, x0.z < x0.x ? 0.0f : 1.0f);
+    glm::vec3 l  = glm::vec3(1.0f) - g;
+    glm::vec3 i1 = glm::vec3(std::min(g.x, l.z), std::min(g.y, l.x), std::min(g.z, l.y));
+    glm::vec3 i2 = glm::vec3(std::max(g.x, l.z), std::max(g.y, l.x), std::max(g.z, l.y));
+
+    glm::vec3 corners[4] = { x0, x0 - i1 + glm::vec3(cx), x0 - i2 + glm::vec3(cy), x0 - glm::vec3(0.5f) };
+    glm::vec3 offsets[4] = { glm::vec3(0.0f), i1, i2, glm::vec3(1.0f) };
+
+    // Permutations
+    i = glm::vec3(mod289(i.x), mod289(i.y), mod289(i.z));
+
+    float noise = 0.0f;
+
+    for (int k = 0; k < 4; k++)
+    {
+        float p = permute(permute(permute(i.z + offsets[k].z) + i.y + offsets[k].y) + i.x + offsets[k].x);
+
+        // Gradients: 7x7 points over a square, mapped onto an octahedron.
+        float j  = p - 49.0f * floorf(p / 49.0f);
+        float x_ = floorf(j / 7.0f);
+        float y_ = floorf(j - 7.0f * x_);
+
+        float x  = (x_ * 2.0f + 0.5f) / 7.0f - 1.0f;
+        float y  = (y_ * 2.0f + 0.5f) / 7.0f - 1.0f;
+        float h  = 1.0f - fabsf(x) - fabsf(y);
+        float sh = h > 0.0f ? 0.0f : -1.0f;
+
+        glm::vec3 gradient = glm::vec3(x + (floorf(x) * 2.0f + 1.0f) * sh, y + (floorf(y) * 2.0f + 1.0f) * sh, h);
+
+        // Normalise gradients
+        gradient *= 1.79284291400159f - glm::dot(gradient, gradient) * 0.85373472095314f;
+
+        // Mix final noise value
+        float m = std::max(0.6f - glm::dot(corners[k], corners[k]), 0.0f);
+        m       = m * m;
+        m       = m * m;
+
+        noise += m * glm::dot(corners[k], gradient);
+    }
+
+    return 42.0f * noise;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static glm::vec3 curl_noise(const glm::vec3& coord)
+{
+    glm::vec3 dx = glm::vec3(NOISE_EPSILON, 0.0f, 0.0f);
+    glm::vec3 dy = glm::vec3(0.0f, NOISE_EPSILON, 0.0f);
+    glm::vec3 dz = glm::vec3(0.0f, 0.0f, NOISE_EPSILON);
+
+    // The shader splats each scalar noise sample into all three components.
+    float dpdx0 = snoise(coord - dx);
+    float dpdx1 = snoise(coord + dx);
+    float dpdy0 = snoise(coord - dy);
+    float dpdy1 = snoise(coord + dy);
+    float dpdz0 = snoise(coord - dz);
+    float dpdz1 = snoise(coord + dz);
+
+    float x = dpdy1 - dpdy0 + dpdz1 - dpdz0;
+    float y = dpdz1 - dpdz0 + dpdx1 - dpdx0;
+    float z = dpdx1 - dpdx0 + dpdy1 - dpdy0;
+
+    return glm::vec3(x, y, z) / NOISE_EPSILON * 2.0f;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Port of evaluate_forces() from shader/forces.glsl. Vector fields are skipped: the reference has no copy of the
+// volume, so checking divergence with a vector field force active will report it.
+static glm::vec3 evaluate_forces(const ReferenceEmitter& emitter, const glm::vec3& position, const glm::vec3& velocity)
+{
+    glm::vec3 acceleration = glm::vec3(0.0f);
+
+    for (uint32_t i = 0; i < emitter.force_count; i++)
+    {
+        const ForceField& force = emitter.forces[i];
+
+        if (force.type == FORCE_POINT)
+        {
+            glm::vec3 to_center = glm::vec3(force.position) - position;
+            float     distance  = glm::length(to_center);
+
+            if (distance < force.radius && distance > 1e-4f)
+                acceleration += to_center / distance * force.strength * powf(1.0f - distance / force.radius, force.falloff);
+        }
+        else if (force.type == FORCE_VORTEX)
+        {
+            glm::vec3 axis     = glm::vec3(force.axis);
+            glm::vec3 offset   = position - glm::vec3(force.position);
+            glm::vec3 radial   = offset - axis * glm::dot(offset, axis);
+            float     distance = glm::length(radial);
+
+            if (distance < force.radius && distance > 1e-4f)
+                acceleration += glm::cross(axis, radial / distance) * force.strength * powf(1.0f - distance / force.radius, force.falloff);
+        }
+        else if (force.type == FORCE_DRAG)
+            acceleration -= velocity * force.strength;
+    }
+
+    return acceleration;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool within_tolerance(float gpu, float cpu, float tolerance)
+{
+    return fabsf(gpu - cpu) <= tolerance * std::max(1.0f, fabsf(cpu));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ParticleReference::ParticleReference(uint32_t max_particles) :
+    m_max_particles(max_particles)
+{
+    m_particles.resize(max_particles);
+    m_flags.resize(max_particles);
+    m_alive.reserve(max_particles);
+    m_dead.reserve(max_particles);
+
+    reset();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ParticleReference::reset()
+{
+    m_alive.clear();
+    m_dead.resize(m_max_particles);
+
+    for (uint32_t i = 0; i < m_max_particles; i++)
+        m_dead[i] = i;
+
+    m_step       = 0;
+    m_state_hash = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ParticleReference::step(const ReferenceEmitter& emitter)
+{
+    emit(emitter);
+    simulate(emitter);
+    compact();
+
+    m_step       = emitter.step_index;
+    m_state_hash = combine_hashes(m_state_hash, step_hash());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ParticleReference::emit(const ReferenceEmitter& emitter)
+{
+    uint32_t quota_room     = emitter.particle_quota > m_alive.size() ? emitter.particle_quota - uint32_t(m_alive.size()) : 0;
+    uint32_t emission_count = std::min(std::min(emitter.emission_count, uint32_t(m_dead.size())), quota_room);
+    uint32_t dead_count     = uint32_t(m_dead.size());
+
+    for (uint32_t index = 0; index < emission_count; index++)
+    {
+        uint32_t slot = m_dead[dead_count - 1 - index];
+
+        glm::vec3 position = emitter.position;
+
+        if (emitter.emission_shape == EMISSION_SHAPE_SPHERE)
+            position += random_point_on_sphere(counter_rand(index, emitter.step_index * 8u + 0), counter_rand(index, emitter.step_index * 8u + 1), emitter.sphere_radius * counter_rand(index, emitter.step_index * 8u + 2));
+
+        glm::vec3 direction = emitter.direction;
+
+        if (emitter.direction_type == DIRECTION_TYPE_OUTWARD)
+            direction = glm::normalize(position - emitter.position);
+
+        float initial_speed = emitter.min_initial_speed + (emitter.max_initial_speed - emitter.min_initial_speed) * counter_rand(index, emitter.step_index * 8u + 3);
+        float lifetime      = emitter.min_lifetime + (emitter.max_lifetime - emitter.min_lifetime) * counter_rand(index, emitter.step_index * 8u + 6);
+
+        ReferenceParticle& particle = m_particles[slot];
+
+        particle.position = glm::vec4(position, particle.position.w);
+        particle.velocity = glm::vec4(direction * initial_speed, particle.velocity.w);
+        particle.lifetime = glm::vec4(0.0f, lifetime, 0.0f, 0.0f);
+
+        m_alive.push_back(slot);
+    }
+
+    m_dead.resize(dead_count - emission_count);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ParticleReference::simulate(const ReferenceEmitter& emitter)
+{
+    std::fill(m_flags.begin(), m_flags.end(), 0);
+
+    for (uint32_t slot : m_alive)
+    {
+        ReferenceParticle& particle = m_particles[slot];
+
+        // Particles that reached their lifetime last step are retired now, like the shader does.
+        if (particle.lifetime.x >= particle.lifetime.y)
+            continue;
+
+        particle.lifetime.x += emitter.delta_time;
+
+        glm::vec3 velocity = glm::vec3(particle.velocity);
+        glm::vec3 position = glm::vec3(particle.position);
+
+        int32_t substeps = emitter.max_substeps;
+
+        if (emitter.adaptive_substeps)
+        {
+            float travel = glm::length(velocity + emitter.constant_velocity) * emitter.delta_time;
+            substeps     = std::min(std::max(int32_t(ceilf(travel / emitter.substep_distance)), 1), emitter.max_substeps);
+        }
+
+        float dt = emitter.delta_time / float(substeps);
+
+        for (int32_t i = 0; i < substeps; i++)
+        {
+            if (emitter.affected_by_gravity)
+                velocity += glm::vec3(0.0f, -9.8f, 0.0f) * dt;
+
+            if (emitter.force_count > 0)
+                velocity += evaluate_forces(emitter, position, velocity) * dt;
+
+            if (emitter.viscosity != 0.0f)
+                velocity += (curl_noise(position) - velocity) * emitter.viscosity * dt;
+
+            position += (velocity + emitter.constant_velocity) * dt;
+        }
+
+        particle.velocity = glm::vec4(velocity, particle.velocity.w);
+        particle.position = glm::vec4(position, particle.position.w);
+
+        m_flags[slot] = 1;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ParticleReference::compact()
+{
+    m_alive.clear();
+    m_dead.clear();
+
+    for (uint32_t slot = 0; slot < m_max_particles; slot++)
+    {
+        if (m_flags[slot])
+            m_alive.push_back(slot);
+        else
+            m_dead.push_back(slot);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ParticleDivergence ParticleReference::compare(const ReferenceParticle* particles, const uint32_t* alive, uint32_t alive_count, float tolerance) const
+{
+    ParticleDivergence divergence;
+
+    if (alive_count != m_alive.size())
+    {
+        divergence.diverged = true;
+        divergence.field    = "alive_count";
+        divergence.gpu      = float(alive_count);
+        divergence.cpu      = float(m_alive.size());
+
+        return divergence;
+    }
+
+    for (uint32_t i = 0; i < alive_count; i++)
+    {
+        divergence.list_index = i;
+        divergence.slot       = m_alive[i];
+
+        if (alive[i] != m_alive[i])
+        {
+            divergence.diverged = true;
+            divergence.field    = "slot";
+            divergence.gpu      = float(alive[i]);
+            divergence.cpu      = float(m_alive[i]);
+
+            return divergence;
+        }
+
+        const ReferenceParticle& gpu = particles[m_alive[i]];
+        const ReferenceParticle& cpu = m_particles[m_alive[i]];
+
+        const char* names[]      = { "lifetime.x", "lifetime.y", "velocity.x", "velocity.y", "velocity.z", "position.x", "position.y", "position.z" };
+        float       gpu_fields[] = { gpu.lifetime.x, gpu.lifetime.y, gpu.velocity.x, gpu.velocity.y, gpu.velocity.z, gpu.position.x, gpu.position.y, gpu.position.z };
+        float       cpu_fields[] = { cpu.lifetime.x, cpu.lifetime.y, cpu.velocity.x, cpu.velocity.y, cpu.velocity.z, cpu.position.x, cpu.position.y, cpu.position.z };
+
+        for (int field = 0; field < 8; field++)
+        {
+            if (!within_tolerance(gpu_fields[field], cpu_fields[field], tolerance))
+            {
+                divergence.diverged = true;
+                divergence.field    = names[field];
+                divergence.gpu      = gpu_fields[field];
+                divergence.cpu      = cpu_fields[field];
+
+                return divergence;
+            }
+        }
+    }
+
+    return ParticleDivergence();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t ParticleReference::step_hash(const ReferenceParticle* particles, const uint32_t* alive, uint32_t alive_count, uint32_t step)
+{
+    uint32_t sum = 0;
+    uint32_t mix = 0;
+
+    for (uint32_t index = 0; index < alive_count; index++)
+    {
+        const ReferenceParticle& particle = particles[alive[index]];
+
+        uint32_t h = hash_combine(pcg_hash(index ^ pcg_hash(step)), alive[index]);
+        h          = hash_combine(h, particle.lifetime.x);
+        h          = hash_combine(h, particle.lifetime.y);
+        h          = hash_combine(h, particle.velocity.x);
+        h          = hash_combine(h, particle.velocity.y);
+        h          = hash_combine(h, particle.velocity.z);
+        h          = hash_combine(h, particle.position.x);
+        h          = hash_combine(h, particle.position.y);
+        h          = hash_combine(h, particle.position.z);
+
+        sum += h;
+        mix ^= pcg_hash(h);
+    }
+
+    return (uint64_t(sum) << 32) | uint64_t(mix);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t ParticleReference::combine_hashes(uint64_t state, uint64_t step)
+{
+    uint32_t sum = uint32_t(state >> 32) + uint32_t(step >> 32);
+    uint32_t mix = uint32_t(state) ^ uint32_t(step);
+
+    return (uint64_t(sum) << 32) | uint64_t(mix);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
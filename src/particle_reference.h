@@ -0,0 +1,96 @@
+#pragma once
+
+#include "vector_field.h"
+#include <glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Mirrors the std430 Particle struct used by the compute shaders.
+struct ReferenceParticle
+{
+    glm::vec4 lifetime;
+    glm::vec4 velocity;
+    glm::vec4 position;
+    glm::vec4 orientation;
+};
+
+// The subset of the emitter uniforms the deterministic path reads.
+struct ReferenceEmitter
+{
+    glm::vec3         position;
+    glm::vec3         direction;
+    glm::vec3         constant_velocity;
+    float             sphere_radius;
+    float             viscosity;
+    float             delta_time;
+    float             min_initial_speed;
+    float             max_initial_speed;
+    float             min_lifetime;
+    float             max_lifetime;
+    int32_t           emission_shape;
+    int32_t           direction_type;
+    bool              affected_by_gravity;
+    uint32_t          emission_count;
+    uint32_t          step_index;
+    uint32_t          particle_quota;
+    const ForceField* forces;
+    uint32_t          force_count;
+    int32_t           max_substeps;
+    bool              adaptive_substeps;
+    float             substep_distance;
+};
+
+struct ParticleDivergence
+{
+    bool        diverged   = false;
+    uint32_t    list_index = 0;
+    uint32_t    slot       = 0;
+    std::string field;
+    float       gpu = 0.0f;
+    float       cpu = 0.0f;
+};
+
+// CPU implementation of the deterministic GPU path: emission, simulation and compaction, step for step.
+// Used to catch shader edits that change behaviour by comparing against a readback of the GPU state.
+class ParticleReference
+{
+public:
+    ParticleReference(uint32_t max_particles);
+
+    // Same state as particle_initialize(): every slot dead, dead list sorted by slot.
+    void reset();
+    void step(const ReferenceEmitter& emitter);
+
+    // Compares a GPU readback of the particle data and post simulation alive list. Fields match if they are
+    // within tolerance, relative to their magnitude once that exceeds one.
+    ParticleDivergence compare(const ReferenceParticle* particles, const uint32_t* alive, uint32_t alive_count, float tolerance) const;
+
+    // Hash of every step since reset(), combined the way the GPU accumulates them.
+    inline uint64_t state_hash() const { return m_state_hash; }
+    inline uint64_t step_hash() const { return step_hash(m_particles.data(), m_alive.data(), uint32_t(m_alive.size()), m_step); }
+
+    // One step's contribution, same reduction as shader/particle_state_hash_cs.glsl.
+    static uint64_t step_hash(const ReferenceParticle* particles, const uint32_t* alive, uint32_t alive_count, uint32_t step);
+
+    // Folds a step hash into a running state hash: sums add and mixes xor, like the shader's atomics.
+    static uint64_t combine_hashes(uint64_t state, uint64_t step);
+
+    inline uint32_t                              alive_count() const { return uint32_t(m_alive.size()); }
+    inline const std::vector<ReferenceParticle>& particles() const { return m_particles; }
+    inline const std::vector<uint32_t>&          alive() const { return m_alive; }
+
+private:
+    void emit(const ReferenceEmitter& emitter);
+    void simulate(const ReferenceEmitter& emitter);
+    void compact();
+
+private:
+    uint32_t                       m_max_particles;
+    std::vector<ReferenceParticle> m_particles;
+    std::vector<uint32_t>          m_alive;
+    std::vector<uint32_t>          m_dead;
+    std::vector<uint8_t>           m_flags;
+    uint32_t                       m_step       = 0;
+    uint64_t                       m_state_hash = 0;
+};
@@ -0,0 +1,156 @@
+#include "persistent_buffer.h"
+
+// Largest offset alignment any implementation is allowed to require for uniform and storage buffer bindings.
+#define PERSISTENT_BUFFER_ALIGNMENT 256
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static size_t align_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+PersistentBuffer::PersistentBuffer(GLenum target, size_t region_size, uint32_t region_count, GLbitfield access) :
+    m_target(target), m_region_size(align_up(region_size, PERSISTENT_BUFFER_ALIGNMENT)), m_region_count(region_count), m_fences(region_count, nullptr)
+{
+    GLbitfield flags = access | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &m_handle);
+    glBindBuffer(m_target, m_handle);
+    glBufferStorage(m_target, m_region_size * m_region_count, nullptr, flags);
+
+    m_mapped = (uint8_t*)glMapBufferRange(m_target, 0, m_region_size * m_region_count, flags);
+
+    if (!m_mapped)
+        DW_LOG_ERROR("Failed to persistently map buffer");
+
+    // Start on the last region so the first begin_frame() lands on region 0.
+    m_current_region = m_region_count - 1;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+PersistentBuffer::~PersistentBuffer()
+{
+    for (GLsync fence : m_fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+    }
+
+    glBindBuffer(m_target, m_handle);
+    glUnmapBuffer(m_target);
+    glDeleteBuffers(1, &m_handle);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void PersistentBuffer::begin_frame()
+{
+    next_region();
+    wait(m_current_region, GL_TIMEOUT_IGNORED);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void PersistentBuffer::next_region()
+{
+    m_current_region = (m_current_region + 1) % m_region_count;
+    m_head           = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void PersistentBuffer::end_frame()
+{
+    fence(m_current_region);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* PersistentBuffer::allocate(size_t size, size_t& offset)
+{
+    size_t aligned_size = align_up(size, PERSISTENT_BUFFER_ALIGNMENT);
+
+    if (m_head + aligned_size > m_region_size)
+    {
+        DW_LOG_ERROR("Persistent buffer region exhausted");
+        return nullptr;
+    }
+
+    offset = this->offset(m_current_region) + m_head;
+    m_head += aligned_size;
+
+    return m_mapped + offset;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void PersistentBuffer::bind_range(uint32_t index, size_t offset, size_t size)
+{
+    glBindBufferRange(m_target, index, m_handle, offset, size);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool PersistentBuffer::try_wait(uint32_t region)
+{
+    return wait(region, 0);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void PersistentBuffer::fence(uint32_t region)
+{
+    if (m_fences[region])
+        glDeleteSync(m_fences[region]);
+
+    m_fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint8_t* PersistentBuffer::data(uint32_t region)
+{
+    return m_mapped + offset(region);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t PersistentBuffer::offset(uint32_t region)
+{
+    return m_region_size * region;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool PersistentBuffer::wait(uint32_t region, GLuint64 timeout)
+{
+    GLsync fence = m_fences[region];
+
+    if (!fence)
+        return true;
+
+    // glClientWaitSync only accepts a finite timeout, so an unbounded wait polls in one second slices.
+    GLuint64 slice = timeout == GL_TIMEOUT_IGNORED ? 1000000000 : timeout;
+
+    while (true)
+    {
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, slice);
+
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+            break;
+
+        if (result == GL_WAIT_FAILED || timeout != GL_TIMEOUT_IGNORED)
+            return false;
+    }
+
+    glDeleteSync(fence);
+    m_fences[region] = nullptr;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <ogl.h>
+#include <vector>
+
+// A buffer created with immutable storage that stays mapped for its whole lifetime.
+// The storage is split into equally sized regions, one per frame in flight, and each
+// region is guarded by a fence so the CPU never touches memory the GPU is still using.
+class PersistentBuffer
+{
+public:
+    PersistentBuffer(GLenum target, size_t region_size, uint32_t region_count, GLbitfield access);
+    ~PersistentBuffer();
+
+    // Moves on to the next region, blocking until the GPU has released it, and resets the allocator.
+    void begin_frame();
+
+    // Same as begin_frame() without the wait. Readers check the region with try_wait() instead.
+    void next_region();
+
+    // Fences the current region after all commands that reference it have been submitted.
+    void end_frame();
+
+    // Sub-allocates from the current region. Returns nullptr once the region is exhausted.
+    void* allocate(size_t size, size_t& offset);
+
+    void     bind_range(uint32_t index, size_t offset, size_t size);
+    bool     try_wait(uint32_t region);
+    void     fence(uint32_t region);
+    uint8_t* data(uint32_t region);
+    size_t   offset(uint32_t region);
+
+    inline GLuint   handle() { return m_handle; }
+    inline uint32_t current_region() { return m_current_region; }
+    inline uint32_t region_count() { return m_region_count; }
+    inline size_t   region_size() { return m_region_size; }
+
+private:
+    bool wait(uint32_t region, GLuint64 timeout);
+
+private:
+    GLenum              m_target;
+    GLuint              m_handle         = 0;
+    uint8_t*            m_mapped         = nullptr;
+    size_t              m_region_size    = 0;
+    uint32_t            m_region_count   = 0;
+    uint32_t            m_current_region = 0;
+    size_t              m_head           = 0;
+    std::vector<GLsync> m_fences;
+};
@@ -0,0 +1,49 @@
+// ------------------------------------------------------------------
+// CONSTANTS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+#define BILLBOARD_SCREEN 0
+#define BILLBOARD_VELOCITY 1
+#define BILLBOARD_AXIS 2
+#define TWO_PI 6.28318530718
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Rotation is kept in lifetime.w and angular velocity in velocity.w, wrapped so the angle doesn't lose precision.
+float integrate_rotation(vec4 lifetime, vec4 velocity, float dt)
+{
+    return mod(lifetime.w + velocity.w * dt, TWO_PI);
+}
+
+// The view plane axes spanned by the quad's corners, right in xy and up in zw, sized relative to the particle size.
+// Built once per particle per frame for the main camera by particle_billboard_cs.glsl, so particle_vs.glsl does the same
+// two multiply-adds in every mode.
+vec4 billboard_basis(vec4 lifetime, vec4 velocity)
+{
+    vec2 up = vec2(sin(lifetime.w), cos(lifetime.w));
+
+    if (Emitter.billboard_mode != BILLBOARD_SCREEN)
+    {
+        vec3  axis      = Emitter.billboard_mode == BILLBOARD_VELOCITY ? velocity.xyz + Emitter.constant_velocity : Emitter.billboard_axis;
+        vec2  projected = (mat3(Global.camera_view) * axis).xy;
+        float length_2d = length(projected);
+
+        // Velocity quads stretch with their on screen speed, axis quads shorten as the axis turns towards the camera.
+        // A particle at rest or an axis pointing at the camera keeps its rotated screen aligned quad.
+        if (length_2d > 1e-5)
+        {
+            vec2 direction = projected / length_2d;
+
+            if (Emitter.billboard_mode == BILLBOARD_VELOCITY)
+                return vec4(direction.y, -direction.x, direction * (1.0 + length_2d * Emitter.velocity_stretch));
+            else
+                return vec4(direction.y, -direction.x, projected);
+        }
+    }
+
+    return vec4(up.y, -up.x, up);
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,143 @@
+// ------------------------------------------------------------------
+// CONSTANTS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+#define BVH_INVALID_NODE 0xFFFFFFFFu
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Flattened by bvh.cpp: nodes are depth first, so an interior node's left child is the next node and every node
+// carries the index to continue at once it has been missed or finished.
+struct BVHNode
+{
+    vec3 bounds_min;
+    uint miss;
+    vec3 bounds_max;
+    uint triangles; // Leaves: first triangle << 4 | count, interior nodes: 0
+};
+
+struct BVHTriangle
+{
+    vec4 v0;
+    vec4 v1;
+    vec4 v2;
+};
+
+layout(std430, binding = SSBO_BINDING_BVH_NODES) buffer BVHNodes_t
+{
+    BVHNode nodes[];
+}
+BVHNodes;
+
+layout(std430, binding = SSBO_BINDING_BVH_TRIANGLES) buffer BVHTriangles_t
+{
+    BVHTriangle triangles[];
+}
+BVHTriangles;
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+bool intersect_aabb(vec3 origin, vec3 inv_direction, vec3 bounds_min, vec3 bounds_max, float max_t)
+{
+    vec3 t0 = (bounds_min - origin) * inv_direction;
+    vec3 t1 = (bounds_max - origin) * inv_direction;
+
+    vec3 t_near = min(t0, t1);
+    vec3 t_far  = max(t0, t1);
+
+    float enter = max(max(t_near.x, t_near.y), max(t_near.z, 0.0));
+    float exit  = min(min(t_far.x, t_far.y), min(t_far.z, max_t));
+
+    return enter <= exit;
+}
+
+// Moller-Trumbore, double sided.
+bool intersect_triangle(vec3 origin, vec3 direction, BVHTriangle triangle, out float t)
+{
+    vec3  edge1 = triangle.v1.xyz - triangle.v0.xyz;
+    vec3  edge2 = triangle.v2.xyz - triangle.v0.xyz;
+    vec3  p     = cross(direction, edge2);
+    float det   = dot(edge1, p);
+
+    if (abs(det) < 1e-12)
+        return false;
+
+    float inv_det = 1.0 / det;
+    vec3  s       = origin - triangle.v0.xyz;
+    float u       = dot(s, p) * inv_det;
+
+    if (u < 0.0 || u > 1.0)
+        return false;
+
+    vec3  q = cross(s, edge1);
+    float v = dot(direction, q) * inv_det;
+
+    if (v < 0.0 || u + v > 1.0)
+        return false;
+
+    t = dot(edge2, q) * inv_det;
+
+    return t >= 0.0;
+}
+
+// Closest hit along origin + direction * t for t in [0, max_t]. Walks the miss links instead of keeping a stack,
+// so the traversal costs no registers or shared memory per level. The normal faces against the direction.
+bool intersect_bvh(vec3 origin, vec3 direction, float max_t, out float t, out vec3 surface_normal)
+{
+    vec3 inv_direction = 1.0 / direction;
+    uint node          = 0;
+    uint hit_triangle  = BVH_INVALID_NODE;
+
+    t = max_t;
+
+    while (node != BVH_INVALID_NODE)
+    {
+        BVHNode current = BVHNodes.nodes[node];
+
+        if (!intersect_aabb(origin, inv_direction, current.bounds_min, current.bounds_max, t))
+        {
+            node = current.miss;
+            continue;
+        }
+
+        if (current.triangles == 0)
+        {
+            node++;
+            continue;
+        }
+
+        uint first = current.triangles >> 4;
+        uint count = current.triangles & 0xF;
+
+        for (uint i = first; i < first + count; i++)
+        {
+            float hit_t;
+
+            if (intersect_triangle(origin, direction, BVHTriangles.triangles[i], hit_t) && hit_t <= t)
+            {
+                t            = hit_t;
+                hit_triangle = i;
+            }
+        }
+
+        node = current.miss;
+    }
+
+    if (hit_triangle == BVH_INVALID_NODE)
+        return false;
+
+    BVHTriangle triangle = BVHTriangles.triangles[hit_triangle];
+
+    surface_normal = normalize(cross(triangle.v1.xyz - triangle.v0.xyz, triangle.v2.xyz - triangle.v0.xyz));
+
+    if (dot(surface_normal, direction) > 0.0)
+        surface_normal = -surface_normal;
+
+    return true;
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include <random.glsl>
+#include <bvh.glsl>
+
+// ------------------------------------------------------------------
+// CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#ifndef LOCAL_SIZE
+#define LOCAL_SIZE 32
+#endif
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(std430, binding = SSBO_BINDING_BENCHMARK_OUTPUT) buffer BenchmarkOutput_t
+{
+    vec4 value;
+}
+BenchmarkOutput;
+
+uniform int   u_ParticleCount;
+uniform int   u_Traverse;
+uniform vec3  u_BoundsMin;
+uniform vec3  u_BoundsMax;
+uniform float u_SegmentLength;
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+
+    if (index < u_ParticleCount)
+    {
+        // Synthetic particles spread over the scene bounds, each moving one step in a random direction.
+        vec3 position  = mix(u_BoundsMin, u_BoundsMax, vec3(counter_rand(index, 0u), counter_rand(index, 1u), counter_rand(index, 2u)));
+        vec3 direction = vec3(counter_rand(index, 3u), counter_rand(index, 4u), counter_rand(index, 5u)) * 2.0 - 1.0;
+        vec3 segment   = normalize(direction + vec3(1e-4)) * u_SegmentLength;
+
+        float t;
+        vec3  surface_normal;
+
+        // Never true in practice, but keeps the traversal from being optimized away.
+        if (u_Traverse == 1 && intersect_bvh(position, segment, 1.0, t, surface_normal) && t == 123456.0)
+            BenchmarkOutput.value = vec4(surface_normal, t);
+    }
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
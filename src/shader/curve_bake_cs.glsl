@@ -0,0 +1,169 @@
+#include <uniforms.glsl>
+
+// ------------------------------------------------------------------
+// CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#ifndef LOCAL_SIZE
+#define LOCAL_SIZE 32
+#endif
+#define CURVE_MAX_MARKS 16
+#define NEWTON_ITERATIONS 8
+#define BISECTION_ITERATIONS 24
+#define SOLVE_EPSILON 0.00001
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+struct CurveKeys
+{
+    vec4  colors[CURVE_MAX_MARKS];
+    float positions[CURVE_MAX_MARKS];
+    vec4  size_curve; // xy: first control point, zw: second control point
+    float start_size;
+    float end_size;
+    int   mark_count;
+    int   row;
+};
+
+layout(std430, binding = SSBO_BINDING_CURVE_KEYS) buffer CurveKeys_t
+{
+    CurveKeys emitters[];
+}
+Curves;
+
+layout(binding = 0, rgba16f) uniform writeonly image2D i_CurveAtlas;
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+// One axis of a cubic bezier with its end points fixed at 0 and 1.
+float bezier(float p1, float p2, float t)
+{
+    float u = 1.0 - t;
+    return 3.0 * u * u * t * p1 + 3.0 * u * t * t * p2 + t * t * t;
+}
+
+// ------------------------------------------------------------------
+
+float bezier_derivative(float p1, float p2, float t)
+{
+    float u = 1.0 - t;
+    return 3.0 * u * u * p1 + 6.0 * u * t * (p2 - p1) + 3.0 * t * t * (1.0 - p2);
+}
+
+// ------------------------------------------------------------------
+
+// Finds the curve parameter whose x coordinate equals x. Newton converges in a couple of steps for
+// well behaved curves, bisection covers the cases where the derivative flattens out.
+float solve_bezier(float x, float p1, float p2)
+{
+    float t = x;
+
+    for (int i = 0; i < NEWTON_ITERATIONS; i++)
+    {
+        float error = bezier(p1, p2, t) - x;
+
+        if (abs(error) < SOLVE_EPSILON)
+            return t;
+
+        float derivative = bezier_derivative(p1, p2, t);
+
+        if (abs(derivative) < SOLVE_EPSILON)
+            break;
+
+        t -= error / derivative;
+
+        if (t < 0.0 || t > 1.0)
+            break;
+    }
+
+    float lo = 0.0;
+    float hi = 1.0;
+
+    t = 0.5;
+
+    for (int i = 0; i < BISECTION_ITERATIONS; i++)
+    {
+        float value = bezier(p1, p2, t);
+
+        if (abs(value - x) < SOLVE_EPSILON)
+            break;
+
+        if (value < x)
+            lo = t;
+        else
+            hi = t;
+
+        t = 0.5 * (lo + hi);
+    }
+
+    return t;
+}
+
+// ------------------------------------------------------------------
+
+vec4 evaluate_gradient(uint emitter, float t)
+{
+    int count = Curves.emitters[emitter].mark_count;
+
+    if (count == 0)
+        return vec4(0.0);
+
+    if (t <= Curves.emitters[emitter].positions[0])
+        return Curves.emitters[emitter].colors[0];
+
+    for (int i = 1; i < count; i++)
+    {
+        float upper = Curves.emitters[emitter].positions[i];
+
+        if (t <= upper)
+        {
+            float lower = Curves.emitters[emitter].positions[i - 1];
+            float delta = (t - lower) / max(upper - lower, SOLVE_EPSILON);
+
+            return mix(Curves.emitters[emitter].colors[i - 1], Curves.emitters[emitter].colors[i], delta);
+        }
+    }
+
+    return Curves.emitters[emitter].colors[count - 1];
+}
+
+// ------------------------------------------------------------------
+
+float evaluate_size(uint emitter, float t)
+{
+    vec4  p = Curves.emitters[emitter].size_curve;
+    float y = bezier(p.y, p.w, solve_bezier(t, p.x, p.z));
+
+    return mix(Curves.emitters[emitter].start_size, Curves.emitters[emitter].end_size, y);
+}
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    uint emitter = gl_GlobalInvocationID.y;
+    int  x       = int(gl_GlobalInvocationID.x);
+    int  width   = imageSize(i_CurveAtlas).x;
+
+    if (x >= width)
+        return;
+
+    // The first and last texels hold the exact end points of the curve.
+    float t   = float(x) / float(width - 1);
+    int   row = Curves.emitters[emitter].row;
+
+    imageStore(i_CurveAtlas, ivec2(x, row), evaluate_gradient(emitter, t));
+    imageStore(i_CurveAtlas, ivec2(x, row + 1), vec4(evaluate_size(emitter, t), 0.0, 0.0, 0.0));
+}
\ No newline at end of file
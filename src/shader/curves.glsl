@@ -0,0 +1,32 @@
+// ------------------------------------------------------------------
+// CURVE ATLAS ------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Every emitter owns two rows of the atlas: color over lifetime followed by size over lifetime.
+layout(binding = 0) uniform sampler2D s_CurveAtlas;
+
+// ------------------------------------------------------------------
+
+vec2 curve_coord(float t, int row)
+{
+    vec2 size = vec2(textureSize(s_CurveAtlas, 0));
+
+    // Map [0, 1] onto texel centers so both ends of the curve are sampled exactly.
+    return vec2((clamp(t, 0.0, 1.0) * (size.x - 1.0) + 0.5) / size.x, (float(row) + 0.5) / size.y);
+}
+
+// ------------------------------------------------------------------
+
+vec4 color_over_time(float t)
+{
+    return textureLod(s_CurveAtlas, curve_coord(t, Emitter.curve_row), 0.0);
+}
+
+// ------------------------------------------------------------------
+
+float size_over_time(float t)
+{
+    return textureLod(s_CurveAtlas, curve_coord(t, Emitter.curve_row + 1), 0.0).r;
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,29 @@
+#include <uniforms.glsl>
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(binding = 0) uniform sampler2D s_Depth;
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    ivec2 size   = textureSize(s_Depth, 0) - 1;
+    ivec2 origin = ivec2(gl_FragCoord.xy) * Global.particle_scale;
+    float depth  = 0.0;
+
+    // Keep the farthest sample so thin geometry never hides particles in front of it
+    for (int y = 0; y < Global.particle_scale; y++)
+    {
+        for (int x = 0; x < Global.particle_scale; x++)
+            depth = max(depth, texelFetch(s_Depth, min(origin + ivec2(x, y), size), 0).r);
+    }
+
+    gl_FragDepth = depth;
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
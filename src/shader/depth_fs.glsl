@@ -1,9 +1,45 @@
+// ------------------------------------------------------------------
+// CONSTANTS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+#if defined(SPRITE_ATLAS)
+// Same cutoff as particle_fs.glsl so the shadow has the sprite's shape instead of the quad's
+#define SPRITE_ALPHA_CUTOFF 0.25
+#endif
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+#if defined(SPRITE_ATLAS)
+in vec3  FS_IN_TexCoord0;
+in vec3  FS_IN_TexCoord1;
+in float FS_IN_FrameBlend;
+#endif
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#if defined(SPRITE_ATLAS)
+layout(binding = 1) uniform sampler2DArray s_SpriteAtlas;
+#endif
+
 // ------------------------------------------------------------------
 // MAIN -------------------------------------------------------------
 // ------------------------------------------------------------------
 
 void main()
 {
+#if defined(SPRITE_ATLAS)
+    if (FS_IN_TexCoord0.z >= 0.0)
+    {
+        float alpha = mix(texture(s_SpriteAtlas, FS_IN_TexCoord0).a, texture(s_SpriteAtlas, FS_IN_TexCoord1).a, FS_IN_FrameBlend);
+
+        if (alpha < SPRITE_ALPHA_CUTOFF)
+            discard;
+    }
+#endif
 }
 
 // ------------------------------------------------------------------
\ No newline at end of file
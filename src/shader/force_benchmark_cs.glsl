@@ -0,0 +1,53 @@
+#include <random.glsl>
+#include <uniforms.glsl>
+#include <forces.glsl>
+
+// ------------------------------------------------------------------
+// CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#ifndef LOCAL_SIZE
+#define LOCAL_SIZE 32
+#endif
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(std430, binding = SSBO_BINDING_BENCHMARK_OUTPUT) buffer BenchmarkOutput_t
+{
+    vec4 value;
+}
+BenchmarkOutput;
+
+uniform int u_ParticleCount;
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+
+    if (index < u_ParticleCount)
+    {
+        // Synthetic particles spread over the playground so every branch sees a realistic mix of hits and misses.
+        vec3 position = (vec3(counter_rand(index, 0u), counter_rand(index, 1u), counter_rand(index, 2u)) * 2.0 - 1.0) * 10.0;
+        vec3 velocity = vec3(counter_rand(index, 3u), counter_rand(index, 4u), counter_rand(index, 5u)) * 2.0 - 1.0;
+
+        vec3 acceleration = evaluate_forces(position, velocity);
+
+        // Never true in practice, but keeps the evaluation from being optimized away.
+        if (acceleration.x == 123456.0)
+            BenchmarkOutput.value = vec4(acceleration, 1.0);
+    }
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
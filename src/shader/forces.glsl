@@ -0,0 +1,81 @@
+// ------------------------------------------------------------------
+// CONSTANTS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+#define FORCE_POINT 0
+#define FORCE_VORTEX 1
+#define FORCE_DRAG 2
+#define FORCE_VECTOR_FIELD 3
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+struct Force
+{
+    vec4  position; // Bounds min for vector fields
+    vec4  axis;     // Bounds max for vector fields
+    int   type;
+    float strength;
+    float radius;
+    float falloff;
+};
+
+layout(std430, binding = SSBO_BINDING_FORCES) buffer Forces_t
+{
+    Force forces[];
+}
+Forces;
+
+layout(binding = 2) uniform sampler3D s_VectorField;
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+float force_attenuation(Force force, float distance)
+{
+    return pow(1.0 - distance / force.radius, force.falloff);
+}
+
+// Acceleration from every force in the packed list, evaluated in a single loop.
+vec3 evaluate_forces(vec3 position, vec3 velocity)
+{
+    vec3 acceleration = vec3(0.0);
+
+    for (int i = 0; i < Global.force_count; i++)
+    {
+        Force force = Forces.forces[i];
+
+        if (force.type == FORCE_POINT)
+        {
+            vec3  to_center = force.position.xyz - position;
+            float distance  = length(to_center);
+
+            if (distance < force.radius && distance > 1e-4)
+                acceleration += to_center / distance * force.strength * force_attenuation(force, distance);
+        }
+        else if (force.type == FORCE_VORTEX)
+        {
+            vec3  offset   = position - force.position.xyz;
+            vec3  radial   = offset - force.axis.xyz * dot(offset, force.axis.xyz);
+            float distance = length(radial);
+
+            if (distance < force.radius && distance > 1e-4)
+                acceleration += cross(force.axis.xyz, radial / distance) * force.strength * force_attenuation(force, distance);
+        }
+        else if (force.type == FORCE_DRAG)
+            acceleration -= velocity * force.strength;
+        else if (force.type == FORCE_VECTOR_FIELD)
+        {
+            vec3 uvw = (position - force.position.xyz) / (force.axis.xyz - force.position.xyz);
+
+            if (all(greaterThanEqual(uvw, vec3(0.0))) && all(lessThanEqual(uvw, vec3(1.0))))
+                acceleration += textureLod(s_VectorField, uvw, 0.0).xyz * force.strength;
+        }
+    }
+
+    return acceleration;
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,18 @@
+// ------------------------------------------------------------------
+// OUTPUTS ----------------------------------------------------------
+// ------------------------------------------------------------------
+
+out vec2 FS_IN_TexCoord;
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    // Single triangle covering the viewport, generated from the vertex index
+    FS_IN_TexCoord = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position    = vec4(FS_IN_TexCoord * 2.0 - 1.0, 0.0, 1.0);
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,53 @@
+// ------------------------------------------------------------------
+// CONSTANTS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+#define DRAW_MATERIAL_EMITTER 0
+#define DRAW_MATERIAL_SUB_EMITTER 1
+#define DRAW_MATERIAL_COUNT 2
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Curve rows index the atlas declared in curves.glsl, which must be included first.
+struct DrawMaterial
+{
+    vec4  tint;
+    int   curve_row;
+    float size_scale;
+    int   first_frame; // Flipbook frames in the sprite atlas, none when frame_count is 0
+    int   frame_count;
+};
+
+layout(std430, binding = 14) buffer DrawMaterials_t
+{
+    DrawMaterial materials[];
+}
+DrawMaterials;
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+// lifetime.z is 0 for emitted particles and 1 for sub-emitter children.
+uint particle_material(vec4 lifetime)
+{
+    return min(uint(lifetime.z), uint(DRAW_MATERIAL_COUNT - 1));
+}
+
+// ------------------------------------------------------------------
+
+vec4 material_color(DrawMaterial material, float t)
+{
+    return textureLod(s_CurveAtlas, curve_coord(t, material.curve_row), 0.0) * material.tint;
+}
+
+// ------------------------------------------------------------------
+
+float material_size(DrawMaterial material, float t)
+{
+    return textureLod(s_CurveAtlas, curve_coord(t, material.curve_row + 1), 0.0).r * material.size_scale;
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -1,3 +1,5 @@
+#include <uniforms.glsl>
+
 // ------------------------------------------------------------------
 // OUTPUT VARIABLES  ------------------------------------------------
 // ------------------------------------------------------------------
@@ -15,19 +17,16 @@ in vec3 FS_IN_Normal;
 // UNIFORMS ---------------------------------------------------------
 // ------------------------------------------------------------------
 
-uniform mat4      u_LightViewProj;
-uniform vec3      u_LightColor;
-uniform vec3      u_Color;
-uniform vec3      u_Direction;
-uniform float     u_Bias;
-uniform sampler2D s_ShadowMap;
+uniform vec3 u_Color;
+
+layout(binding = 0) uniform sampler2D s_ShadowMap;
 
 // ------------------------------------------------------------------
 
 float shadow_occlussion(vec3 p)
 {
     // Transform frag position into Light-space.
-    vec4 light_space_pos = u_LightViewProj * vec4(p, 1.0);
+    vec4 light_space_pos = Global.light_view_proj * vec4(p, 1.0);
 
     vec3 proj_coords = light_space_pos.xyz / light_space_pos.w;
     // transform to [0,1] range
@@ -37,7 +36,7 @@ float shadow_occlussion(vec3 p)
     // get depth of current fragment from light's perspective
     float current_depth = proj_coords.z;
     // check whether current frag pos is in shadow
-    float bias   = u_Bias;
+    float bias   = Global.shadow_bias;
     float shadow = current_depth - bias > closest_depth ? 1.0 : 0.0;
 
     return 1.0 - shadow;
@@ -51,7 +50,7 @@ void main()
 {
     float shadow = shadow_occlussion(FS_IN_WorldPos);
 
-    vec3 L = normalize(-u_Direction);
+    vec3 L = normalize(-Global.light_direction.xyz);
     vec3 N = normalize(FS_IN_Normal);
 
     FS_OUT_Color = u_Color * clamp(dot(N, L), 0.0, 1.0) * shadow + u_Color * 0.1;
@@ -1,3 +1,5 @@
+#include <uniforms.glsl>
+
 // ------------------------------------------------------------------
 // INPUT VARIABLES --------------------------------------------------
 // ------------------------------------------------------------------
@@ -19,7 +21,6 @@ out vec3 FS_IN_Normal;
 // UNIFORMS ---------------------------------------------------------
 // ------------------------------------------------------------------
 
-uniform mat4 u_ViewProj;
 uniform mat4 u_Model;
 
 // ------------------------------------------------------------------
@@ -32,7 +33,7 @@ void main()
     FS_IN_WorldPos = world_pos.xyz;
     FS_IN_Normal   = normalize(normalize(mat3(u_Model) * VS_IN_Normal));
 
-    gl_Position = u_ViewProj * world_pos;
+    gl_Position = View.view_proj * world_pos;
 }
 
 // ------------------------------------------------------------------
@@ -0,0 +1,71 @@
+#include <uniforms.glsl>
+#include <billboards.glsl>
+
+// ------------------------------------------------------------------
+// CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#ifndef LOCAL_SIZE
+#define LOCAL_SIZE 32
+#endif
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+struct Particle
+{
+    vec4 lifetime;
+    vec4 velocity;
+    vec4 position;
+    vec4 orientation;
+};
+
+layout(std430, binding = 0) buffer ParticleData_t
+{
+    Particle particles[];
+}
+ParticleData;
+
+layout(std430, binding = SSBO_BINDING_ALIVE_POST_SIM) buffer ParticleAlivePostSimIndices_t
+{
+    uint indices[];
+}
+AliveIndicesPostSim;
+
+layout(std430, binding = 3) buffer ParticleDrawArgs_t
+{
+    uint count;
+    uint instance_count;
+    uint first;
+    uint base_instance;
+}
+ParticleDrawArgs;
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Runs every frame over the list that is drawn, so the basis follows the camera on frames where LOD or a frozen
+// emitter skip the simulation. Only the basis is written, rotation is integrated by the simulation.
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+
+    if (index < ParticleDrawArgs.instance_count)
+    {
+        uint particle_index = AliveIndicesPostSim.indices[index];
+        vec4 lifetime       = ParticleData.particles[particle_index].lifetime;
+        vec4 velocity       = ParticleData.particles[particle_index].velocity;
+
+        ParticleData.particles[particle_index].orientation = billboard_basis(lifetime, velocity);
+    }
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include <uniforms.glsl>
+
+// ------------------------------------------------------------------
+// CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+// One of COMPACTION_PASS_COUNT, COMPACTION_PASS_SCAN or COMPACTION_PASS_WRITE is defined at compile time.
+#define BLOCK_SIZE 1024
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(local_size_x = BLOCK_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(std430, binding = 4) buffer ParticleAliveFlags_t
+{
+    uint flags[];
+}
+AliveFlags;
+
+layout(std430, binding = 10) buffer BlockOffsets_t
+{
+    uint offsets[];
+}
+BlockOffsets;
+
+layout(std430, binding = SSBO_BINDING_ALIVE_POST_SIM) buffer ParticleAlivePostSimIndices_t
+{
+    uint indices[];
+}
+AliveIndicesPostSim;
+
+layout(std430, binding = 1) buffer ParticleDeadIndices_t
+{
+    uint indices[];
+}
+DeadIndices;
+
+layout(std430, binding = 2) buffer ParticleCounters_t
+{
+    uint dead_count;
+    uint alive_count[2];
+    uint simulation_count;
+    uint emission_count;
+}
+Counters;
+
+layout(std430, binding = 3) buffer ParticleDrawArgs_t
+{
+    uint count;
+    uint instance_count;
+    uint first;
+    uint base_instance;
+}
+ParticleDrawArgs;
+
+uniform int u_MaxParticles;
+
+shared uint s_Scan[BLOCK_SIZE];
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Work group wide exclusive prefix sum. Must be reached by every invocation; the group total is left in the last element.
+uint exclusive_scan(uint value)
+{
+    uint lid = gl_LocalInvocationID.x;
+
+    s_Scan[lid] = value;
+    barrier();
+
+    for (uint offset = 1; offset < BLOCK_SIZE; offset <<= 1)
+    {
+        uint sum = lid >= offset ? s_Scan[lid - offset] : 0;
+        barrier();
+        s_Scan[lid] += sum;
+        barrier();
+    }
+
+    return s_Scan[lid] - value;
+}
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    uint lid = gl_LocalInvocationID.x;
+
+#if defined(COMPACTION_PASS_COUNT)
+    uint slot = gl_GlobalInvocationID.x;
+
+    exclusive_scan(slot < u_MaxParticles ? AliveFlags.flags[slot] : 0);
+
+    if (lid == BLOCK_SIZE - 1)
+        BlockOffsets.offsets[gl_WorkGroupID.x] = s_Scan[lid];
+#elif defined(COMPACTION_PASS_SCAN)
+    // A single group scans the per block totals, which caps the pool at BLOCK_SIZE * BLOCK_SIZE particles.
+    uint block_count = (u_MaxParticles + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint offset      = exclusive_scan(lid < block_count ? BlockOffsets.offsets[lid] : 0);
+
+    if (lid < block_count)
+        BlockOffsets.offsets[lid] = offset;
+
+    if (lid == BLOCK_SIZE - 1)
+    {
+        uint alive_count = s_Scan[lid];
+
+        Counters.alive_count[Emitter.post_sim_idx] = alive_count;
+        Counters.dead_count                        = u_MaxParticles - alive_count;
+        ParticleDrawArgs.instance_count            = alive_count;
+    }
+#elif defined(COMPACTION_PASS_WRITE)
+    uint slot         = gl_GlobalInvocationID.x;
+    uint alive        = slot < u_MaxParticles ? AliveFlags.flags[slot] : 0;
+    uint alive_before = BlockOffsets.offsets[gl_WorkGroupID.x] + exclusive_scan(alive);
+
+    // Both lists come out sorted by slot: alive particles in order, dead slots in the remaining gaps.
+    if (slot < u_MaxParticles)
+    {
+        if (alive == 1)
+            AliveIndicesPostSim.indices[alive_before] = slot;
+        else
+            DeadIndices.indices[slot - alive_before] = slot;
+    }
+#endif
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include <uniforms.glsl>
+
+// ------------------------------------------------------------------
+// CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#define CAMERA_NEAR_PLANE 0.1
+#define CAMERA_FAR_PLANE 1000.0
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+in vec2 FS_IN_TexCoord;
+
+// ------------------------------------------------------------------
+// OUTPUTS ----------------------------------------------------------
+// ------------------------------------------------------------------
+
+out vec4 FS_OUT_FragColor;
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(binding = 0) uniform sampler2D s_Particles;
+layout(binding = 1) uniform sampler2D s_LowResDepth;
+layout(binding = 2) uniform sampler2D s_Depth;
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+float exp_01_to_linear_01_depth(float z, float n, float f)
+{
+    float z_buffer_params_y = f / n;
+    float z_buffer_params_x = 1.0 - z_buffer_params_y;
+
+    return 1.0 / (z_buffer_params_x * z + z_buffer_params_y);
+}
+
+// ------------------------------------------------------------------
+
+vec4 bilateral_upsample(vec2 tex_coord)
+{
+    const vec2 offsets[4] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0), vec2(1.0, 1.0));
+
+    vec2 texel_size = 1.0 / vec2(textureSize(s_Particles, 0));
+    vec2 base       = tex_coord / texel_size - 0.5;
+    vec2 f          = fract(base);
+    vec2 origin     = (floor(base) + 0.5) * texel_size;
+
+    float bilinear_weights[4] = float[]((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+
+    float depth = exp_01_to_linear_01_depth(texture(s_Depth, tex_coord).r, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+
+    vec4  color        = vec4(0.0);
+    float total_weight = 0.0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        vec2  coord     = origin + offsets[i] * texel_size;
+        float low_depth = exp_01_to_linear_01_depth(texture(s_LowResDepth, coord).r, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+
+        // Favour low resolution samples that lie on the same surface as the full resolution pixel
+        float weight = bilinear_weights[i] / (abs(depth - low_depth) * CAMERA_FAR_PLANE + 1e-3);
+
+        color += texture(s_Particles, coord) * weight;
+        total_weight += weight;
+    }
+
+    return color / max(total_weight, 1e-5);
+}
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    if (Global.particle_upsample == 1)
+        FS_OUT_FragColor = bilateral_upsample(FS_IN_TexCoord);
+    else
+        FS_OUT_FragColor = texture(s_Particles, FS_IN_TexCoord);
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include <uniforms.glsl>
+
+// ------------------------------------------------------------------
+// CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+// One of DRAW_BINNING_PASS_COUNT, DRAW_BINNING_PASS_SCAN or DRAW_BINNING_PASS_SCATTER is defined at compile time.
+#ifndef LOCAL_SIZE
+#define LOCAL_SIZE 32
+#endif
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+#if defined(DRAW_BINNING_PASS_SCAN)
+layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+#else
+layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
+#endif
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#include <curves.glsl>
+#include <materials.glsl>
+
+struct Particle
+{
+    vec4 lifetime;
+    vec4 velocity;
+    vec4 position;
+    vec4 orientation;
+};
+
+struct DrawCommand
+{
+    uint count;
+    uint instance_count;
+    uint first;
+    uint base_instance;
+};
+
+layout(std430, binding = 0) buffer ParticleData_t
+{
+    Particle particles[];
+}
+ParticleData;
+
+layout(std430, binding = SSBO_BINDING_ALIVE_POST_SIM) buffer ParticleAlivePostSimIndices_t
+{
+    uint indices[];
+}
+AliveIndicesPostSim;
+
+layout(std430, binding = 3) buffer ParticleDrawArgs_t
+{
+    uint count;
+    uint instance_count;
+    uint first;
+    uint base_instance;
+}
+ParticleDrawArgs;
+
+// draw_count is the parameter glMultiDrawArraysIndirectCount reads, the commands follow at DRAW_COMMANDS_OFFSET in main.cpp.
+layout(std430, binding = 12) buffer DrawCommands_t
+{
+    uint        draw_count;
+    uint        padding[3];
+    DrawCommand commands[DRAW_MATERIAL_COUNT];
+    uint        materials[DRAW_MATERIAL_COUNT]; // Material of every command, looked up through gl_DrawID
+    uint        cursors[DRAW_MATERIAL_COUNT];
+    uint        instance_counts[DRAW_MATERIAL_COUNT];
+}
+DrawCommands;
+
+layout(std430, binding = 13) buffer DrawIndices_t
+{
+    uint indices[];
+}
+DrawIndices;
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+#if defined(DRAW_BINNING_PASS_SCAN)
+
+// Only materials with particles get a command, so draw_count never covers empty draws.
+void main()
+{
+    uint draw = 0;
+    uint base = 0;
+
+    for (uint material = 0; material < DRAW_MATERIAL_COUNT; material++)
+    {
+        uint count = DrawCommands.instance_counts[material];
+
+        if (count == 0)
+            continue;
+
+        DrawCommands.commands[draw]    = DrawCommand(6, count, 0, base);
+        DrawCommands.materials[draw]   = material;
+        DrawCommands.cursors[material] = base;
+
+        base += count;
+        draw++;
+    }
+
+    DrawCommands.draw_count = draw;
+}
+
+#else
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+
+    if (index < ParticleDrawArgs.instance_count)
+    {
+        uint particle_index = AliveIndicesPostSim.indices[index];
+        uint material       = particle_material(ParticleData.particles[particle_index].lifetime);
+
+#if defined(DRAW_BINNING_PASS_COUNT)
+        atomicAdd(DrawCommands.instance_counts[material], 1);
+#else
+        DrawIndices.indices[atomicAdd(DrawCommands.cursors[material], 1)] = particle_index;
+#endif
+    }
+}
+
+#endif
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -1,10 +1,14 @@
 #include <random.glsl>
+#include <uniforms.glsl>
+#include <trails.glsl>
 
 // ------------------------------------------------------------------
 // CONSTANTS ---------------------------------------------------------
 // ------------------------------------------------------------------
 
+#ifndef LOCAL_SIZE
 #define LOCAL_SIZE 32
+#endif
 #define EMISSION_SHAPE_SPHERE 0
 #define EMISSION_SHAPE_BOX 1
 #define EMISSION_SHAPE_CONE 2
@@ -23,24 +27,12 @@ layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
 
 struct Particle
 {
-    vec2 lifetime;
-    vec3 velocity;
-    vec3 position;
-    vec4 color;
+    vec4 lifetime;
+    vec4 velocity;
+    vec4 position;
+    vec4 orientation;
 };
 
-uniform vec3  u_Seeds;
-uniform vec3  u_Position;
-uniform float u_MinInitialSpeed;
-uniform float u_MaxInitialSpeed;
-uniform float u_MinLifetime;
-uniform float u_MaxLifetime;
-uniform vec3  u_Direction;
-uniform int   u_EmissionShape;
-uniform int   u_DirectionType;
-uniform float u_SphereRadius;
-uniform int   u_PreSimIdx;
-
 layout(std430, binding = 0) buffer ParticleData_t
 {
     Particle particles[];
@@ -53,13 +45,13 @@ layout(std430, binding = 1) buffer ParticleDeadIndices_t
 }
 DeadIndices;
 
-layout(std430, binding = 2) buffer ParticleAlivePreSimIndices_t
+layout(std430, binding = SSBO_BINDING_ALIVE_PRE_SIM) buffer ParticleAlivePreSimIndices_t
 {
     uint indices[];
 }
 AliveIndicesPreSim;
 
-layout(std430, binding = 3) buffer Counters_t
+layout(std430, binding = 2) buffer Counters_t
 {
     uint dead_count;
     uint alive_count[2];
@@ -68,6 +60,12 @@ layout(std430, binding = 3) buffer Counters_t
 }
 Counters;
 
+layout(std430, binding = SSBO_BINDING_TRAIL_HISTORY) buffer TrailHistory_t
+{
+    vec4 points[];
+}
+TrailHistory;
+
 // ------------------------------------------------------------------
 // FUNCTIONS --------------------------------------------------------
 // ------------------------------------------------------------------
@@ -80,10 +78,29 @@ uint pop_dead_index()
 
 void push_alive_index(uint index)
 {
-    uint insert_idx                        = atomicAdd(Counters.alive_count[u_PreSimIdx], 1);
+    uint insert_idx                        = atomicAdd(Counters.alive_count[Emitter.pre_sim_idx], 1);
     AliveIndicesPreSim.indices[insert_idx] = index;
 }
 
+// In deterministic mode slots are taken from the end of the slot sorted dead list in emission order
+// and appended in that same order. Compaction rebuilds the counters afterwards, so nothing is atomic.
+uint emit_deterministic(uint index)
+{
+    uint particle_index = DeadIndices.indices[Counters.dead_count - 1 - index];
+
+    AliveIndicesPreSim.indices[Counters.alive_count[Emitter.pre_sim_idx] + index] = particle_index;
+
+    return particle_index;
+}
+
+float emission_rand(uint index, vec3 seeds, uint stream)
+{
+    if (Emitter.deterministic == 1)
+        return counter_rand(index, Emitter.step_index * 8u + stream);
+    else
+        return rand(seeds / (index + 1));
+}
+
 // ------------------------------------------------------------------
 // MAIN -------------------------------------------------------------
 // ------------------------------------------------------------------
@@ -94,29 +111,46 @@ void main()
 
     if (index < Counters.emission_count)
     {
-        uint particle_index = pop_dead_index();
+        uint particle_index = Emitter.deterministic == 1 ? emit_deterministic(index) : pop_dead_index();
 
-        vec3 position = u_Position;
+        vec3 position = Emitter.position;
 
-        if (u_EmissionShape == EMISSION_SHAPE_SPHERE)
-            position += randomPointOnSphere(rand(u_Seeds.xyz / (index + 1)), rand(u_Seeds.yzx / (index + 1)), u_SphereRadius * rand(u_Seeds.zyx / (index + 1)));
-        else if (u_EmissionShape == EMISSION_SHAPE_BOX)
+        if (Emitter.emission_shape == EMISSION_SHAPE_SPHERE)
+            position += randomPointOnSphere(emission_rand(index, Emitter.seeds.xyz, 0), emission_rand(index, Emitter.seeds.yzx, 1), Emitter.sphere_radius * emission_rand(index, Emitter.seeds.zyx, 2));
+        else if (Emitter.emission_shape == EMISSION_SHAPE_BOX)
             position += vec3(0.0);
-        else if (u_EmissionShape == EMISSION_SHAPE_CONE)
+        else if (Emitter.emission_shape == EMISSION_SHAPE_CONE)
             position += vec3(0.0);
 
-        vec3 direction = u_Direction;
+        vec3 direction = Emitter.direction;
+
+        if (Emitter.direction_type == DIRECTION_TYPE_OUTWARD)
+            direction = normalize(position - Emitter.position);
+
+        float initial_speed = Emitter.min_initial_speed + (Emitter.max_initial_speed - Emitter.min_initial_speed) * emission_rand(index, Emitter.seeds.xzy, 3);
+        float lifetime      = Emitter.min_lifetime + (Emitter.max_lifetime - Emitter.min_lifetime) * emission_rand(index, Emitter.seeds.yxz * 0.5, 6);
+        float rotation      = Emitter.rotation + Emitter.rotation_variance * (emission_rand(index, Emitter.seeds.yxz, 4) * 2.0 - 1.0);
+        float spin          = mix(Emitter.min_angular_velocity, Emitter.max_angular_velocity, emission_rand(index, Emitter.seeds.zxy, 5));
+        float trail_tag     = allocate_trail_slot();
+
+        ParticleData.particles[particle_index].position     = vec4(position, trail_tag);
+        ParticleData.particles[particle_index].velocity     = vec4(direction * initial_speed, spin);
+        // A frozen catch up emits the whole backlog in one step. Birth times are spread evenly over the skipped interval
+        // by starting each particle that far in the past of the step, so the backlog reads as continuous emission.
+        float birth = Emitter.analytic_step == 1 ? -Emitter.delta_time * (float(index) + 0.5) / float(Counters.emission_count) : 0.0;
 
-        if (u_DirectionType == DIRECTION_TYPE_OUTWARD)
-            direction = normalize(position - u_Position);
+        ParticleData.particles[particle_index].lifetime     = vec4(birth, lifetime, 0.0, rotation);
 
-        float initial_speed = u_MinInitialSpeed + (u_MaxInitialSpeed - u_MinInitialSpeed) * rand(u_Seeds.xzy / (index + 1));
-        float lifetime      = u_MinLifetime + (u_MaxLifetime - u_MinLifetime) * rand(u_Seeds.zyx / (index + 1));
+        // Start the trail collapsed on the spawn point so it doesn't inherit the slot's previous owner's.
+        uint trail = trail_slot(vec4(position, trail_tag));
 
-        ParticleData.particles[particle_index].position.xyz = position;
-        ParticleData.particles[particle_index].velocity.xyz = direction * initial_speed;
-        ParticleData.particles[particle_index].lifetime.xy  = vec2(0.0, lifetime);
+        if (trail != TRAIL_SLOT_NONE)
+        {
+            for (int i = 0; i < Emitter.trail_length; i++)
+                TrailHistory.points[trail * Emitter.trail_length + i] = vec4(position, 0.0);
+        }
 
-        push_alive_index(particle_index);
+        if (Emitter.deterministic == 0)
+            push_alive_index(particle_index);
     }
 }
\ No newline at end of file
@@ -1,21 +1,56 @@
+// ------------------------------------------------------------------
+// CONSTANTS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Particles are depth tested without blending, so sprite alpha cuts the quad out instead. depth_fs.glsl uses the same cutoff
+#define SPRITE_ALPHA_CUTOFF 0.25
+
 // ------------------------------------------------------------------
 // INPUTS -----------------------------------------------------------
 // ------------------------------------------------------------------
 
 in vec4 FS_IN_Color;
 
+#if defined(SPRITE_ATLAS)
+in vec3  FS_IN_TexCoord0;
+in vec3  FS_IN_TexCoord1;
+in float FS_IN_FrameBlend;
+#endif
+
 // ------------------------------------------------------------------
 // OUTPUTS ----------------------------------------------------------
 // ------------------------------------------------------------------
 
 out vec4 FS_OUT_FragColor;
 
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#if defined(SPRITE_ATLAS)
+layout(binding = 1) uniform sampler2DArray s_SpriteAtlas;
+#endif
+
 // ------------------------------------------------------------------
 // MAIN -------------------------------------------------------------
 // ------------------------------------------------------------------
 
 void main()
 {
+#if defined(SPRITE_ATLAS)
+    // The layer is constant across a quad, so every fragment of it takes the same branch
+    if (FS_IN_TexCoord0.z >= 0.0)
+    {
+        vec4 sprite = mix(texture(s_SpriteAtlas, FS_IN_TexCoord0), texture(s_SpriteAtlas, FS_IN_TexCoord1), FS_IN_FrameBlend);
+
+        if (sprite.a < SPRITE_ALPHA_CUTOFF)
+            discard;
+
+        FS_OUT_FragColor = FS_IN_Color * sprite;
+        return;
+    }
+#endif
+
     FS_OUT_FragColor = FS_IN_Color;
 }
 
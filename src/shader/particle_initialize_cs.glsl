@@ -2,7 +2,9 @@
 // CONSTANTS ---------------------------------------------------------
 // ------------------------------------------------------------------
 
+#ifndef LOCAL_SIZE
 #define LOCAL_SIZE 32
+#endif
 
 // ------------------------------------------------------------------
 // INPUTS -----------------------------------------------------------
@@ -14,13 +16,13 @@ layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
 // UNIFORMS ---------------------------------------------------------
 // ------------------------------------------------------------------
 
-layout(std430, binding = 0) buffer ParticleDeadIndices_t
+layout(std430, binding = 1) buffer ParticleDeadIndices_t
 {
     uint indices[];
 }
 DeadIndices;
 
-layout(std430, binding = 1) buffer ParticleCounters_t
+layout(std430, binding = 2) buffer ParticleCounters_t
 {
     uint dead_count;
     uint alive_count[2];
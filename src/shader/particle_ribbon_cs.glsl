@@ -0,0 +1,138 @@
+#include <uniforms.glsl>
+#include <trails.glsl>
+
+// ------------------------------------------------------------------
+// CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#ifndef LOCAL_SIZE
+#define LOCAL_SIZE 32
+#endif
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#include <curves.glsl>
+
+struct Particle
+{
+    vec4 lifetime;
+    vec4 velocity;
+    vec4 position;
+    vec4 orientation;
+};
+
+struct RibbonVertex
+{
+    vec4 position;
+    vec4 color;
+};
+
+layout(std430, binding = 0) buffer ParticleData_t
+{
+    Particle particles[];
+}
+ParticleData;
+
+layout(std430, binding = SSBO_BINDING_ALIVE_POST_SIM) buffer ParticleAlivePostSimIndices_t
+{
+    uint indices[];
+}
+AliveIndicesPostSim;
+
+layout(std430, binding = 3) buffer ParticleDrawArgs_t
+{
+    uint count;
+    uint instance_count;
+    uint first;
+    uint base_instance;
+}
+ParticleDrawArgs;
+
+layout(std430, binding = SSBO_BINDING_TRAIL_HISTORY) buffer TrailHistory_t
+{
+    vec4 points[];
+}
+TrailHistory;
+
+layout(std430, binding = SSBO_BINDING_RIBBON_VERTICES) buffer RibbonVertices_t
+{
+    RibbonVertex vertices[];
+}
+RibbonVertices;
+
+layout(std430, binding = SSBO_BINDING_RIBBON_DRAW_ARGS) buffer RibbonDrawArgs_t
+{
+    uint count;
+    uint instance_count;
+    uint first;
+    uint base_instance;
+}
+RibbonDrawArgs;
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Point k of the trail, 0 being the newest.
+vec3 trail_point(uint trail, int k)
+{
+    int slot = (Emitter.trail_head - k + Emitter.trail_length) % Emitter.trail_length;
+
+    return TrailHistory.points[trail * Emitter.trail_length + slot].xyz;
+}
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+
+    if (index < ParticleDrawArgs.instance_count)
+    {
+        uint particle_index = AliveIndicesPostSim.indices[index];
+
+        Particle particle = ParticleData.particles[particle_index];
+        uint     trail    = trail_slot(particle.position);
+
+        // Only particles that got a trail slot when they were emitted own a history.
+        if (trail == TRAIL_SLOT_NONE)
+            return;
+
+        uint  ribbon = atomicAdd(RibbonDrawArgs.instance_count, 1);
+        uint  base   = ribbon * Emitter.trail_length * 2;
+        float life   = particle.lifetime.x / particle.lifetime.y;
+        vec4  color  = color_over_time(life);
+        float width  = size_over_time(life) * Emitter.trail_width;
+
+        for (int k = 0; k < Emitter.trail_length; k++)
+        {
+            vec3 point = trail_point(trail, k);
+            vec3 newer = trail_point(trail, max(k - 1, 0));
+            vec3 older = trail_point(trail, min(k + 1, Emitter.trail_length - 1));
+
+            // Camera facing strip, tapering towards the tail.
+            vec3  side     = cross(newer - older, View.position.xyz - point);
+            float side_len = length(side);
+            float taper    = 1.0 - float(k) / float(max(Emitter.trail_length - 1, 1));
+
+            side = side_len > 1e-6 ? side / side_len * width * taper : vec3(0.0);
+
+            RibbonVertices.vertices[base + k * 2].position     = vec4(point + side, 1.0);
+            RibbonVertices.vertices[base + k * 2].color        = vec4(color.rgb, color.a * taper);
+            RibbonVertices.vertices[base + k * 2 + 1].position = vec4(point - side, 1.0);
+            RibbonVertices.vertices[base + k * 2 + 1].color    = vec4(color.rgb, color.a * taper);
+        }
+    }
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include <uniforms.glsl>
+
+// ------------------------------------------------------------------
+// OUTPUTS ----------------------------------------------------------
+// ------------------------------------------------------------------
+
+out vec4 FS_IN_Color;
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+struct RibbonVertex
+{
+    vec4 position;
+    vec4 color;
+};
+
+layout(std430, binding = SSBO_BINDING_RIBBON_VERTICES) buffer RibbonVertices_t
+{
+    RibbonVertex vertices[];
+}
+RibbonVertices;
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    // One triangle strip instance per ribbon, laid out back to back by particle_ribbon_cs.glsl.
+    RibbonVertex vertex = RibbonVertices.vertices[gl_InstanceID * Emitter.trail_length * 2 + gl_VertexID];
+
+    FS_IN_Color = vertex.color;
+    gl_Position = View.view_proj * vertex.position;
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
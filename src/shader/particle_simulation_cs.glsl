@@ -1,13 +1,23 @@
 #include <curl_noise.glsl>
+#include <uniforms.glsl>
+#include <forces.glsl>
+#include <bvh.glsl>
+#include <billboards.glsl>
+#include <trails.glsl>
 
 // ------------------------------------------------------------------
 // CONSTANTS ---------------------------------------------------------
 // ------------------------------------------------------------------
 
+#ifndef LOCAL_SIZE
 #define LOCAL_SIZE 32
+#endif
 #define CAMERA_NEAR_PLANE 0.1
 #define CAMERA_FAR_PLANE 1000.0
 #define MIN_THICKNESS 0.001
+#define SUB_EMITTER_MAX_EVENTS 131072 // Must match main.cpp
+#define SUB_EMITTER_ON_DEATH 1
+#define SUB_EMITTER_ON_COLLISION 2
 
 // ------------------------------------------------------------------
 // INPUTS -----------------------------------------------------------
@@ -23,10 +33,17 @@ struct Particle
 {
     vec4 lifetime;
     vec4 velocity;
+    vec4 position;    // w is the trail slot, see trails.glsl
+    vec4 orientation; // Billboard basis, written by particle_billboard_cs.glsl
+};
+
+struct SubEmitterEvent
+{
     vec4 position;
-    vec4 color;
+    vec4 velocity;
 };
 
+// Bindings below 16 belong to the particle pool and are bound once at startup, the pass binds the rest.
 layout(std430, binding = 0) buffer ParticleData_t
 {
     Particle particles[];
@@ -39,19 +56,19 @@ layout(std430, binding = 1) buffer ParticleDeadIndices_t
 }
 DeadIndices;
 
-layout(std430, binding = 2) buffer ParticleAlivePreSimIndices_t
+layout(std430, binding = SSBO_BINDING_ALIVE_PRE_SIM) buffer ParticleAlivePreSimIndices_t
 {
     uint indices[];
 }
 AliveIndicesPreSim;
 
-layout(std430, binding = 3) buffer ParticleAlivePostSimIndices_t
+layout(std430, binding = SSBO_BINDING_ALIVE_POST_SIM) buffer ParticleAlivePostSimIndices_t
 {
     uint indices[];
 }
 AliveIndicesPostSim;
 
-layout(std430, binding = 4) buffer ParticleDrawArgs_t
+layout(std430, binding = 3) buffer ParticleDrawArgs_t
 {
     uint count;
     uint instance_count;
@@ -60,27 +77,47 @@ layout(std430, binding = 4) buffer ParticleDrawArgs_t
 }
 ParticleDrawArgs;
 
-layout(std430, binding = 5) buffer ParticleCounters_t
+layout(std430, binding = 2) buffer ParticleCounters_t
 {
     uint dead_count;
     uint alive_count[2];
     uint simulation_count;
     uint emission_count;
+    uint substep_count;
 }
 Counters;
 
-uniform mat4 u_ViewProj;
-uniform float u_DeltaTime;
-uniform int   u_PreSimIdx;
-uniform int   u_PostSimIdx;
-uniform float u_Viscosity;
-uniform float u_Restitution;
-uniform vec3  u_ConstantVelocity;
-uniform int   u_AffectedByGravity;
-uniform int   u_DepthBufferCollision;
+layout(std430, binding = 4) buffer ParticleAliveFlags_t
+{
+    uint flags[];
+}
+AliveFlags;
 
-uniform sampler2D s_Depth;
-uniform sampler2D s_Normals;
+layout(std430, binding = SSBO_BINDING_TRAIL_HISTORY) buffer TrailHistory_t
+{
+    vec4 points[];
+}
+TrailHistory;
+
+layout(std430, binding = 8) buffer SubEmitterQueue_t
+{
+    uint count;
+    uint spawn_count;
+    uint event_count;
+    uint dropped;
+}
+SubEmitterQueue;
+
+layout(std430, binding = 9) buffer SubEmitterEvents_t
+{
+    SubEmitterEvent events[];
+}
+SubEmitterEvents;
+
+layout(binding = 0) uniform sampler2D s_Depth;
+layout(binding = 1) uniform sampler2D s_Normals;
+layout(binding = 3) uniform sampler2D s_PrevDepth;
+layout(binding = 4) uniform sampler2D s_PrevNormals;
 
 // ------------------------------------------------------------------
 // FUNCTIONS --------------------------------------------------------
@@ -100,16 +137,61 @@ uint pop_dead_index()
 
 void push_alive_index(uint index)
 {
-    uint insert_idx                         = atomicAdd(Counters.alive_count[u_PostSimIdx], 1);
+    uint insert_idx                         = atomicAdd(Counters.alive_count[Emitter.post_sim_idx], 1);
     AliveIndicesPostSim.indices[insert_idx] = index;
 }
 
 uint pop_alive_index()
 {
-    uint index = atomicAdd(Counters.alive_count[u_PreSimIdx], -1);
+    uint index = atomicAdd(Counters.alive_count[Emitter.pre_sim_idx], -1);
     return AliveIndicesPreSim.indices[index - 1];
 }
 
+// Deterministic mode leaves list building to the compaction pass: particles only mark their slot as alive
+// and the lists are rebuilt in slot order, independent of which thread got there first.
+uint fetch_particle_index(uint index)
+{
+    if (Emitter.deterministic == 1)
+        return AliveIndicesPreSim.indices[index];
+    else
+        return pop_alive_index();
+}
+
+void retire_particle(uint index, Particle particle)
+{
+    if (Emitter.deterministic == 0)
+        push_dead_index(index);
+
+    release_trail_slot(particle.position);
+}
+
+void keep_particle(uint index)
+{
+    if (Emitter.deterministic == 1)
+        AliveFlags.flags[index] = 1;
+    else
+    {
+        // Append index back into AliveIndices list
+        push_alive_index(index);
+
+        // Increment draw count
+        atomicAdd(ParticleDrawArgs.instance_count, 1);
+    }
+}
+
+// Appends an event for particle_sub_emission_cs.glsl to spawn children from. Children (lifetime.z != 0) never
+// raise events, so a burst can't feed itself. Events past the end of the queue are counted but not stored.
+void push_sub_emitter_event(Particle particle, int trigger)
+{
+    if ((Emitter.sub_emitter_trigger & trigger) == 0 || particle.lifetime.z != 0.0)
+        return;
+
+    uint insert_idx = atomicAdd(SubEmitterQueue.count, 1);
+
+    if (insert_idx < SUB_EMITTER_MAX_EVENTS)
+        SubEmitterEvents.events[insert_idx] = SubEmitterEvent(particle.position, particle.velocity);
+}
+
 float exp_01_to_linear_01_depth(float z, float n, float f)
 {
     float z_buffer_params_y = f / n;
@@ -118,6 +200,71 @@ float exp_01_to_linear_01_depth(float z, float n, float f)
     return 1.0 / (z_buffer_params_x * z + z_buffer_params_y);
 }
 
+// Linear depth of a world space point and of the scene behind it. False when it lies outside the view, guard band included.
+bool project_depths(vec3 position, mat4 view_proj, sampler2D depth, out float particle_depth, out float scene_depth, out vec2 tex_coord)
+{
+    vec4 clip = view_proj * vec4(position, 1.0);
+
+    if (clip.w <= 0.0)
+        return false;
+
+    clip.xyz /= clip.w;
+    tex_coord = clip.xy * 0.5 + vec2(0.5);
+
+    particle_depth = exp_01_to_linear_01_depth(clip.z * 0.5 + 0.5, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+    scene_depth    = exp_01_to_linear_01_depth(texture(depth, tex_coord).r, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+
+    return all(greaterThanEqual(tex_coord, vec2(0.0))) && all(lessThanEqual(tex_coord, vec2(1.0)));
+}
+
+// Tests the segment a particle covers in one substep against the depth buffer. A hit is a segment that starts in
+// front of the surface and ends behind it, so the thickness accepted grows with the depth the segment spans rather
+// than being fixed at MIN_THICKNESS. Returns the fraction of the segment at the surface.
+bool swept_collision(vec3 start, vec3 end, mat4 view_proj, sampler2D depth, sampler2D normals, out float t, out vec3 surface_normal)
+{
+    float start_depth, start_scene, end_depth, end_scene;
+    vec2  start_coord, end_coord;
+
+    if (!project_depths(start, view_proj, depth, start_depth, start_scene, start_coord) || !project_depths(end, view_proj, depth, end_depth, end_scene, end_coord))
+        return false;
+
+    // Ends in front of the surface, or started hidden behind it
+    if (end_depth <= end_scene || start_depth > start_scene + MIN_THICKNESS)
+        return false;
+
+    // Passing behind a foreground object rather than through it
+    if (end_depth - end_scene > max(end_depth - start_depth, MIN_THICKNESS))
+        return false;
+
+    t = clamp((start_scene - start_depth) / max((end_depth - start_depth) - (end_scene - start_scene), 1e-6), 0.0, 1.0);
+
+    surface_normal = normalize(texture(normals, mix(start_coord, end_coord, t)).rgb);
+
+    return true;
+}
+
+// Falls back to last frame's buffers when this frame's don't see a hit: a particle that just left the view or went
+// behind a foreground object is often still covered there. The scene is static, so surfaces found in the old view
+// are still where they were and reprojecting the segment with the old matrix is exact.
+bool depth_collision(vec3 start, vec3 end, out float t, out vec3 surface_normal)
+{
+    if (swept_collision(start, end, Global.collision_view_proj, s_Depth, s_Normals, t, surface_normal))
+        return true;
+
+    return Global.collision_reprojection == 1 && swept_collision(start, end, Global.prev_collision_view_proj, s_PrevDepth, s_PrevNormals, t, surface_normal);
+}
+
+// Substeps are sized so a particle moves at most substep_distance per substep.
+int substep_count(vec3 velocity)
+{
+    if (Emitter.adaptive_substeps == 0)
+        return Emitter.max_substeps;
+
+    float travel = length(velocity) * Emitter.delta_time;
+
+    return clamp(int(ceil(travel / Emitter.substep_distance)), 1, Emitter.max_substeps);
+}
+
 
 // ------------------------------------------------------------------
 // MAIN -------------------------------------------------------------
@@ -130,7 +277,7 @@ void main()
     if (index < Counters.simulation_count)
     {
         // Consume an Alive particle index
-        uint particle_index = pop_alive_index();
+        uint particle_index = fetch_particle_index(index);
 
         Particle particle = ParticleData.particles[particle_index];
 
@@ -138,47 +285,92 @@ void main()
         if (particle.lifetime.x >= particle.lifetime.y)
         {
             // If dead, just append into the DeadIndices list
-            push_dead_index(particle_index);
+            retire_particle(particle_index, particle);
+            push_sub_emitter_event(particle, SUB_EMITTER_ON_DEATH);
         }
         else
         {
             // If still alive, increment lifetime and run simulation
-            particle.lifetime.x += u_DeltaTime;
+            particle.lifetime.x += Emitter.delta_time;
 
-            if (u_AffectedByGravity == 1)
-                particle.velocity.xyz += vec3(0.0, -9.8, 0.0) * u_DeltaTime;
-
-            if (u_DepthBufferCollision == 1)
+            if (Emitter.analytic_step == 1)
             {
-                vec4 position = u_ViewProj * vec4(particle.position.xyz, 1.0);
-                position.xyz /= position.w;
+                // Catching up after the emitter was frozen: a closed form ballistic step stays stable for any
+                // delta time. Collisions and curl noise are skipped since the frames in between were never seen.
+                // Particles emitted by the catch up were born part way through the interval and only age that long.
+                vec3  gravity = Emitter.affected_by_gravity == 1 ? vec3(0.0, -9.8, 0.0) : vec3(0.0);
+                float dt      = min(Emitter.delta_time, particle.lifetime.x);
 
-                vec2 tex_coord = position.xy * 0.5 + vec2(0.5);
+                particle.position.xyz += (particle.velocity.xyz + Emitter.constant_velocity) * dt + 0.5 * gravity * dt * dt;
+                particle.velocity.xyz += gravity * dt;
 
-                vec3 surface_normal = normalize(texture(s_Normals, tex_coord).rgb);
+                // Particles that expired during the gap must not be drawn for a frame.
+                if (particle.lifetime.x >= particle.lifetime.y)
+                {
+                    retire_particle(particle_index, particle);
+                    push_sub_emitter_event(particle, SUB_EMITTER_ON_DEATH);
+                    return;
+                }
+            }
+            else
+            {
+                int   substeps = substep_count(particle.velocity.xyz + Emitter.constant_velocity);
+                float dt       = Emitter.delta_time / float(substeps);
 
-                float g_buffer_depth = exp_01_to_linear_01_depth(texture(s_Depth, tex_coord).r, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
-                float particle_depth = exp_01_to_linear_01_depth(position.z * 0.5 + 0.5, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+                if (Emitter.measure_substeps == 1)
+                    atomicAdd(Counters.substep_count, substeps);
 
-                if ((particle_depth > g_buffer_depth) && (particle_depth - g_buffer_depth) < MIN_THICKNESS)
+                // All substeps run here so the particle stays in registers between them.
+                for (int i = 0; i < substeps; i++)
                 {
-                    if (dot(particle.velocity.xyz, surface_normal) < 0.0)
-                        particle.velocity.xyz = reflect(particle.velocity.xyz, surface_normal) * u_Restitution; 
-                } 
+                    if (Emitter.affected_by_gravity == 1)
+                        particle.velocity.xyz += vec3(0.0, -9.8, 0.0) * dt;
+
+                    if (Global.force_count > 0)
+                        particle.velocity.xyz += evaluate_forces(particle.position.xyz, particle.velocity.xyz) * dt;
+
+                    if (Emitter.viscosity != 0.0)
+                        particle.velocity.xyz += (curl_noise(particle.position.xyz) - particle.velocity.xyz) * Emitter.viscosity * dt;
+
+                    vec3 next_position = particle.position.xyz + (particle.velocity.xyz + Emitter.constant_velocity) * dt;
+
+                    float t;
+                    vec3  surface_normal;
+
+                    // The scene BVH sees geometry the depth buffer doesn't (off screen, hidden or behind the particle), so it wins when enabled.
+                    bool collided = false;
+
+                    if (Emitter.mesh_collision == 1 && Global.bvh_node_count > 0)
+                        collided = intersect_bvh(particle.position.xyz, next_position - particle.position.xyz, 1.0, t, surface_normal);
+                    else if (Emitter.depth_buffer_collision == 1)
+                        collided = depth_collision(particle.position.xyz, next_position, t, surface_normal);
+
+                    if (collided)
+                    {
+                        // Stop at the surface for the rest of the substep
+                        particle.position.xyz = mix(particle.position.xyz, next_position, t) + surface_normal * MIN_THICKNESS;
+
+                        if (dot(particle.velocity.xyz, surface_normal) < 0.0)
+                        {
+                            push_sub_emitter_event(particle, SUB_EMITTER_ON_COLLISION);
+                            particle.velocity.xyz = reflect(particle.velocity.xyz, surface_normal) * Emitter.restitution;
+                        }
+                    }
+                    else
+                        particle.position.xyz = next_position;
+                }
             }
 
-            if (u_Viscosity != 0.0)
-                particle.velocity.xyz += (curl_noise(particle.position.xyz) - particle.velocity.xyz) * u_Viscosity * u_DeltaTime;
+            uint trail = trail_slot(particle.position);
 
-            particle.position.xyz += (particle.velocity.xyz + u_ConstantVelocity) * u_DeltaTime;
+            if (trail != TRAIL_SLOT_NONE)
+                TrailHistory.points[trail * Emitter.trail_length + Emitter.trail_head] = vec4(particle.position.xyz, particle.lifetime.x);
 
-            ParticleData.particles[particle_index] = particle;
+            particle.lifetime.w = integrate_rotation(particle.lifetime, particle.velocity, Emitter.delta_time);
 
-            // Append index back into AliveIndices list
-            push_alive_index(particle_index);
+            ParticleData.particles[particle_index] = particle;
 
-            // Increment draw count
-            atomicAdd(ParticleDrawArgs.instance_count, 1);
+            keep_particle(particle_index);
         }
     }
 }
\ No newline at end of file
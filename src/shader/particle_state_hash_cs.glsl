@@ -0,0 +1,101 @@
+#include <random.glsl>
+#include <uniforms.glsl>
+
+// ------------------------------------------------------------------
+// CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#ifndef LOCAL_SIZE
+#define LOCAL_SIZE 32
+#endif
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+struct Particle
+{
+    vec4 lifetime;
+    vec4 velocity;
+    vec4 position;
+    vec4 orientation;
+};
+
+layout(std430, binding = 0) buffer ParticleData_t
+{
+    Particle particles[];
+}
+ParticleData;
+
+layout(std430, binding = SSBO_BINDING_ALIVE_POST_SIM) buffer ParticleAlivePostSimIndices_t
+{
+    uint indices[];
+}
+AliveIndicesPostSim;
+
+layout(std430, binding = 2) buffer ParticleCounters_t
+{
+    uint dead_count;
+    uint alive_count[2];
+    uint simulation_count;
+    uint emission_count;
+}
+Counters;
+
+layout(std430, binding = 11) buffer StateHash_t
+{
+    uint sum;
+    uint mix;
+}
+StateHash;
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+uint hash_combine(uint seed, uint value)
+{
+    return pcg_hash(seed ^ value);
+}
+
+uint hash_combine(uint seed, vec3 value)
+{
+    seed = hash_combine(seed, floatBitsToUint(value.x));
+    seed = hash_combine(seed, floatBitsToUint(value.y));
+    return hash_combine(seed, floatBitsToUint(value.z));
+}
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+
+    if (index < Counters.alive_count[Emitter.post_sim_idx])
+    {
+        uint     particle_index = AliveIndicesPostSim.indices[index];
+        Particle particle       = ParticleData.particles[particle_index];
+
+        // The list position is part of the key so that a reordered alive list changes the hash too. The step index
+        // is as well, since every step adds into the same running hash.
+        uint h = hash_combine(pcg_hash(index ^ pcg_hash(Emitter.step_index)), particle_index);
+        h      = hash_combine(h, floatBitsToUint(particle.lifetime.x));
+        h      = hash_combine(h, floatBitsToUint(particle.lifetime.y));
+        h      = hash_combine(h, particle.velocity.xyz);
+        h      = hash_combine(h, particle.position.xyz);
+
+        // Both reductions are order independent, so the result doesn't depend on scheduling.
+        atomicAdd(StateHash.sum, h);
+        atomicXor(StateHash.mix, pcg_hash(h));
+    }
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include <random.glsl>
+#include <uniforms.glsl>
+#include <trails.glsl>
+
+// ------------------------------------------------------------------
+// CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+// One of SUB_EMISSION_PASS_KICKOFF or SUB_EMISSION_PASS_SPAWN is defined at compile time.
+#ifndef LOCAL_SIZE
+#define LOCAL_SIZE 32
+#endif
+#ifndef SIMULATION_LOCAL_SIZE
+#define SIMULATION_LOCAL_SIZE 32 // The kickoff grows the simulation's dispatch arguments
+#endif
+#define SUB_EMITTER_MAX_EVENTS 131072 // Must match main.cpp
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+#if defined(SUB_EMISSION_PASS_KICKOFF)
+layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+#else
+layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
+#endif
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+struct Particle
+{
+    vec4 lifetime;
+    vec4 velocity;
+    vec4 position;
+    vec4 orientation;
+};
+
+struct SubEmitterEvent
+{
+    vec4 position;
+    vec4 velocity;
+};
+
+layout(std430, binding = 0) buffer ParticleData_t
+{
+    Particle particles[];
+}
+ParticleData;
+
+layout(std430, binding = 1) buffer ParticleDeadIndices_t
+{
+    uint indices[];
+}
+DeadIndices;
+
+layout(std430, binding = SSBO_BINDING_ALIVE_POST_SIM) buffer ParticleAlivePostSimIndices_t
+{
+    uint indices[];
+}
+AliveIndicesPostSim;
+
+layout(std430, binding = 2) buffer ParticleCounters_t
+{
+    uint dead_count;
+    uint alive_count[2];
+    uint simulation_count;
+    uint emission_count;
+}
+Counters;
+
+layout(std430, binding = 3) buffer ParticleDrawArgs_t
+{
+    uint count;
+    uint instance_count;
+    uint first;
+    uint base_instance;
+}
+ParticleDrawArgs;
+
+layout(std430, binding = 8) buffer SubEmitterQueue_t
+{
+    uint count;       // Appended by the simulation pass, may run past SUB_EMITTER_MAX_EVENTS
+    uint spawn_count; // Children to spawn, clamped by the kickoff
+    uint event_count; // Events consumed by the last step, for the counter readback
+    uint dropped;     // Events lost to a full queue since startup
+}
+SubEmitterQueue;
+
+layout(std430, binding = 9) buffer SubEmitterEvents_t
+{
+    SubEmitterEvent events[];
+}
+SubEmitterEvents;
+
+layout(std430, binding = 7) buffer SubEmissionDispatchArgs_t
+{
+    uint num_groups_x;
+    uint num_groups_y;
+    uint num_groups_z;
+}
+SubEmissionDispatchArgs;
+
+layout(std430, binding = 6) buffer SimulationDispatchArgs_t
+{
+    uint num_groups_x;
+    uint num_groups_y;
+    uint num_groups_z;
+}
+SimulationDispatchArgs;
+
+layout(std430, binding = SSBO_BINDING_TRAIL_HISTORY) buffer TrailHistory_t
+{
+    vec4 points[];
+}
+TrailHistory;
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+#if defined(SUB_EMISSION_PASS_KICKOFF)
+
+void main()
+{
+    uint events = min(SubEmitterQueue.count, SUB_EMITTER_MAX_EVENTS);
+
+    SubEmitterQueue.dropped += SubEmitterQueue.count - events;
+    SubEmitterQueue.event_count = events;
+    SubEmitterQueue.count       = 0;
+
+    // Children come out of the same pool and quota as regular emission
+    uint quota_room = uint(max(Emitter.particle_quota - int(Counters.alive_count[Emitter.post_sim_idx]), 0));
+
+    SubEmitterQueue.spawn_count = min(min(events * uint(Emitter.sub_emitter_children), Counters.dead_count), quota_room);
+
+    SubEmissionDispatchArgs.num_groups_x = uint(ceil(float(SubEmitterQueue.spawn_count) / float(LOCAL_SIZE)));
+    SubEmissionDispatchArgs.num_groups_y = 1;
+    SubEmissionDispatchArgs.num_groups_z = 1;
+
+    // Passes after the simulation reuse its dispatch to walk the post simulation alive list, which now grows by the children
+    uint alive_groups = uint(ceil(float(Counters.alive_count[Emitter.post_sim_idx] + SubEmitterQueue.spawn_count) / float(SIMULATION_LOCAL_SIZE)));
+
+    SimulationDispatchArgs.num_groups_x = max(SimulationDispatchArgs.num_groups_x, alive_groups);
+}
+
+#else
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+
+    if (index < SubEmitterQueue.spawn_count)
+    {
+        SubEmitterEvent event = SubEmitterEvents.events[index / uint(Emitter.sub_emitter_children)];
+
+        uint particle_index = DeadIndices.indices[atomicAdd(Counters.dead_count, -1) - 1];
+        uint stream         = floatBitsToUint(Emitter.seeds.x) ^ Emitter.step_index; // Seeds change every frame
+
+        vec3  direction = randomPointOnSphere(counter_rand(index, stream), counter_rand(index, stream + 1u), 1.0);
+        float speed     = Emitter.sub_emitter_speed * (0.5 + 0.5 * counter_rand(index, stream + 2u));
+        float lifetime  = Emitter.sub_emitter_lifetime * (0.5 + 0.5 * counter_rand(index, stream + 3u));
+        float rotation  = Emitter.rotation + Emitter.rotation_variance * (counter_rand(index, stream + 4u) * 2.0 - 1.0);
+        float spin      = mix(Emitter.min_angular_velocity, Emitter.max_angular_velocity, counter_rand(index, stream + 5u));
+
+        // lifetime.z marks the particle as a child so it doesn't raise events of its own
+        vec4 child_lifetime = vec4(0.0, lifetime, 1.0, rotation);
+        vec4 child_velocity = vec4(event.velocity.xyz * Emitter.sub_emitter_inherit + direction * speed, spin);
+        vec4 child_position = vec4(event.position.xyz, allocate_trail_slot());
+
+        ParticleData.particles[particle_index].lifetime     = child_lifetime;
+        ParticleData.particles[particle_index].velocity     = child_velocity;
+        ParticleData.particles[particle_index].position     = child_position;
+
+        uint trail = trail_slot(child_position);
+
+        if (trail != TRAIL_SLOT_NONE)
+        {
+            for (int i = 0; i < Emitter.trail_length; i++)
+                TrailHistory.points[trail * Emitter.trail_length + i] = vec4(event.position.xyz, 0.0);
+        }
+
+        // Children join the list that is drawn this frame and simulated next step
+        uint insert_idx                         = atomicAdd(Counters.alive_count[Emitter.post_sim_idx], 1);
+        AliveIndicesPostSim.indices[insert_idx] = particle_index;
+
+        atomicAdd(ParticleDrawArgs.instance_count, 1);
+    }
+}
+
+#endif
+
+// ------------------------------------------------------------------
\ No newline at end of file
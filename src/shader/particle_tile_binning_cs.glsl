@@ -0,0 +1,140 @@
+#include <uniforms.glsl>
+
+// ------------------------------------------------------------------
+// CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#ifndef LOCAL_SIZE
+#define LOCAL_SIZE 32
+#endif
+#define TILE_SIZE 16
+#define TILE_MAX_PARTICLES 512
+#define TILE_MAX_RADIUS 128.0
+#define CAMERA_FAR_PLANE 1000.0
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+struct Particle
+{
+    vec4 lifetime;
+    vec4 velocity;
+    vec4 position;
+    vec4 orientation;
+};
+
+struct ScreenParticle
+{
+    vec4 position; // xy: center in pixels, z: radius in pixels, w: linear depth
+    vec4 color;
+};
+
+layout(std430, binding = 0) buffer ParticleData_t
+{
+    Particle particles[];
+}
+ParticleData;
+
+layout(std430, binding = SSBO_BINDING_ALIVE_POST_SIM) buffer ParticleAlivePostSimIndices_t
+{
+    uint indices[];
+}
+AliveIndicesPostSim;
+
+layout(std430, binding = 3) buffer ParticleDrawArgs_t
+{
+    uint count;
+    uint instance_count;
+    uint first;
+    uint base_instance;
+}
+ParticleDrawArgs;
+
+layout(std430, binding = SSBO_BINDING_SCREEN_PARTICLES) buffer ScreenParticles_t
+{
+    ScreenParticle particles[];
+}
+ScreenParticles;
+
+layout(std430, binding = SSBO_BINDING_TILE_COUNTS) buffer TileCounts_t
+{
+    uint visible_count;
+    uint counts[];
+}
+TileCounts;
+
+layout(std430, binding = SSBO_BINDING_TILE_INDICES) buffer TileIndices_t
+{
+    uint indices[];
+}
+TileIndices;
+
+#include <curves.glsl>
+#include <materials.glsl>
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+
+    if (index < ParticleDrawArgs.instance_count)
+    {
+        Particle     particle = ParticleData.particles[AliveIndicesPostSim.indices[index]];
+        DrawMaterial material = DrawMaterials.materials[particle_material(particle.lifetime)];
+
+        vec4 view_pos = View.view * vec4(particle.position.xyz, 1.0);
+
+        // Behind the camera
+        if (view_pos.z >= 0.0)
+            return;
+
+        float life = particle.lifetime.x / particle.lifetime.y;
+        float size = material_size(material, life);
+
+        vec4 clip_pos = View.proj * view_pos;
+        vec2 ndc      = clip_pos.xy / clip_pos.w;
+
+        vec2  center = (ndc * 0.5 + 0.5) * vec2(Global.particle_size);
+        float radius = min(size * View.proj[1][1] * 0.5 * float(Global.particle_size.y) / -view_pos.z, TILE_MAX_RADIUS);
+
+        ivec2 min_tile = ivec2(floor((center - radius) / float(TILE_SIZE)));
+        ivec2 max_tile = ivec2(floor((center + radius) / float(TILE_SIZE)));
+
+        // Entirely off-screen
+        if (any(greaterThanEqual(min_tile, Global.tile_count)) || any(lessThan(max_tile, ivec2(0))))
+            return;
+
+        min_tile = max(min_tile, ivec2(0));
+        max_tile = min(max_tile, Global.tile_count - 1);
+
+        uint screen_index = atomicAdd(TileCounts.visible_count, 1);
+
+        ScreenParticles.particles[screen_index].position = vec4(center, radius, -view_pos.z / CAMERA_FAR_PLANE);
+        ScreenParticles.particles[screen_index].color    = material_color(material, life);
+
+        for (int y = min_tile.y; y <= max_tile.y; y++)
+        {
+            for (int x = min_tile.x; x <= max_tile.x; x++)
+            {
+                uint tile_index = y * Global.tile_count.x + x;
+                uint insert_idx = atomicAdd(TileCounts.counts[tile_index], 1);
+
+                // Drop particles once a tile is full rather than overflowing into the next one
+                if (insert_idx < TILE_MAX_PARTICLES)
+                    TileIndices.indices[tile_index * TILE_MAX_PARTICLES + insert_idx] = screen_index;
+            }
+        }
+    }
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include <uniforms.glsl>
+
+// ------------------------------------------------------------------
+// CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#define TILE_SIZE 16
+#define TILE_PIXELS (TILE_SIZE * TILE_SIZE)
+#define TILE_MAX_PARTICLES 512
+#define CAMERA_NEAR_PLANE 0.1
+#define CAMERA_FAR_PLANE 1000.0
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_SIZE, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+struct ScreenParticle
+{
+    vec4 position; // xy: center in pixels, z: radius in pixels, w: linear depth
+    vec4 color;
+};
+
+layout(std430, binding = SSBO_BINDING_SCREEN_PARTICLES) buffer ScreenParticles_t
+{
+    ScreenParticle particles[];
+}
+ScreenParticles;
+
+layout(std430, binding = SSBO_BINDING_TILE_COUNTS) buffer TileCounts_t
+{
+    uint visible_count;
+    uint counts[];
+}
+TileCounts;
+
+layout(std430, binding = SSBO_BINDING_TILE_INDICES) buffer TileIndices_t
+{
+    uint indices[];
+}
+TileIndices;
+
+layout(binding = 0, rgba16f) uniform writeonly image2D i_Particles;
+
+layout(binding = 0) uniform sampler2D s_Depth;
+
+// ------------------------------------------------------------------
+// SHARED -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+shared vec4 g_Position[TILE_PIXELS];
+shared vec4 g_Color[TILE_PIXELS];
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+float exp_01_to_linear_01_depth(float z, float n, float f)
+{
+    float z_buffer_params_y = f / n;
+    float z_buffer_params_x = 1.0 - z_buffer_params_y;
+
+    return 1.0 / (z_buffer_params_x * z + z_buffer_params_y);
+}
+
+// ------------------------------------------------------------------
+
+// Weighted blended order independent transparency (McGuire and Bavoil 2013)
+float oit_weight(float linear_depth, float alpha)
+{
+    return clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - linear_depth * 0.9, 3.0), 1e-2, 3e3);
+}
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    ivec2 pixel      = ivec2(gl_GlobalInvocationID.xy);
+    uint  tile_index = gl_WorkGroupID.y * Global.tile_count.x + gl_WorkGroupID.x;
+    uint  count      = min(TileCounts.counts[tile_index], TILE_MAX_PARTICLES);
+    bool  on_screen  = all(lessThan(pixel, Global.particle_size));
+
+    // Uniform across the work group, so it is safe to leave before any barrier
+    if (count == 0)
+    {
+        if (on_screen)
+            imageStore(i_Particles, pixel, vec4(0.0));
+
+        return;
+    }
+
+    vec2  pixel_center = vec2(pixel) + vec2(0.5);
+    float scene_depth  = on_screen ? exp_01_to_linear_01_depth(texelFetch(s_Depth, pixel, 0).r, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE) : 0.0;
+
+    vec4  accumulation = vec4(0.0);
+    float revealage    = 1.0;
+
+    for (uint batch = 0; batch < count; batch += TILE_PIXELS)
+    {
+        // Cooperatively stage the next batch of this tile's particles in shared memory
+        uint load_index = batch + gl_LocalInvocationIndex;
+
+        if (load_index < count)
+        {
+            ScreenParticle particle = ScreenParticles.particles[TileIndices.indices[tile_index * TILE_MAX_PARTICLES + load_index]];
+
+            g_Position[gl_LocalInvocationIndex] = particle.position;
+            g_Color[gl_LocalInvocationIndex]    = particle.color;
+        }
+
+        barrier();
+
+        uint batch_count = min(count - batch, TILE_PIXELS);
+
+        for (uint i = 0; i < batch_count; i++)
+        {
+            vec4  position = g_Position[i];
+            float dist     = length(pixel_center - position.xy) / max(position.z, 0.5);
+
+            if (dist < 1.0 && position.w < scene_depth)
+            {
+                vec4 color = g_Color[i];
+
+                // Soft edge plus a fade as the sprite approaches the opaque scene behind it
+                float soft_fade = clamp((scene_depth - position.w) * CAMERA_FAR_PLANE / Global.soft_distance, 0.0, 1.0);
+                float alpha     = color.a * (1.0 - smoothstep(0.5, 1.0, dist)) * soft_fade;
+                float weight    = oit_weight(position.w, alpha);
+
+                accumulation += vec4(color.rgb * alpha, alpha) * weight;
+                revealage *= 1.0 - alpha;
+            }
+        }
+
+        barrier();
+    }
+
+    if (on_screen)
+    {
+        float coverage = 1.0 - revealage;
+        vec3  color    = accumulation.rgb / max(accumulation.a, 1e-5);
+
+        // Premultiplied so the composite is a single over blend
+        imageStore(i_Particles, pixel, vec4(color * coverage, coverage));
+    }
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
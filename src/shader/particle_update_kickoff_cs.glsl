@@ -1,8 +1,16 @@
+#include <uniforms.glsl>
+
 // ------------------------------------------------------------------
 // CONSTANTS ---------------------------------------------------------
 // ------------------------------------------------------------------
 
-#define LOCAL_SIZE 32
+// Workgroup sizes of the passes the dispatch arguments are written for, injected by main.cpp
+#ifndef EMISSION_LOCAL_SIZE
+#define EMISSION_LOCAL_SIZE 32
+#endif
+#ifndef SIMULATION_LOCAL_SIZE
+#define SIMULATION_LOCAL_SIZE 32
+#endif
 
 // ------------------------------------------------------------------
 // INPUTS -----------------------------------------------------------
@@ -19,7 +27,7 @@ struct Particle
     vec4 lifetime;
     vec4 velocity;
     vec4 position;
-    vec4 color;
+    vec4 orientation;
 };
 
 layout(std430, binding = 0) buffer ParticleData_t
@@ -28,7 +36,7 @@ layout(std430, binding = 0) buffer ParticleData_t
 }
 ParticleData;
 
-layout(std430, binding = 1) buffer EmissionDispatchArgs_t
+layout(std430, binding = 5) buffer EmissionDispatchArgs_t
 {
     uint num_groups_x;
     uint num_groups_y;
@@ -36,7 +44,7 @@ layout(std430, binding = 1) buffer EmissionDispatchArgs_t
 }
 EmissionDispatchArgs;
 
-layout(std430, binding = 2) buffer SimulationDispatchArgs_t
+layout(std430, binding = 6) buffer SimulationDispatchArgs_t
 {
     uint num_groups_x;
     uint num_groups_y;
@@ -53,19 +61,16 @@ layout(std430, binding = 3) buffer ParticleDrawArgs_t
 }
 ParticleDrawArgs;
 
-layout(std430, binding = 4) buffer ParticleCounters_t
+layout(std430, binding = 2) buffer ParticleCounters_t
 {
     uint dead_count;
     uint alive_count[2];
     uint simulation_count;
     uint emission_count;
+    uint substep_count;
 }
 Counters;
 
-uniform int u_ParticlesPerFrame;
-uniform int u_PreSimIdx;
-uniform int u_PostSimIdx;
-
 // ------------------------------------------------------------------
 // MAIN -------------------------------------------------------------
 // ------------------------------------------------------------------
@@ -78,20 +83,25 @@ void main()
     ParticleDrawArgs.first          = 0;
     ParticleDrawArgs.base_instance  = 0;
 
-    // We can't emit more particles than we have available
-    Counters.emission_count = min(uint(u_ParticlesPerFrame), Counters.dead_count);
+    // We can't emit more particles than we have available, nor grow past the quota from the budget manager
+    uint quota_room = uint(max(Emitter.particle_quota - int(Counters.alive_count[Emitter.pre_sim_idx]), 0));
 
-    EmissionDispatchArgs.num_groups_x = uint(ceil(float(Counters.emission_count) / float(LOCAL_SIZE)));
+    Counters.emission_count = min(min(uint(Emitter.particles_per_frame), Counters.dead_count), quota_room);
+
+    EmissionDispatchArgs.num_groups_x = uint(ceil(float(Counters.emission_count) / float(EMISSION_LOCAL_SIZE)));
     EmissionDispatchArgs.num_groups_y = 1;
     EmissionDispatchArgs.num_groups_z = 1;
 
     // Calculate total number of particles to simulate this frame
-    Counters.simulation_count = Counters.alive_count[u_PreSimIdx] + Counters.emission_count;
+    Counters.simulation_count = Counters.alive_count[Emitter.pre_sim_idx] + Counters.emission_count;
 
-    SimulationDispatchArgs.num_groups_x = uint(ceil(float(Counters.simulation_count) / float(LOCAL_SIZE)));
+    SimulationDispatchArgs.num_groups_x = uint(ceil(float(Counters.simulation_count) / float(SIMULATION_LOCAL_SIZE)));
     SimulationDispatchArgs.num_groups_y = 1;
     SimulationDispatchArgs.num_groups_z = 1;
 
     // Reset post sim alive index count
-    Counters.alive_count[u_PostSimIdx] = 0;
+    Counters.alive_count[Emitter.post_sim_idx] = 0;
+
+    // Substeps run by this step's simulation, counted when their cost is being measured
+    Counters.substep_count = 0;
 }
\ No newline at end of file
@@ -1,3 +1,9 @@
+#if defined(MULTI_DRAW)
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+
+#include <uniforms.glsl>
+
 // ------------------------------------------------------------------
 // CONSTANTS --------------------------------------------------------
 // ------------------------------------------------------------------
@@ -15,25 +21,25 @@ const vec3 PARTICLE_VERTICES[6] = vec3[](
 // OUTPUTS ----------------------------------------------------------
 // ------------------------------------------------------------------
 
-out vec4 FS_IN_Color;
+out vec4  FS_IN_Color;
+out vec3  FS_IN_TexCoord0; // Current flipbook frame, z is the atlas layer or -1 without a flipbook
+out vec3  FS_IN_TexCoord1; // Next flipbook frame
+out float FS_IN_FrameBlend;
 
 // ------------------------------------------------------------------
 // UNIFORMS ---------------------------------------------------------
 // ------------------------------------------------------------------
 
-uniform float u_Rotation;
-uniform mat4  u_View;
-uniform mat4  u_Proj;
-
-uniform sampler1D s_ColorOverTime;
-uniform sampler1D s_SizeOverTime;
+#include <curves.glsl>
+#include <materials.glsl>
+#include <sprites.glsl>
 
 struct Particle
 {
     vec4 lifetime;
     vec4 velocity;
     vec4 position;
-    vec4 color;
+    vec4 orientation; // Billboard basis, right in xy and up in zw
 };
 
 layout(std430, binding = 0) buffer ParticleData_t
@@ -42,12 +48,51 @@ layout(std430, binding = 0) buffer ParticleData_t
 }
 ParticleData;
 
-layout(std430, binding = 1) buffer ParticleIndices_t
+#if defined(MULTI_DRAW)
+struct DrawCommand
 {
     uint count;
+    uint instance_count;
+    uint first;
+    uint base_instance;
+};
+
+layout(std430, binding = 12) buffer DrawCommands_t
+{
+    uint        draw_count;
+    uint        padding[3];
+    DrawCommand commands[DRAW_MATERIAL_COUNT];
+    uint        materials[DRAW_MATERIAL_COUNT];
+}
+DrawCommands;
+
+layout(std430, binding = 13) buffer DrawIndices_t
+{
+    uint indices[];
+}
+DrawIndices;
+#else
+layout(std430, binding = SSBO_BINDING_ALIVE_POST_SIM) buffer ParticleIndices_t
+{
     uint indices[];
 }
 AliveIndicesPostSim;
+#endif
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+float hash_01(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+
+    return float(x) / 4294967295.0;
+}
 
 // ------------------------------------------------------------------
 // MAIN -------------------------------------------------------------
@@ -55,26 +100,59 @@ AliveIndicesPostSim;
 
 void main()
 {
-    Particle particle = ParticleData.particles[AliveIndicesPostSim.indices[gl_InstanceID]];
+#if defined(MULTI_DRAW)
+    // Every draw holds a single material, so the material fetch is uniform across the draw
+    uint         draw           = uint(gl_DrawIDARB);
+    uint         particle_index = DrawIndices.indices[DrawCommands.commands[draw].base_instance + gl_InstanceID];
+    Particle     particle       = ParticleData.particles[particle_index];
+    DrawMaterial material       = DrawMaterials.materials[DrawCommands.materials[draw]];
+#else
+    uint         particle_index = AliveIndicesPostSim.indices[gl_InstanceID];
+    Particle     particle       = ParticleData.particles[particle_index];
+    DrawMaterial material       = DrawMaterials.materials[particle_material(particle.lifetime)];
+#endif
+
+    // Keep a stable subset of particles, keyed on the particle slot so the selection doesn't flicker as the alive list reorders
+    if (hash_01(particle_index) > View.particle_fraction)
+    {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
 
     float life  = particle.lifetime.x / particle.lifetime.y;
-    float size  = texture(s_SizeOverTime, life).x;
-    FS_IN_Color = texture(s_ColorOverTime, life);
+    float size  = material_size(material, life);
+
+    // Grow the surviving subset to preserve the total covered area
+    size *= inversesqrt(View.particle_fraction);
+    FS_IN_Color = material_color(material, life);
+
+    // The flipbook plays over the particle's normalized age, neighbouring frames are cross faded so it doesn't step
+    if (material.frame_count > 0)
+    {
+        vec2  corner_uv = PARTICLE_VERTICES[gl_VertexID].xy * vec2(0.5, -0.5) + 0.5;
+        float frame     = clamp(life, 0.0, 1.0) * float(material.frame_count - 1);
+        int   current   = min(int(frame), material.frame_count - 1);
+
+        FS_IN_TexCoord0  = sprite_coord(material.first_frame + current, corner_uv);
+        FS_IN_TexCoord1  = sprite_coord(material.first_frame + min(current + 1, material.frame_count - 1), corner_uv);
+        FS_IN_FrameBlend = frame - float(current);
+    }
+    else
+    {
+        FS_IN_TexCoord0  = vec3(0.0, 0.0, -1.0);
+        FS_IN_TexCoord1  = vec3(0.0, 0.0, -1.0);
+        FS_IN_FrameBlend = 0.0;
+    }
 
     vec3 quad_pos = PARTICLE_VERTICES[gl_VertexID];
 
-    // rotate the billboard:
-    mat2 rot = mat2(cos(u_Rotation), -sin(u_Rotation), sin(u_Rotation), cos(u_Rotation));
-
-    quad_pos.xy = rot * quad_pos.xy;
-
-    // scale the quad
-    quad_pos.xy *= size;
+    // Rotation, stretch and alignment were folded into the basis by particle_billboard_cs.glsl, so every mode costs the same here
+    quad_pos.xy = (quad_pos.x * particle.orientation.xy + quad_pos.y * particle.orientation.zw) * size;
 
-    vec4 position = u_View * vec4(particle.position.xyz, 1.0);
+    vec4 position = View.view * vec4(particle.position.xyz, 1.0);
     position.xyz += quad_pos;
 
-    gl_Position = u_Proj * position;
+    gl_Position = View.proj * position;
 }
 
 // ------------------------------------------------------------------
\ No newline at end of file
@@ -4,6 +4,17 @@ float rand(vec3 co)
 {
     return fract(sin(dot(co.xyz, vec3(12.9898, 78.233, 45.5432))) * 43758.5453);
 }
+uint pcg_hash(uint value)
+{
+    uint state = value * 747796405u + 2891336453u;
+    uint word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+// Counter based: the same (counter, stream) pair yields the same number on every run, independent of scheduling.
+float counter_rand(uint counter, uint stream)
+{
+    return float(pcg_hash(counter ^ pcg_hash(stream)) >> 8u) / 16777216.0;
+}
 vec3 randomPointOnSphere(float u, float v, float radius)
 {
     float theta = 2 * PI * u;
@@ -0,0 +1,31 @@
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Frame rects inside the layers of the sprite atlas, built by sprite_atlas.cpp.
+struct SpriteFrame
+{
+    vec4 rect; // xy: UV offset, zw: UV scale
+    int  layer;
+    int  padding[3];
+};
+
+layout(std430, binding = 15) buffer SpriteFrames_t
+{
+    SpriteFrame frames[];
+}
+SpriteFrames;
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Atlas coordinate of a quad corner in [0, 1], with the layer in z.
+vec3 sprite_coord(int frame, vec2 uv)
+{
+    SpriteFrame sprite = SpriteFrames.frames[frame];
+
+    return vec3(sprite.rect.xy + uv * sprite.rect.zw, float(sprite.layer));
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,63 @@
+// ------------------------------------------------------------------
+// CONSTANTS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+#define TRAIL_SLOT_NONE 0xFFFFFFFFu
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Free trail history slots. A particle takes one when it is emitted and hands it back when it dies, so whether it
+// gets a trail doesn't depend on where the dead list placed it in the pool.
+layout(std430, binding = SSBO_BINDING_TRAIL_SLOTS) buffer TrailSlots_t
+{
+    uint count;
+    uint slots[];
+}
+TrailSlots;
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+// position.w holds generation * 65536 + slot as an exact float, or -1 without a trail. The generation changes
+// whenever the trail buffers are recreated, so particles alive across a resize simply go without a trail.
+uint trail_slot(vec4 position)
+{
+    if (Emitter.trail_particles == 0 || position.w < 0.0)
+        return TRAIL_SLOT_NONE;
+
+    uint tagged = uint(position.w);
+
+    return (tagged >> 16) == Emitter.trail_generation ? tagged & 0xFFFFu : TRAIL_SLOT_NONE;
+}
+
+// Returns the value to store in position.w.
+float allocate_trail_slot()
+{
+    if (Emitter.trail_particles == 0)
+        return -1.0;
+
+    uint count = atomicAdd(TrailSlots.count, -1);
+
+    // Out of slots: put the decrement back. Only successful pops lower the count for good, so a thread that
+    // sees a wrapped or zero count can never hand out a slot twice.
+    if (count == 0 || count > uint(Emitter.trail_particles))
+    {
+        atomicAdd(TrailSlots.count, 1);
+        return -1.0;
+    }
+
+    return float((Emitter.trail_generation << 16) | TrailSlots.slots[count - 1]);
+}
+
+void release_trail_slot(vec4 position)
+{
+    uint slot = trail_slot(position);
+
+    if (slot != TRAIL_SLOT_NONE)
+        TrailSlots.slots[atomicAdd(TrailSlots.count, 1)] = slot;
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,90 @@
+// ------------------------------------------------------------------
+// UNIFORM BUFFERS --------------------------------------------------
+// ------------------------------------------------------------------
+
+// Written once per frame.
+layout(std140, binding = 0) uniform GlobalUniforms_t
+{
+    mat4  light_view_proj;
+    mat4  collision_view_proj;      // Main camera widened by the collision guard band
+    mat4  prev_collision_view_proj;
+    mat4  camera_view;              // Main camera, billboards are oriented for it
+    vec4  light_direction;
+    vec4  light_color;
+    ivec2 screen_size;
+    ivec2 particle_size;
+    ivec2 tile_count;
+    int   particle_scale;
+    int   particle_upsample;
+    float shadow_bias;
+    float soft_distance;
+    int   force_count;
+    int   bvh_node_count;
+    int   collision_reprojection;
+}
+Global;
+
+// Written once per view (main camera, shadow casting light).
+layout(std140, binding = 1) uniform ViewUniforms_t
+{
+    mat4  view;
+    mat4  proj;
+    mat4  view_proj;
+    vec4  position;
+    float particle_fraction;
+}
+View;
+
+// Written once per emitter for every simulation step.
+layout(std140, binding = 2) uniform EmitterUniforms_t
+{
+    vec3  position;
+    float sphere_radius;
+    vec3  direction;
+    float rotation;
+    vec3  constant_velocity;
+    float viscosity;
+    vec3  seeds;
+    float delta_time;
+    float min_initial_speed;
+    float max_initial_speed;
+    float min_lifetime;
+    float max_lifetime;
+    float restitution;
+    int   emission_shape;
+    int   direction_type;
+    int   affected_by_gravity;
+    int   depth_buffer_collision;
+    int   particles_per_frame;
+    int   pre_sim_idx;
+    int   post_sim_idx;
+    int   curve_row;
+    int   analytic_step;
+    int   deterministic;
+    uint  step_index;
+    int   particle_quota;
+    int   trail_length;
+    int   trail_head;
+    int   trail_particles;
+    float trail_width;
+    int   sub_emitter_trigger;
+    int   sub_emitter_children;
+    float sub_emitter_speed;
+    float sub_emitter_inherit;
+    float sub_emitter_lifetime;
+    int   max_substeps;
+    int   adaptive_substeps;
+    float substep_distance;
+    int   measure_substeps;
+    int   mesh_collision;
+    int   billboard_mode;
+    vec3  billboard_axis;
+    float velocity_stretch;
+    float rotation_variance;
+    float min_angular_velocity;
+    float max_angular_velocity;
+    uint  trail_generation;
+}
+Emitter;
+
+// ------------------------------------------------------------------
\ No newline at end of file
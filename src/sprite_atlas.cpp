@@ -0,0 +1,357 @@
+#include "sprite_atlas.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <logger.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint32_t align_up(uint32_t value, uint32_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Bottom-left skyline over one page. Every segment is a horizontal run of the page's upper contour.
+struct Skyline
+{
+    struct Segment
+    {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+    };
+
+    std::vector<Segment> segments;
+
+    Skyline(uint32_t size) :
+        segments(1, { 0, 0, size }) {}
+
+    // Lowest y a rect of the given width can rest at when its left edge sits on segment i.
+    bool fit(uint32_t i, uint32_t width, uint32_t height, uint32_t size, uint32_t& y) const
+    {
+        if (segments[i].x + width > size)
+            return false;
+
+        uint32_t remaining = width;
+
+        y = 0;
+
+        for (uint32_t j = i; remaining > 0; j++)
+        {
+            y = std::max(y, segments[j].y);
+
+            if (y + height > size)
+                return false;
+
+            remaining -= std::min(remaining, segments[j].width);
+        }
+
+        return true;
+    }
+
+    bool insert(uint32_t width, uint32_t height, uint32_t size, uint32_t& out_x, uint32_t& out_y)
+    {
+        uint32_t best       = UINT32_MAX;
+        uint32_t best_y     = UINT32_MAX;
+        uint32_t best_width = UINT32_MAX;
+
+        for (uint32_t i = 0; i < segments.size(); i++)
+        {
+            uint32_t y;
+
+            if (fit(i, width, height, size, y) && (y < best_y || (y == best_y && segments[i].width < best_width)))
+            {
+                best       = i;
+                best_y     = y;
+                best_width = segments[i].width;
+            }
+        }
+
+        if (best == UINT32_MAX)
+            return false;
+
+        out_x = segments[best].x;
+        out_y = best_y;
+
+        // The new segment replaces everything it covers, the last covered segment is trimmed.
+        Segment  placed = { out_x, best_y + height, width };
+        uint32_t end    = out_x + width;
+        uint32_t j      = best;
+
+        while (j < segments.size() && segments[j].x + segments[j].width <= end)
+            j++;
+
+        if (j < segments.size() && segments[j].x < end)
+        {
+            segments[j].width -= end - segments[j].x;
+            segments[j].x = end;
+        }
+
+        segments.erase(segments.begin() + best, segments.begin() + j);
+        segments.insert(segments.begin() + best, placed);
+
+        // Neighbours at the same height merge so the contour stays short.
+        for (uint32_t k = 0; k + 1 < segments.size();)
+        {
+            if (segments[k].y == segments[k + 1].y)
+            {
+                segments[k].width += segments[k + 1].width;
+                segments.erase(segments.begin() + k + 1);
+            }
+            else
+                k++;
+        }
+
+        return true;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SpriteAtlas::~SpriteAtlas()
+{
+    if (m_texture)
+        glDeleteTextures(1, &m_texture);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool SpriteAtlas::build(const std::vector<SpriteImage>& sources, const std::string& cache_path)
+{
+    auto     start       = std::chrono::high_resolution_clock::now();
+    uint64_t source_hash = hash_sources(sources);
+
+    m_stats.cached = load(cache_path, source_hash);
+
+    if (!m_stats.cached)
+    {
+        if (!pack(sources))
+            return false;
+
+        if (!save(cache_path, source_hash))
+            DW_LOG_ERROR("Failed to write sprite atlas cache: " + cache_path);
+    }
+
+    uint64_t covered = 0;
+
+    for (const SpriteImage& source : sources)
+        covered += uint64_t(source.width) * source.height;
+
+    m_stats.occupancy = m_page_count > 0 ? float(double(covered) / (double(SPRITE_ATLAS_PAGE_SIZE) * SPRITE_ATLAS_PAGE_SIZE * m_page_count)) : 0.0f;
+    m_stats.build_ms  = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SpriteAtlas::upload()
+{
+    if (m_texture)
+        glDeleteTextures(1, &m_texture);
+
+    m_texture = 0;
+
+    if (m_page_count == 0)
+        return;
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_texture);
+    glTextureStorage3D(m_texture, SPRITE_ATLAS_MIP_LEVELS, GL_RGBA8, SPRITE_ATLAS_PAGE_SIZE, SPRITE_ATLAS_PAGE_SIZE, m_page_count);
+    glTextureSubImage3D(m_texture, 0, 0, 0, 0, SPRITE_ATLAS_PAGE_SIZE, SPRITE_ATLAS_PAGE_SIZE, m_page_count, GL_RGBA, GL_UNSIGNED_BYTE, m_pages.data());
+    glGenerateTextureMipmap(m_texture);
+
+    glTextureParameteri(m_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(m_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(m_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // The CPU copy is only needed to write the cache.
+    m_pages.clear();
+    m_pages.shrink_to_fit();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SpriteAtlas::bind(uint32_t unit)
+{
+    glBindTextureUnit(unit, m_texture);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t SpriteAtlas::hash_sources(const std::vector<SpriteImage>& sources)
+{
+    // The layout constants are part of the key, so changing the packer invalidates old caches too.
+    uint32_t layout[] = { SPRITE_ATLAS_VERSION, SPRITE_ATLAS_PAGE_SIZE, SPRITE_ATLAS_BLOCK, SPRITE_ATLAS_PADDING, uint32_t(sources.size()) };
+    uint64_t hash     = fnv1a(0xcbf29ce484222325ull, layout, sizeof(layout));
+
+    for (const SpriteImage& source : sources)
+    {
+        hash = fnv1a(hash, &source.width, sizeof(source.width));
+        hash = fnv1a(hash, &source.height, sizeof(source.height));
+        hash = fnv1a(hash, source.pixels.data(), source.pixels.size());
+    }
+
+    return hash;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool SpriteAtlas::pack(const std::vector<SpriteImage>& sources)
+{
+    // Tallest first, which keeps the skyline flat.
+    std::vector<uint32_t> order(sources.size());
+
+    for (uint32_t i = 0; i < order.size(); i++)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sources[a].height > sources[b].height; });
+
+    std::vector<Skyline> pages;
+
+    m_frames.assign(sources.size(), SpriteFrame());
+    m_pages.clear();
+    m_page_count = 0;
+
+    for (uint32_t index : order)
+    {
+        const SpriteImage& source = sources[index];
+
+        // The gutter is part of the rect, and both are kept on block boundaries.
+        uint32_t width  = align_up(source.width + SPRITE_ATLAS_PADDING * 2, SPRITE_ATLAS_BLOCK);
+        uint32_t height = align_up(source.height + SPRITE_ATLAS_PADDING * 2, SPRITE_ATLAS_BLOCK);
+
+        if (width > SPRITE_ATLAS_PAGE_SIZE || height > SPRITE_ATLAS_PAGE_SIZE)
+        {
+            DW_LOG_ERROR("Sprite frame " + std::to_string(index) + " does not fit an atlas page");
+            return false;
+        }
+
+        uint32_t page = 0;
+        uint32_t x    = 0;
+        uint32_t y    = 0;
+
+        while (page < pages.size() && !pages[page].insert(width, height, SPRITE_ATLAS_PAGE_SIZE, x, y))
+            page++;
+
+        if (page == pages.size())
+        {
+            pages.push_back(Skyline(SPRITE_ATLAS_PAGE_SIZE));
+            pages.back().insert(width, height, SPRITE_ATLAS_PAGE_SIZE, x, y);
+
+            m_page_count++;
+            m_pages.resize(size_t(SPRITE_ATLAS_PAGE_SIZE) * SPRITE_ATLAS_PAGE_SIZE * 4 * m_page_count, 0);
+        }
+
+        blit(source, page, x + SPRITE_ATLAS_PADDING, y + SPRITE_ATLAS_PADDING);
+
+        SpriteFrame& frame = m_frames[index];
+
+        frame.rect  = glm::vec4(x + SPRITE_ATLAS_PADDING, y + SPRITE_ATLAS_PADDING, source.width, source.height) / float(SPRITE_ATLAS_PAGE_SIZE);
+        frame.layer = int32_t(page);
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Copies the frame and extrudes its border into the gutter, so filtering at the edge of a frame reads its own texels.
+void SpriteAtlas::blit(const SpriteImage& source, uint32_t page, uint32_t x, uint32_t y)
+{
+    uint8_t* base = m_pages.data() + size_t(SPRITE_ATLAS_PAGE_SIZE) * SPRITE_ATLAS_PAGE_SIZE * 4 * page;
+
+    int32_t padding = SPRITE_ATLAS_PADDING;
+
+    for (int32_t dy = -padding; dy < int32_t(source.height) + padding; dy++)
+    {
+        int32_t sy = glm::clamp(dy, 0, int32_t(source.height) - 1);
+
+        for (int32_t dx = -padding; dx < int32_t(source.width) + padding; dx++)
+        {
+            int32_t sx = glm::clamp(dx, 0, int32_t(source.width) - 1);
+
+            memcpy(base + (size_t(y + dy) * SPRITE_ATLAS_PAGE_SIZE + (x + dx)) * 4, &source.pixels[(size_t(sy) * source.width + sx) * 4], 4);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool SpriteAtlas::load(const std::string& path, uint64_t source_hash)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (!file)
+        return false;
+
+    SpriteAtlasHeader header;
+
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, SPRITE_ATLAS_MAGIC, 4) == 0 && header.version == SPRITE_ATLAS_VERSION && header.source_hash == source_hash && header.page_size == SPRITE_ATLAS_PAGE_SIZE;
+
+    if (ok)
+    {
+        m_frames.resize(header.frame_count);
+        m_pages.resize(size_t(SPRITE_ATLAS_PAGE_SIZE) * SPRITE_ATLAS_PAGE_SIZE * 4 * header.page_count);
+
+        ok = fread(m_frames.data(), sizeof(SpriteFrame), m_frames.size(), file) == m_frames.size() && fread(m_pages.data(), 1, m_pages.size(), file) == m_pages.size();
+    }
+
+    fclose(file);
+
+    m_page_count = ok ? header.page_count : 0;
+
+    if (!ok)
+    {
+        m_frames.clear();
+        m_pages.clear();
+    }
+
+    return ok;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool SpriteAtlas::save(const std::string& path, uint64_t source_hash) const
+{
+    FILE* file = fopen(path.c_str(), "wb");
+
+    if (!file)
+        return false;
+
+    SpriteAtlasHeader header;
+
+    memcpy(header.magic, SPRITE_ATLAS_MAGIC, 4);
+    header.version     = SPRITE_ATLAS_VERSION;
+    header.source_hash = source_hash;
+    header.page_size   = SPRITE_ATLAS_PAGE_SIZE;
+    header.page_count  = m_page_count;
+    header.frame_count = uint32_t(m_frames.size());
+    header.padding     = 0;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(m_frames.data(), sizeof(SpriteFrame), m_frames.size(), file) == m_frames.size() && fwrite(m_pages.data(), 1, m_pages.size(), file) == m_pages.size();
+
+    fclose(file);
+
+    return ok;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <ogl.h>
+#include <glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define SPRITE_ATLAS_MAGIC "SATL"
+#define SPRITE_ATLAS_VERSION 1
+#define SPRITE_ATLAS_PAGE_SIZE 1024
+#define SPRITE_ATLAS_BLOCK 4    // Compressed formats encode 4x4 blocks, rects never share one
+#define SPRITE_ATLAS_PADDING 8  // Gutter around every frame, keeps mips below SPRITE_ATLAS_MIP_LEVELS from bleeding
+#define SPRITE_ATLAS_MIP_LEVELS 4
+
+// One source frame, tightly packed RGBA8.
+struct SpriteImage
+{
+    uint32_t             width  = 0;
+    uint32_t             height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// std430 mirror of SpriteFrame in shader/sprites.glsl.
+struct SpriteFrame
+{
+    glm::vec4 rect;  // xy: UV offset, zw: UV scale
+    int32_t   layer;
+    int32_t   padding[3];
+};
+
+// Header of the cache file. It is followed by frame_count SpriteFrames and page_count RGBA8 pages.
+struct SpriteAtlasHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t source_hash;
+    uint32_t page_size;
+    uint32_t page_count;
+    uint32_t frame_count;
+    uint32_t padding;
+};
+
+struct SpriteAtlasStats
+{
+    double build_ms  = 0.0;
+    float  occupancy = 0.0f; // Fraction of the page texels covered by frames, gutters excluded
+    bool   cached    = false;
+};
+
+// Packs sprite frames into the layers of a mipmapped texture array. Frames are placed with a skyline packer on
+// block aligned rects, and the packed result is cached on disk keyed by a hash of the sources.
+class SpriteAtlas
+{
+public:
+    ~SpriteAtlas();
+
+    // Loads the cache if it was built from the same sources, repacks and rewrites it otherwise.
+    bool build(const std::vector<SpriteImage>& sources, const std::string& cache_path);
+
+    void upload();
+    void bind(uint32_t unit);
+
+    static uint64_t hash_sources(const std::vector<SpriteImage>& sources);
+
+    inline const std::vector<SpriteFrame>& frames() const { return m_frames; }
+    inline uint32_t                        page_count() const { return m_page_count; }
+    inline const SpriteAtlasStats&         stats() const { return m_stats; }
+
+private:
+    bool pack(const std::vector<SpriteImage>& sources);
+    bool load(const std::string& path, uint64_t source_hash);
+    bool save(const std::string& path, uint64_t source_hash) const;
+    void blit(const SpriteImage& source, uint32_t page, uint32_t x, uint32_t y);
+
+private:
+    GLuint                   m_texture    = 0;
+    uint32_t                 m_page_count = 0;
+    std::vector<SpriteFrame> m_frames;
+    std::vector<uint8_t>     m_pages;
+    SpriteAtlasStats         m_stats;
+};
@@ -0,0 +1,136 @@
+#include "vector_field.h"
+#include <cstdio>
+#include <cstring>
+#include <logger.h>
+
+#if defined(_WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+VectorFieldVolume::~VectorFieldVolume()
+{
+    close();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool VectorFieldVolume::open(const std::string& path)
+{
+    close();
+
+#if defined(_WIN32)
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        m_file = nullptr;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(m_file, &size);
+
+    m_size    = size_t(size.QuadPart);
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (m_mapping)
+        m_mapped = (uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        m_size = size_t(info.st_size);
+
+        void* mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapped != MAP_FAILED)
+            m_mapped = (uint8_t*)mapped;
+    }
+
+    // The mapping keeps the file alive.
+    ::close(fd);
+#endif
+
+    if (!m_mapped)
+    {
+        DW_LOG_ERROR("Failed to map vector field: " + path);
+        close();
+        return false;
+    }
+
+    const VectorFieldHeader& h = header();
+
+    if (m_size < sizeof(VectorFieldHeader) || memcmp(h.magic, VECTOR_FIELD_MAGIC, 4) != 0 || h.version != VECTOR_FIELD_VERSION)
+    {
+        DW_LOG_ERROR("Not a vector field volume: " + path);
+        close();
+        return false;
+    }
+
+    if (m_size < sizeof(VectorFieldHeader) + size_t(h.width) * h.height * h.depth * sizeof(float) * 3)
+    {
+        DW_LOG_ERROR("Truncated vector field volume: " + path);
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void VectorFieldVolume::close()
+{
+#if defined(_WIN32)
+    if (m_mapped)
+        UnmapViewOfFile(m_mapped);
+
+    if (m_mapping)
+        CloseHandle(m_mapping);
+
+    if (m_file)
+        CloseHandle(m_file);
+
+    m_mapping = nullptr;
+    m_file    = nullptr;
+#else
+    if (m_mapped)
+        munmap(m_mapped, m_size);
+#endif
+
+    m_mapped = nullptr;
+    m_size   = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool VectorFieldVolume::write(const std::string& path, const VectorFieldHeader& header, const float* vectors)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+
+    if (!file)
+        return false;
+
+    size_t count = size_t(header.width) * header.height * header.depth * 3;
+    bool   ok    = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(vectors, sizeof(float), count, file) == count;
+
+    fclose(file);
+
+    return ok;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
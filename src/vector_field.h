@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm.hpp>
+#include <cstdint>
+#include <string>
+
+#define VECTOR_FIELD_MAGIC "VFLD"
+#define VECTOR_FIELD_VERSION 1
+
+enum ForceType
+{
+    FORCE_POINT,
+    FORCE_VORTEX,
+    FORCE_DRAG,
+    FORCE_VECTOR_FIELD,
+    FORCE_TYPE_COUNT
+};
+
+// std430 mirror of the Force struct in shader/forces.glsl. For vector fields position and axis hold the volume bounds.
+struct ForceField
+{
+    glm::vec4 position;
+    glm::vec4 axis;
+    int32_t   type;
+    float     strength;
+    float     radius;
+    float     falloff;
+};
+
+// Header of the binary volume format. It is followed by width * height * depth RGB float vectors, x varying fastest.
+struct VectorFieldHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t depth;
+    float    bounds_min[3];
+    float    bounds_max[3];
+};
+
+// A vector field volume mapped straight from disk, so loading costs no copy before the texture upload.
+class VectorFieldVolume
+{
+public:
+    ~VectorFieldVolume();
+
+    bool open(const std::string& path);
+    void close();
+
+    static bool write(const std::string& path, const VectorFieldHeader& header, const float* vectors);
+
+    inline bool                     is_open() const { return m_mapped != nullptr; }
+    inline const VectorFieldHeader& header() const { return *(const VectorFieldHeader*)m_mapped; }
+    inline const float*             vectors() const { return (const float*)(m_mapped + sizeof(VectorFieldHeader)); }
+
+private:
+    uint8_t* m_mapped = nullptr;
+    size_t   m_size   = 0;
+#if defined(_WIN32)
+    void* m_file    = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
@@ -0,0 +1,148 @@
+#include "test.h"
+#include "bvh.h"
+#include "job_system.h"
+#include <cmath>
+#include <random>
+#include <string>
+
+#define BVH_TEST_SEGMENTS 2000
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Random segments through the scene bounds must hit at the same distance as the brute force reference.
+static bool matches_brute_force(const BVH& bvh, const glm::vec3& bounds_min, const glm::vec3& bounds_max, uint32_t seed)
+{
+    std::mt19937                          generator(seed);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    glm::vec3 extent = bounds_max - bounds_min + glm::vec3(1.0f);
+    glm::vec3 start  = bounds_min - glm::vec3(0.5f);
+    float     length = glm::length(extent);
+
+    for (uint32_t i = 0; i < BVH_TEST_SEGMENTS; i++)
+    {
+        glm::vec3 origin    = start + extent * glm::vec3(dist(generator), dist(generator), dist(generator));
+        glm::vec3 direction = (glm::vec3(dist(generator), dist(generator), dist(generator)) * 2.0f - 1.0f) * length;
+
+        float    t, expected_t;
+        uint32_t triangle, expected_triangle;
+
+        bool hit      = bvh.intersect(origin, direction, 1.0f, t, triangle);
+        bool expected = bvh.intersect_brute_force(origin, direction, 1.0f, expected_t, expected_triangle);
+
+        // Triangles sharing the hit point may be reported in a different order, so only the distance is compared.
+        if (hit != expected || (hit && fabsf(t - expected_t) > 1e-5f))
+            return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void add_triangle(std::vector<glm::vec3>& positions, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    positions.push_back(a);
+    positions.push_back(b);
+    positions.push_back(c);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TEST_CASE(bvh_empty)
+{
+    JobSystem              jobs;
+    BVH                    bvh;
+    std::vector<glm::vec3> positions;
+    std::string            error;
+
+    bvh.build(positions, jobs);
+
+    CHECK(bvh.nodes().empty());
+    CHECK(bvh.validate(error));
+
+    float    t;
+    uint32_t triangle;
+
+    CHECK(!bvh.intersect(glm::vec3(0.0f), glm::vec3(1.0f), 1.0f, t, triangle));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TEST_CASE(bvh_single_triangle)
+{
+    JobSystem              jobs;
+    BVH                    bvh;
+    std::vector<glm::vec3> positions;
+    std::string            error;
+
+    add_triangle(positions, glm::vec3(-1.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, -1.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+    bvh.build(positions, jobs);
+
+    CHECK(bvh.nodes().size() == 1);
+    CHECK(bvh.validate(error));
+
+    float    t;
+    uint32_t triangle;
+
+    CHECK(bvh.intersect(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -2.0f, 0.0f), 1.0f, t, triangle));
+    CHECK(fabsf(t - 0.5f) < 1e-6f && triangle == 0);
+
+    // Stops short of the plane.
+    CHECK(!bvh.intersect(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -0.5f, 0.0f), 1.0f, t, triangle));
+
+    CHECK(matches_brute_force(bvh, bvh.bounds_min(), bvh.bounds_max(), 1));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Identical triangles share a centroid, so no split separates them and the builder has to fall back to a leaf
+// or a median split without looping.
+TEST_CASE(bvh_coincident_triangles)
+{
+    JobSystem              jobs;
+    BVH                    bvh;
+    std::vector<glm::vec3> positions;
+    std::string            error;
+
+    for (int i = 0; i < 64; i++)
+        add_triangle(positions, glm::vec3(-1.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, -1.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+    bvh.build(positions, jobs);
+
+    CHECK(bvh.validate(error));
+    CHECK(bvh.triangles().size() == 64);
+    CHECK(matches_brute_force(bvh, bvh.bounds_min(), bvh.bounds_max(), 2));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Large enough for the builder to split subtrees off as jobs.
+TEST_CASE(bvh_random_segments)
+{
+    JobSystem                             jobs;
+    std::mt19937                          generator(3);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> size(-0.5f, 0.5f);
+
+    for (uint32_t count : { 2u, 5u, 100u, 20000u })
+    {
+        BVH                    bvh;
+        std::vector<glm::vec3> positions;
+        std::string            error;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            glm::vec3 center = glm::vec3(dist(generator), dist(generator), dist(generator));
+
+            add_triangle(positions, center + glm::vec3(size(generator), size(generator), size(generator)), center + glm::vec3(size(generator), size(generator), size(generator)), center + glm::vec3(size(generator), size(generator), size(generator)));
+        }
+
+        bvh.build(positions, jobs);
+
+        CHECK(bvh.validate(error));
+        CHECK(bvh.triangles().size() == count);
+        CHECK(matches_brute_force(bvh, bvh.bounds_min(), bvh.bounds_max(), count));
+    }
+}
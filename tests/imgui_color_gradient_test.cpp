@@ -0,0 +1,178 @@
+#include "test.h"
+#include "imgui_color_gradient.h"
+#include <cmath>
+#include <random>
+
+#define GRADIENT_TEST_TOLERANCE 1e-5f
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool is_sorted(const ImGradient& gradient)
+{
+    const std::vector<ImGradientMark>& marks = gradient.getMarks();
+
+    for (size_t i = 1; i < marks.size(); i++)
+    {
+        if (marks[i - 1].position > marks[i].position)
+            return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Straightforward evaluation that searches every mark pair, which the sweep in refreshCache() must reproduce.
+static void reference_color(const ImGradient& gradient, float position, float* color)
+{
+    const std::vector<ImGradientMark>& marks = gradient.getMarks();
+
+    if (marks.empty())
+    {
+        color[0] = color[1] = color[2] = color[3] = 0.0f;
+        return;
+    }
+
+    const ImGradientMark* lower = nullptr;
+    const ImGradientMark* upper = nullptr;
+
+    for (const ImGradientMark& mark : marks)
+    {
+        if (mark.position < position)
+            lower = &mark;
+        else if (!upper)
+            upper = &mark;
+    }
+
+    if (!lower || !upper)
+    {
+        const ImGradientMark* mark = lower ? lower : upper;
+
+        for (int c = 0; c < 4; c++)
+            color[c] = mark->color[c];
+
+        return;
+    }
+
+    float delta = (position - lower->position) / (upper->position - lower->position);
+
+    for (int c = 0; c < 4; c++)
+        color[c] = (1.0f - delta) * lower->color[c] + delta * upper->color[c];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool matches_reference(const ImGradient& gradient)
+{
+    for (int i = 0; i < IM_GRADIENT_CACHE_SIZE; i++)
+    {
+        float position = i / float(IM_GRADIENT_CACHE_SIZE - 1);
+        float color[4];
+        float expected[4];
+
+        gradient.getColorAt(position, color);
+        reference_color(gradient, position, expected);
+
+        for (int c = 0; c < 4; c++)
+        {
+            if (fabsf(color[c] - expected[c]) > GRADIENT_TEST_TOLERANCE)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TEST_CASE(gradient_sorted_insertion)
+{
+    ImGradient gradient;
+
+    gradient.clearMarks();
+
+    CHECK(gradient.addMark(0.7f, ImColor(1.0f, 0.0f, 0.0f)) == 0);
+    CHECK(gradient.addMark(0.2f, ImColor(0.0f, 1.0f, 0.0f)) == 0);
+    CHECK(gradient.addMark(0.5f, ImColor(0.0f, 0.0f, 1.0f)) == 1);
+    CHECK(gradient.addMark(1.5f, ImColor(1.0f, 1.0f, 1.0f)) == 3);
+    CHECK(is_sorted(gradient));
+    CHECK(gradient.getMarks().back().position == 1.0f);
+
+    // Ties go after the existing marks at the same position.
+    int tie = gradient.addMark(0.5f, ImColor(0.0f, 0.0f, 0.0f));
+
+    CHECK(tie == 2);
+    CHECK(gradient.getMark(1).color[2] == 1.0f && gradient.getMark(2).color[2] == 0.0f);
+
+    // Moving a mark across its neighbours keeps the order and returns its new index.
+    int moved = gradient.moveMark(0, 0.9f);
+
+    CHECK(moved == 3);
+    CHECK(gradient.getMark(moved).position == 0.9f && gradient.getMark(moved).color[1] == 1.0f);
+    CHECK(is_sorted(gradient));
+
+    moved = gradient.moveMark(moved, -1.0f);
+
+    CHECK(moved == 0 && gradient.getMark(0).position == 0.0f);
+    CHECK(is_sorted(gradient));
+
+    gradient.removeMark(0);
+
+    CHECK(gradient.markCount() == 4);
+    CHECK(is_sorted(gradient));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TEST_CASE(gradient_sweep_cache)
+{
+    std::mt19937                          generator(4);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    ImGradient gradient;
+
+    CHECK(matches_reference(gradient));
+
+    gradient.clearMarks();
+
+    CHECK(matches_reference(gradient));
+
+    // A single mark, marks short of either end and random edits in between.
+    gradient.addMark(0.4f, ImColor(0.2f, 0.4f, 0.6f, 0.8f));
+
+    CHECK(matches_reference(gradient));
+
+    gradient.addMark(0.6f, ImColor(1.0f, 0.0f, 0.5f, 1.0f));
+
+    CHECK(matches_reference(gradient));
+
+    for (int i = 0; i < 100; i++)
+    {
+        if (gradient.markCount() > 2 && dist(generator) < 0.3f)
+            gradient.moveMark(int(dist(generator) * (gradient.markCount() - 1)), dist(generator) * 1.2f - 0.1f);
+        else
+            gradient.addMark(dist(generator), ImColor(dist(generator), dist(generator), dist(generator), dist(generator)));
+
+        CHECK(is_sorted(gradient));
+        CHECK(matches_reference(gradient));
+    }
+
+    // Batch lookups read the same cache entries.
+    float positions[64];
+    float colors[64 * 4];
+
+    for (int i = 0; i < 64; i++)
+        positions[i] = dist(generator) * 1.2f - 0.1f;
+
+    gradient.getColorsAt(positions, colors, 64);
+
+    for (int i = 0; i < 64; i++)
+    {
+        float color[4];
+
+        gradient.getColorAt(positions[i], color);
+
+        for (int c = 0; c < 4; c++)
+            CHECK(colors[i * 4 + c] == color[c]);
+    }
+}
@@ -0,0 +1,135 @@
+#include "test.h"
+#include "imgui_curve_editor.h"
+#include "job_system.h"
+#include <cmath>
+#include <vector>
+
+#define CURVE_TEST_SAMPLES 1024
+#define CURVE_TEST_REFERENCE_SAMPLES 16384
+#define CURVE_TEST_TOLERANCE 1e-3f
+
+static const float CURVE_TEST_PRESETS[][4] = {
+    { 0.25f, 0.25f, 0.75f, 0.75f },  // Linear
+    { 0.42f, 0.0f, 1.0f, 1.0f },     // Ease in
+    { 0.0f, 0.0f, 0.58f, 1.0f },     // Ease out
+    { 0.42f, 0.0f, 0.58f, 1.0f },    // Ease in out
+    { 0.68f, -0.55f, 0.27f, 1.55f }, // Back, overshoots in y
+    { 0.0f, 1.0f, 0.0f, 1.0f },      // Vertical at the start, where Newton gives up
+    { 1.0f, 0.0f, 1.0f, 0.0f }       // Vertical at the end
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Bernstein form of the curve at parameter t, independent of the polynomial coefficients the class uses.
+static void curve_point(const float P[4], float t, float& x, float& y)
+{
+    float k1 = 3.0f * (1.0f - t) * (1.0f - t) * t;
+    float k2 = 3.0f * (1.0f - t) * t * t;
+    float k3 = t * t * t;
+
+    x = k1 * P[0] + k2 * P[2] + k3;
+    y = k1 * P[1] + k2 * P[3] + k3;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Where x is flat in t the curve is near vertical as a function of x, so y is checked as a distance to the curve.
+static float distance_to_curve(const std::vector<float>& points, float x, float y)
+{
+    float distance = INFINITY;
+
+    for (size_t i = 0; i < points.size(); i += 2)
+        distance = fminf(distance, hypotf(points[i] - x, points[i + 1] - y));
+
+    return distance;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TEST_CASE(curve_evaluation)
+{
+    for (const auto& P : CURVE_TEST_PRESETS)
+    {
+        ImGui::BezierCurve curve(P);
+
+        CHECK(fabsf(curve.evaluate(0.0f)) < CURVE_TEST_TOLERANCE);
+        CHECK(fabsf(curve.evaluate(1.0f) - 1.0f) < CURVE_TEST_TOLERANCE);
+
+        // Inputs outside [0, 1] clamp to the end points.
+        CHECK(curve.evaluate(-1.0f) == curve.evaluate(0.0f));
+        CHECK(curve.evaluate(2.0f) == curve.evaluate(1.0f));
+
+        std::vector<float> points((CURVE_TEST_REFERENCE_SAMPLES + 1) * 2);
+
+        for (int i = 0; i <= CURVE_TEST_REFERENCE_SAMPLES; i++)
+            curve_point(P, i / float(CURVE_TEST_REFERENCE_SAMPLES), points[i * 2], points[i * 2 + 1]);
+
+        // Walking the parameter gives x values across the curve, and the evaluated point must lie on it.
+        bool on_curve = true;
+
+        for (int i = 0; i <= CURVE_TEST_SAMPLES; i++)
+        {
+            float x, y;
+
+            curve_point(P, i / float(CURVE_TEST_SAMPLES), x, y);
+
+            on_curve &= distance_to_curve(points, x, curve.evaluate(x)) < CURVE_TEST_TOLERANCE;
+        }
+
+        CHECK(on_curve);
+
+        CHECK(curve.evaluate(0.3f) == ImGui::BezierValue(0.3f, const_cast<float*>(P)));
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Curves share no state, so interleaving them or sampling one from many threads must give the serial results bit for bit.
+TEST_CASE(curve_reentrancy)
+{
+    const int          curve_count = sizeof(CURVE_TEST_PRESETS) / sizeof(CURVE_TEST_PRESETS[0]);
+    std::vector<float> x(CURVE_TEST_SAMPLES);
+    std::vector<float> expected(CURVE_TEST_SAMPLES * curve_count);
+    std::vector<float> batch(CURVE_TEST_SAMPLES * curve_count);
+    std::vector<float> threaded(CURVE_TEST_SAMPLES * curve_count);
+
+    for (int i = 0; i < CURVE_TEST_SAMPLES; i++)
+        x[i] = i / float(CURVE_TEST_SAMPLES - 1);
+
+    for (int c = 0; c < curve_count; c++)
+    {
+        ImGui::BezierCurve curve(CURVE_TEST_PRESETS[c]);
+
+        for (int i = 0; i < CURVE_TEST_SAMPLES; i++)
+            expected[c * CURVE_TEST_SAMPLES + i] = curve.evaluate(x[i]);
+
+        curve.evaluate(x.data(), &batch[c * CURVE_TEST_SAMPLES], CURVE_TEST_SAMPLES);
+    }
+
+    CHECK(batch == expected);
+
+    // Interleave the curves sample by sample.
+    std::vector<ImGui::BezierCurve> curves;
+
+    for (int c = 0; c < curve_count; c++)
+        curves.push_back(ImGui::BezierCurve(CURVE_TEST_PRESETS[c]));
+
+    bool interleaved = true;
+
+    for (int i = 0; i < CURVE_TEST_SAMPLES; i++)
+    {
+        for (int c = 0; c < curve_count; c++)
+            interleaved &= curves[c].evaluate(x[i]) == expected[c * CURVE_TEST_SAMPLES + i];
+    }
+
+    CHECK(interleaved);
+
+    JobSystem jobs(3);
+
+    jobs.parallel_for(CURVE_TEST_SAMPLES * curve_count, 16, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+            threaded[i] = curves[i / CURVE_TEST_SAMPLES].evaluate(x[i % CURVE_TEST_SAMPLES]);
+    });
+
+    CHECK(threaded == expected);
+}
@@ -0,0 +1,73 @@
+#include "test.h"
+#include "job_system.h"
+#include <atomic>
+#include <vector>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Every index must be visited exactly once, including the ragged last batch and counts smaller than a batch.
+static bool covers_every_index(JobSystem& jobs, uint32_t count, uint32_t batch_size)
+{
+    std::vector<std::atomic<uint32_t>> visits(count);
+
+    for (auto& visit : visits)
+        visit = 0;
+
+    jobs.parallel_for(count, batch_size, [&visits](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+            visits[i]++;
+    });
+
+    for (auto& visit : visits)
+    {
+        if (visit.load() != 1)
+            return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TEST_CASE(job_system_parallel_for)
+{
+    for (uint32_t worker_count : { 0u, 1u, 3u })
+    {
+        JobSystem jobs(worker_count);
+
+        CHECK(jobs.worker_count() == worker_count);
+
+        for (uint32_t count : { 0u, 1u, 7u, 64u, 1000u, 100000u })
+        {
+            for (uint32_t batch_size : { 0u, 1u, 13u, 64u, 4096u })
+                CHECK(covers_every_index(jobs, count, batch_size));
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Jobs that submit and wait on their own children, as the BVH builder does, must not deadlock or return early.
+TEST_CASE(job_system_nested_wait)
+{
+    JobSystem             jobs(3);
+    JobCounter            counter;
+    std::atomic<uint32_t> leaves = { 0 };
+
+    auto branch = [&jobs, &leaves]() {
+        JobCounter children;
+
+        for (uint32_t j = 0; j < 16; j++)
+            jobs.submit([&leaves]() { leaves++; }, children);
+
+        jobs.wait(children);
+    };
+
+    for (uint32_t i = 0; i < 16; i++)
+        jobs.submit(branch, counter);
+
+    jobs.wait(counter);
+
+    CHECK(counter.pending.load() == 0);
+    CHECK(leaves.load() == 16 * 16);
+}
@@ -0,0 +1,56 @@
+#include "test.h"
+#include <cstring>
+
+static bool g_failed = false;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::vector<TestCase>& test_cases()
+{
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void test_failed(const char* file, int line, const char* condition)
+{
+    printf("%s:%d: CHECK(%s) failed\n", file, line, condition);
+    g_failed = true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+    int run = 0;
+
+    for (const TestCase& test : test_cases())
+    {
+        bool selected = argc == 1;
+
+        for (int i = 1; i < argc; i++)
+            selected |= strcmp(argv[i], test.name) == 0;
+
+        if (!selected)
+            continue;
+
+        bool failed_before = g_failed;
+        g_failed           = false;
+
+        test.function();
+
+        printf("[%s] %s\n", g_failed ? "FAILED" : "PASSED", test.name);
+
+        g_failed |= failed_before;
+        run++;
+    }
+
+    if (run == 0)
+    {
+        printf("No test matched\n");
+        return 1;
+    }
+
+    return g_failed ? 1 : 0;
+}
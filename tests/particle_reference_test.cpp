@@ -0,0 +1,178 @@
+#include "test.h"
+#include "particle_reference.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <string>
+
+#define REFERENCE_TEST_PARTICLES 20000
+#define REFERENCE_TEST_FRAMES 1000
+#define REFERENCE_TRACE_STRIDE 8
+#define REFERENCE_TRACE_TOLERANCE 0.001f // Same default as the in-app divergence checker
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The application's default emitter at a fixed 60 Hz step, which emits about 4 particles per step at 250 per second.
+static ReferenceEmitter default_emitter(uint32_t step_index)
+{
+    ReferenceEmitter emitter;
+
+    emitter.position            = glm::vec3(0.0f);
+    emitter.direction           = glm::vec3(0.0f, 1.0f, 0.0f);
+    emitter.constant_velocity   = glm::vec3(0.0f);
+    emitter.sphere_radius       = 0.1f;
+    emitter.viscosity           = 0.0f;
+    emitter.delta_time          = 1.0f / 60.0f;
+    emitter.min_initial_speed   = 1.0f;
+    emitter.max_initial_speed   = 4.0f;
+    emitter.min_lifetime        = 2.0f;
+    emitter.max_lifetime        = 2.5f;
+    emitter.emission_shape      = 0;
+    emitter.direction_type      = 1;
+    emitter.affected_by_gravity = true;
+    emitter.emission_count      = 4;
+    emitter.step_index          = step_index;
+    emitter.particle_quota      = REFERENCE_TEST_PARTICLES;
+    emitter.forces              = nullptr;
+    emitter.force_count         = 0;
+    emitter.max_substeps        = 1;
+    emitter.adaptive_substeps   = false;
+    emitter.substep_distance    = 0.1f;
+
+    return emitter;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Two runs from the same reset must agree on the running state hash after every one of the frames.
+TEST_CASE(reference_determinism)
+{
+    std::unique_ptr<ParticleReference> runs[2] = { std::make_unique<ParticleReference>(REFERENCE_TEST_PARTICLES), std::make_unique<ParticleReference>(REFERENCE_TEST_PARTICLES) };
+    std::vector<uint64_t>              hashes[2];
+
+    for (int run = 0; run < 2; run++)
+    {
+        runs[run]->reset();
+
+        for (uint32_t step = 0; step < REFERENCE_TEST_FRAMES; step++)
+        {
+            runs[run]->step(default_emitter(step));
+            hashes[run].push_back(runs[run]->state_hash());
+        }
+    }
+
+    CHECK(runs[0]->alive_count() > 0);
+
+    for (uint32_t step = 0; step < REFERENCE_TEST_FRAMES; step++)
+        CHECK(hashes[0][step] == hashes[1][step]);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The running hash has to depend on the step a state was reached at, or a step could be skipped unnoticed.
+TEST_CASE(reference_hash_keyed_by_step)
+{
+    ParticleReference reference(REFERENCE_TEST_PARTICLES);
+
+    reference.reset();
+    reference.step(default_emitter(0));
+
+    uint64_t first = reference.state_hash();
+
+    CHECK(first != 0);
+    CHECK(ParticleReference::combine_hashes(0, reference.step_hash()) == first);
+
+    reference.step(default_emitter(1));
+
+    CHECK(reference.state_hash() != first);
+    CHECK(reference.state_hash() == ParticleReference::combine_hashes(first, reference.step_hash()));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool within_tolerance(float value, float expected)
+{
+    return fabsf(value - expected) <= REFERENCE_TRACE_TOLERANCE * std::max(1.0f, fabsf(expected));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Replays the default emitter and compares every REFERENCE_TRACE_STRIDE-th alive particle at a few checkpoints against
+// tests/data/reference_trace.txt, so a change to the reference's behaviour fails here and not only against a GPU run.
+// Set GPU_PARTICLE_SYSTEM_WRITE_TRACE=1 to rewrite the trace after an intended change.
+TEST_CASE(reference_golden_trace)
+{
+    const uint32_t checkpoints[] = { 60, 150, 300 };
+    const char*    path          = TEST_DATA_DIR "/reference_trace.txt";
+    bool           write         = getenv("GPU_PARTICLE_SYSTEM_WRITE_TRACE") != nullptr;
+
+    std::ifstream expected;
+    std::ofstream trace;
+
+    if (write)
+        trace.open(path);
+    else
+        expected.open(path);
+
+    CHECK(write ? trace.is_open() : expected.is_open());
+
+    ParticleReference reference(REFERENCE_TEST_PARTICLES);
+    reference.reset();
+
+    uint32_t step = 0;
+
+    for (uint32_t checkpoint : checkpoints)
+    {
+        for (; step < checkpoint; step++)
+            reference.step(default_emitter(step));
+
+        const std::vector<uint32_t>&          alive     = reference.alive();
+        const std::vector<ReferenceParticle>& particles = reference.particles();
+
+        if (write)
+        {
+            trace << "step " << step << " alive " << alive.size() << "\n";
+            trace << std::setprecision(9);
+
+            for (uint32_t i = 0; i < alive.size(); i += REFERENCE_TRACE_STRIDE)
+            {
+                const ReferenceParticle& p = particles[alive[i]];
+
+                trace << i << " " << alive[i] << " " << p.lifetime.x << " " << p.lifetime.y << " " << p.velocity.x << " " << p.velocity.y << " " << p.velocity.z << " " << p.position.x << " " << p.position.y << " " << p.position.z << "\n";
+            }
+
+            continue;
+        }
+
+        std::string label;
+        uint32_t    expected_step, expected_alive;
+
+        expected >> label >> expected_step >> label >> expected_alive;
+
+        CHECK(expected_step == step);
+        CHECK(expected_alive == alive.size());
+
+        for (uint32_t i = 0; i < alive.size(); i += REFERENCE_TRACE_STRIDE)
+        {
+            uint32_t index, slot;
+            float    fields[8];
+
+            expected >> index >> slot;
+
+            for (float& field : fields)
+                expected >> field;
+
+            CHECK(index == i);
+            CHECK(slot == alive[i]);
+
+            const ReferenceParticle& p        = particles[alive[i]];
+            float                    values[] = { p.lifetime.x, p.lifetime.y, p.velocity.x, p.velocity.y, p.velocity.z, p.position.x, p.position.y, p.position.z };
+
+            for (int field = 0; field < 8; field++)
+                CHECK(within_tolerance(values[field], fields[field]));
+        }
+    }
+}
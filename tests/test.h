@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// A minimal test harness. Every TEST_CASE registers itself by name and the runner executes the ones named on
+// the command line, or all of them without arguments. A failed CHECK reports and ends the current case.
+struct TestCase
+{
+    const char* name;
+    void (*function)();
+};
+
+std::vector<TestCase>& test_cases();
+void                   test_failed(const char* file, int line, const char* condition);
+
+struct TestRegistrar
+{
+    TestRegistrar(const char* name, void (*function)()) { test_cases().push_back({ name, function }); }
+};
+
+#define TEST_CASE(name)                                 \
+    static void name();                                 \
+    static TestRegistrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition)                                 \
+    do                                                   \
+    {                                                    \
+        if (!(condition))                                \
+        {                                                \
+            test_failed(__FILE__, __LINE__, #condition); \
+            return;                                      \
+        }                                                \
+    } while (0)